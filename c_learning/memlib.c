@@ -0,0 +1,298 @@
+/*
+ * memlib.c - a stand-in for the memory system used by mm.c
+ *
+ * The heap is one contiguous region of MAX_HEAP bytes of address space, reserved with mmap
+ * when mem_init is called. Only the pages below the break are ever touched, so reserving a
+ * large region costs nothing until the allocator actually grows into it. The region starts on a
+ * HEAP_ALIGN boundary, so that the heap can be backed by transparent huge pages from its first byte.
+ * mem_sbrk moves the break like sbrk(2) does, but never beyond the reserved region. When the
+ * break moves down, the whole pages above it are given back to the system with madvise, and the rest of
+ * the page it is in is cleared, so that everything above the break reads as zero (mm_calloc counts on it).
+ *
+ * mem_init_mapped maps a file (a heap image) at a fixed address instead, shared, so that the heap
+ * outlives the process and a later one finds every block, and every pointer between blocks, where it
+ * was. The file starts with a header page (the base, the size of the region and the break, kept up to
+ * date by mem_sbrk), then MEM_IMAGE_ROOT_SIZE bytes that the allocator keeps its own state in
+ * (mem_image_root), and the heap from MEM_IMAGE_HEAP_OFFSET on. The file grows with the break, by
+ * MEM_IMAGE_STEP bytes at a time, since the pages of a mapping beyond the end of its file cannot be
+ * touched, and shrinks with it.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "memlib.h"
+
+/*Size of the reserved heap region, and the alignment of its start (a transparent huge page)*/
+#define MAX_HEAP (1UL<<34)
+#define HEAP_ALIGN (2UL<<20)
+
+/*Offset of the root area and of the heap in a heap image, and the steps its file grows by*/
+#define MEM_IMAGE_ROOT_OFFSET 4096
+#define MEM_IMAGE_HEAP_OFFSET (MEM_IMAGE_ROOT_OFFSET+MEM_IMAGE_ROOT_SIZE)
+#define MEM_IMAGE_STEP (1UL<<20)
+#define MEM_IMAGE_MAGIC 0x31474d4950414548UL
+
+/*Header of a heap image, at the start of its file*/
+typedef struct {
+    uint64_t magic;
+    uint64_t base;              /*address the file is mapped at*/
+    uint64_t max_size;          /*size of the mapping*/
+    uint64_t brk;               /*size of the heap*/
+} mem_image_t;
+
+static char *mem_start_brk;  /*first byte of the heap*/
+static char *mem_brk;        /*last byte of the heap plus one*/
+static char *mem_max_addr;   /*end of the reserved region plus one*/
+
+/*the file of a heap image (-1 for an anonymous heap), its mapping and the size of both*/
+static int mem_fd=-1;
+static mem_image_t *mem_image;
+static size_t mem_image_size;
+static size_t mem_file_size;
+
+/*
+ * mem_init - reserve the heap region and set the break to its start.
+ */
+void mem_init(void)
+{
+    char *region, *start;
+
+    region=mmap(NULL, MAX_HEAP+HEAP_ALIGN, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if(region==MAP_FAILED){
+        fprintf(stderr, "mem_init: unable to reserve %lu bytes for the heap\n", MAX_HEAP);
+        exit(1);
+    }
+    /*keep the aligned MAX_HEAP bytes of what was reserved*/
+    start=(char *)(((uintptr_t)region+HEAP_ALIGN-1) & ~(HEAP_ALIGN-1));
+    if(start>region){
+        munmap(region, start-region);
+    }
+    munmap(start+MAX_HEAP, region+HEAP_ALIGN-start);
+    mem_start_brk=start;
+    mem_brk=mem_start_brk;
+    mem_max_addr=mem_start_brk+MAX_HEAP;
+}
+
+/*
+ * mem_init_mapped - map the heap image in the file path (created if it does not exist) at base, with room
+ * for max_size bytes, and set the break where the last process left it. Return 1 if the file already held
+ * a heap, 0 if it is new, and -1 (with a message) if it cannot be mapped at base or was made for another base
+ * or size.
+ */
+int mem_init_mapped(const char *path, void *base, size_t max_size)
+{
+    struct stat st;
+    void *region;
+    int fd, found;
+
+    if(max_size<=MEM_IMAGE_HEAP_OFFSET){
+        fprintf(stderr, "mem_init_mapped: %zu bytes leave no room for a heap\n", max_size);
+        return -1;
+    }
+    fd=open(path, O_RDWR|O_CREAT, 0600);
+    if(fd<0 || fstat(fd, &st)<0){
+        perror(path);
+        if(fd>=0){
+            close(fd);
+        }
+        return -1;
+    }
+    found=st.st_size>0;
+    if(!found && ftruncate(fd, MEM_IMAGE_HEAP_OFFSET)<0){
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    /*(MAP_FIXED_NOREPLACE fails rather than unmap whatever is at base already)*/
+    region=mmap(base, max_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED_NOREPLACE|MAP_NORESERVE, fd, 0);
+    if(region!=base){
+        fprintf(stderr, "mem_init_mapped: unable to map %s at %p\n", path, base);
+        if(region!=MAP_FAILED){
+            munmap(region, max_size);
+        }
+        close(fd);
+        return -1;
+    }
+    mem_image=region;
+    if(!found){
+        mem_image->magic=MEM_IMAGE_MAGIC;
+        mem_image->base=(uintptr_t)base;
+        mem_image->max_size=max_size;
+        mem_image->brk=0;
+        st.st_size=MEM_IMAGE_HEAP_OFFSET;
+    }else if(st.st_size<MEM_IMAGE_HEAP_OFFSET || mem_image->magic!=MEM_IMAGE_MAGIC || mem_image->base!=(uintptr_t)base
+             || mem_image->max_size!=max_size || MEM_IMAGE_HEAP_OFFSET+mem_image->brk>(uint64_t)st.st_size){
+        fprintf(stderr, "mem_init_mapped: %s is not a heap image made for %p and %zu bytes\n", path, base, max_size);
+        munmap(region, max_size);
+        close(fd);
+        return -1;
+    }
+    mem_fd=fd;
+    mem_image_size=max_size;
+    mem_file_size=st.st_size;
+    mem_start_brk=(char *)region+MEM_IMAGE_HEAP_OFFSET;
+    mem_brk=mem_start_brk+mem_image->brk;
+    mem_max_addr=(char *)region+max_size;
+    return found;
+}
+
+/*
+ * mem_image_root - return the MEM_IMAGE_ROOT_SIZE bytes of a heap image that are kept for the allocator,
+ * or NULL if the heap is not an image.
+ */
+void *mem_image_root(void)
+{
+    return mem_fd>=0 ? (char *)mem_image+MEM_IMAGE_ROOT_OFFSET : NULL;
+}
+
+/*
+ * mem_sync - write the heap image (the part of it below the break) back to its file. Return 0 on success
+ * (or for an anonymous heap), -1 otherwise.
+ */
+int mem_sync(void)
+{
+    if(mem_fd<0){
+        return 0;
+    }
+    return msync(mem_image, MEM_IMAGE_HEAP_OFFSET+(mem_brk-mem_start_brk), MS_SYNC);
+}
+
+/*
+ * mem_deinit - release the heap region (unmap a heap image, which stays in its file).
+ */
+void mem_deinit(void)
+{
+    if(mem_fd>=0){
+        munmap(mem_image, mem_image_size);
+        close(mem_fd);
+        mem_fd=-1;
+        mem_image=NULL;
+    }else{
+        munmap(mem_start_brk, MAX_HEAP);
+    }
+    mem_start_brk=mem_brk=mem_max_addr=NULL;
+}
+
+/*
+ * mem_image_resize - make the file of a heap image just long enough for the break, by steps of MEM_IMAGE_STEP
+ * bytes when it grows. Return 0 on success, -1 otherwise.
+ */
+static int mem_image_resize(void)
+{
+    size_t need=MEM_IMAGE_HEAP_OFFSET+(mem_brk-mem_start_brk), size;
+
+    if(need>mem_file_size){
+        size=(need+MEM_IMAGE_STEP-1) & ~(MEM_IMAGE_STEP-1);
+    }else if(need+MEM_IMAGE_STEP<=mem_file_size){
+        size=(need+mem_pagesize()-1) & ~(mem_pagesize()-1);
+    }else{
+        size=mem_file_size;
+    }
+    if(size!=mem_file_size){
+        if(ftruncate(mem_fd, size)<0){
+            return -1;
+        }
+        mem_file_size=size;
+    }
+    mem_image->brk=mem_brk-mem_start_brk;
+    return 0;
+}
+
+/*
+ * mem_reset_brk - empty the heap, giving the touched pages back to the system.
+ */
+void mem_reset_brk(void)
+{
+    if(mem_fd>=0){
+        mem_brk=mem_start_brk;
+        mem_image_resize();
+        return;
+    }
+    madvise(mem_start_brk, mem_brk-mem_start_brk, MADV_DONTNEED);
+    mem_brk=mem_start_brk;
+}
+
+/*
+ * mem_sbrk - extend the heap by incr bytes (or shrink it if incr is negative) and return the
+ * old break. Like sbrk(2), return (void *)-1 and set errno if the break cannot be moved.
+ */
+void *mem_sbrk(intptr_t incr)
+{
+    char *old_brk=mem_brk;
+    uintptr_t page=mem_pagesize(), first_page;
+
+    if(incr<0){
+        if(-incr>mem_brk-mem_start_brk){
+            errno=EINVAL;
+            fprintf(stderr, "ERROR: mem_sbrk failed. Attempt to shrink the heap below its start...\n");
+            return (void *)-1;
+        }
+        mem_brk+=incr;
+        if(mem_fd>=0){
+            /*truncating the file releases its pages*/
+            mem_image_resize();
+            return old_brk;
+        }
+        /*release the pages that now lie entirely above the break, and clear the rest of the page it is in*/
+        first_page=((uintptr_t)mem_brk+page-1) & ~(page-1);
+        if(first_page<(uintptr_t)old_brk){
+            madvise((void *)first_page, (uintptr_t)old_brk-first_page, MADV_DONTNEED);
+        }else{
+            first_page=(uintptr_t)old_brk;
+        }
+        memset(mem_brk, 0, first_page-(uintptr_t)mem_brk);
+        return old_brk;
+    }
+    if(incr>mem_max_addr-mem_brk){
+        errno=ENOMEM;
+        fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+        return (void *)-1;
+    }
+    mem_brk+=incr;
+    if(mem_fd>=0 && mem_image_resize()<0){
+        mem_brk=old_brk;
+        errno=ENOMEM;
+        fprintf(stderr, "ERROR: mem_sbrk failed. Cannot grow the file of the heap image...\n");
+        return (void *)-1;
+    }
+    return old_brk;
+}
+
+/*
+ * mem_heap_lo - return the address of the first heap byte.
+ */
+void *mem_heap_lo(void)
+{
+    return mem_start_brk;
+}
+
+/*
+ * mem_heap_hi - return the address of the last heap byte.
+ */
+void *mem_heap_hi(void)
+{
+    return mem_brk-1;
+}
+
+/*
+ * mem_heapsize - return the heap size in bytes.
+ */
+size_t mem_heapsize(void)
+{
+    return mem_brk-mem_start_brk;
+}
+
+/*
+ * mem_pagesize - return the page size of the system.
+ */
+size_t mem_pagesize(void)
+{
+    return (size_t)getpagesize();
+}
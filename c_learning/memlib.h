@@ -0,0 +1,36 @@
+/*
+ * memlib.h - a stand-in for the memory system used by mm.c
+ */
+#ifndef MEMLIB_H
+#define MEMLIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void mem_init(void);
+extern void mem_deinit(void);
+extern void *mem_sbrk(intptr_t incr);
+extern void mem_reset_brk(void);
+extern void *mem_heap_lo(void);
+extern void *mem_heap_hi(void);
+extern size_t mem_heapsize(void);
+extern size_t mem_pagesize(void);
+
+/*Heap images: a heap in a file mapped at a fixed address, see memlib.c*/
+extern int mem_init_mapped(const char *path, void *base, size_t max_size);
+extern void *mem_image_root(void);
+extern int mem_sync(void);
+
+/*A base address for mem_init_mapped, far from where the system maps anything, and the bytes of mem_image_root*/
+#define MEM_IMAGE_BASE ((void *)0x600000000000UL)
+#define MEM_IMAGE_ROOT_SIZE (60*1024)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
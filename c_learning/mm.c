@@ -7,7 +7,7 @@
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- current
  * |  Size of previous block                               |0|0|0|F|
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
- * |  Size of current block                                |0|0|0|F|
+ * |  Size of current block                                |H|G|M|F|
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- user
  * .                                                               .
  * .  User data                                                    .
@@ -23,6 +23,10 @@
  * another 16 bytes for the footnote, a waste of memory.
  * Since last 4 bits of size will be 0, the last bit is used for
  * indicating whether the corresponding block is free. (1 if free)
+ * The M bit marks a huge block that lives in its own mapping instead of the heap (see below),
+ * and the G bit a block that mm_realloc has grown before (see mm_realloc_grow). The H bit marks a
+ * block held in the quick cache (see below). Above the size, bit 47 (S) marks a block sampled for the
+ * heap profile and the top 16 bits hold the tag of the hardened build (see below).
  * 
  * An free block
  *
@@ -51,20 +55,237 @@
  * for malloc, free and other functions. Color information is stored in the last bit 
  * after the "parent" information (1 if red). 
  * Therefore, in order to store free block in the tree, the block should be at least 48-byte 
- * (MIN_BLOCK_SIZE) including the header, but a free block which is smaller than MIN_BLOCK_SIZE 
- * can still happen when we split a large block into two smaller one for a malloc request. 
- * When such incident happens, we have to check whether the "reminder" is larger than the MIN_BLOCK_SIZE
- * or not. If not, it will be kept off the record and treated as fragmentation.
+ * (MIN_BLOCK_SIZE) including the header. When we split a block for a malloc or mm_realloc request,
+ * we have to check whether the "reminder" is at least MIN_BLOCK_SIZE. If not, it is not split off at
+ * all but left in the allocated block (unless mm_realloc can merge it into a free next block), so
+ * every free block is tracked and none is lost as an untracked sliver.
+ *
+ * Segregated free lists
+ *
+ * Most requests are small, and walking (and rebalancing) the Red-black Tree for each of them is
+ * wasteful. Free blocks of size MIN_BLOCK_SIZE up to SEG_MAX_SIZE are therefore kept in exact size
+ * classes (one class every 16 bytes) instead of the tree. Each class is a doubly linked list whose
+ * links reuse the "left child" (next) and "right child" (previous) fields of the free block, so the
+ * block layout above does not change. A bit in seg_bitmap is set whenever the corresponding list is
+ * non-empty, so the best-fit class for a request is found with a single find-first-set.
+ * Only free blocks larger than SEG_MAX_SIZE go into the tree.
+ *
+ * TLSF index
+ *
+ * Every step of tree_find loads a node from somewhere else in the heap, so in a big heap a search costs
+ * about one cache miss per level of the tree. Built with MM_INDEX_TLSF, mm.c keeps the free blocks larger
+ * than SEG_MAX_SIZE in two-level segregated fit lists instead of the tree: the first level is the power of
+ * two below the size, the second level splits it into TLSF_SL_COUNT classes of equal width. The lists use
+ * the same links as the segregated lists, and a bitmap of the non-empty first levels plus one of the
+ * non-empty classes of each first level locate a fitting class with two find-first-sets, however many
+ * blocks are free. The price is a good fit rather than the best fit: tlsf_find only compares the first
+ * TLSF_PROBE blocks of the class of the request before taking the head of a larger class.
+ *
+ * Placement and growth policies
+ *
+ * mm_setopt(MM_OPT_PLACEMENT) selects which free block serves a request. MM_PLACE_BEST takes the
+ * smallest one that fits; within a size, the tree prefers the lowest address but the segregated lists
+ * hand out the block freed last. MM_PLACE_BEST_ADDR keeps the lists (segregated and TLSF) in address
+ * order as well, which packs the live blocks towards the bottom of the heap at the price of a linear
+ * insertion into the list. MM_PLACE_FIRST takes the first fitting block the search comes across (the
+ * first node on the path down the tree, the head of the class in the lists) instead of searching on for
+ * a better one. MM_PLACE_NEXT remembers the free rest of the block split last (the rover) and keeps carving
+ * requests out of it for as long as they fit, without any search, so that consecutive requests end up
+ * next to each other; it falls back to first fit. The rover is forgotten as soon as its block leaves the index.
+ *
+ * mm_setopt(MM_OPT_GROWTH) selects how far the heap grows when no free block fits: exactly what the
+ * request lacks (MM_GROW_EXACT), that rounded up to CHUNKSIZE (MM_GROW_CHUNK), or a quarter of the heap
+ * (MM_GROW_GEOMETRIC), so that a growing heap needs a logarithmic number of mem_sbrk calls. The surplus
+ * stays below half of trim_threshold, so the next mm_free at the top of the heap does not give it back.
+ * MM_GROW_HUGE moves the break up to the next HUGE_PAGE_SIZE boundary (memlib aligns the heap region to it),
+ * short of it by WSIZE so that the blocks stay aligned, and asks for transparent huge pages there with madvise(MADV_HUGEPAGE), so that a large heap takes one
+ * TLB entry per 2 MiB rather than per 4 KiB; heap_shrink then only gives back whole huge pages, keeping
+ * the break on a boundary.
+ *
+ * With mm_setopt(MM_OPT_NUMA), heap_advise also binds what the heap grows by to the NUMA node of the
+ * thread that grows it (mbind with MPOL_PREFERRED, so the pages may still come from another node when that
+ * one is full). Where mbind is missing or turned down (no NUMA support in the kernel, or a container that
+ * forbids it), the first failure turns the option off and the heap grows as if it had never been set.
+ *
+ * Quick cache
+ *
+ * Freeing a block coalesces it and indexes the result, and a following request of the same size splits
+ * it again and takes it out of the index: in a loop that recycles blocks of a few sizes, all of that
+ * work is undone right away. With mm_setopt(MM_OPT_QUICK_MAX), mm_free holds blocks of up to quick_max
+ * bytes in a quick cache instead: one list per exact size (one class every 16 bytes, linked like the
+ * segregated lists), with the H bit set. A held block keeps looking allocated to its neighbours, so
+ * nothing coalesces with it, and mm_malloc pops a block of the exact size off its list before looking
+ * at the index. Coalescing is only deferred: once more than QUICK_LIMIT bytes are held, when the heap
+ * would otherwise have to grow, and in mm_trim, quick_flush empties the cache in a single pass that frees
+ * every held block for real, so the held blocks merge with each other and with their free neighbours,
+ * and fragmentation stays bounded. A block is never held at the top of the heap (right below the free
+ * last block or the epilogue), where it would keep the heap from shrinking.
+ *
+ * Hardened build
+ *
+ * Built with MM_HARDENED, mm.c guards its blocks against the usual heap bugs at a small cost per request:
+ *  - every block ends with a canary of GUARD_SIZE bytes, a secret (drawn at mm_init) mixed with the
+ *    address of the block, so that an overflow of the payload is caught before it reaches the header of
+ *    the next block;
+ *  - the top 16 bits of the current size of an allocated block hold a tag, a hash of the secret, the
+ *    address and the size of the block, so that a corrupted header (or a pointer that mm_malloc never
+ *    returned) is caught;
+ *  - mm_free does not free a block right away but poisons its first POISON_MAX bytes and appends it to a
+ *    FIFO quarantine with the H bit set; once the quarantine holds more than QUARANTINE_BYTES, the oldest
+ *    block is checked for writes after free and freed for real, so a dangling pointer does not see the
+ *    block reused at once and a second mm_free of it is caught.
+ * mm_free and mm_realloc check the tag and the canary of the block they are given, and mm_checkheap
+ * those of every allocated block. A bad block is reported, counted in mm_stats and never freed, so the
+ * heap itself stays consistent. Slab objects have no header to tag: an object keeps its canary in its
+ * last GUARD_SIZE bytes (a request of slab_max-GUARD_SIZE bytes at most is served by a slab), a pointer
+ * that is not the start of an object of its slab counts as a header violation, and a freed object has
+ * its first SLAB_POISON_MAX bytes poisoned and goes to a ring of its own, SLAB_QUARANTINE objects long,
+ * with its bit in the bitmap of its slab clear, so that freeing it again is caught. The quick cache would bypass the quarantine, so
+ * it is off in this build.
+ *
+ * Heap profile
+ *
+ * Built with MM_PROFILE and given a rate with mm_setopt(MM_OPT_PROF_RATE), mm_malloc samples about one
+ * request in every prof_rate bytes allocated: prof_countdown counts down the bytes requested, and the
+ * request that reaches zero is served by prof_malloc, which draws the next distance from an exponential
+ * distribution of mean prof_rate, so that every byte has the same chance of being picked. A sampled
+ * block always comes from the heap or a mapping of its own, sets the S bit, and is recorded in mm_prof.c
+ * with the stack of its caller; mm_free hands it back to mm_prof.c when it sees the S bit. mm_realloc
+ * counts as a mm_free and a new request of the new size, sampled the same way (the mm_malloc that may
+ * move the block is kept from sampling it too). Requests that are not sampled only pay the subtraction.
+ *
+ * Checking the heap
+ *
+ * mm_checkheap walks every block and cross-checks the indices against the heap, which takes time in
+ * proportion to the whole heap. mm_checkheap_incremental(budget) checks only the next budget blocks (then
+ * slabs) after the ones checked by the last call, so a long-running program can keep checking its heap at
+ * a fixed cost per call. Every block is checked in constant time against itself and its neighbours: its
+ * size and the copy of it in the next header, no two free blocks in a row, the links of a free block in
+ * its list or in the tree (to its parent and children, which must be ordered and coloured right), the
+ * links of a held block in the quick cache, and, in the hardened build, the tag and canary of an allocated
+ * one. The cursor survives the calls in between: a block that swallows the block under it (coalescing,
+ * mm_realloc, trimming) moves it back to its own start (check_absorb). mm_checkheap_sampled(samples) checks
+ * random free blocks instead, found from the indices, together with the blocks on both sides of them, and
+ * random slabs. Both only print errors, and return how many they found.
+ *
+ * Trimming
+ *
+ * When mm_free leaves a free block of at least trim_threshold bytes at the top of the heap, the block
+ * is given back to the system by moving the break down (mem_sbrk with a negative increment), so the
+ * heap shrinks again after a load spike. mm_trim does the same on request, keeping pad bytes at the
+ * top, and also releases the pages inside large free blocks elsewhere in the heap with
+ * madvise(MADV_DONTNEED). The first MIN_BLOCK_SIZE bytes of a free block hold its header and links,
+ * so they are never released.
+ *
+ * Huge blocks
+ *
+ * Requests of at least mmap_threshold bytes do not touch the heap at all: each one gets a private
+ * mapping of its own, with the usual header at the start of the mapping, the whole mapping as the
+ * current size and the M bit set. mm_free unmaps such a block, and mm_realloc resizes it with
+ * mremap, which moves the pages instead of copying the data. The heap therefore never has to grow
+ * (and fragment) for a big buffer.
+ *
+ * Zeroed blocks
+ *
+ * mm_calloc clears only the part of a block that may have been written before. Everything above the
+ * break reads as zero (memlib.c clears what it gives back), and mm_malloc writes headers and links around
+ * the payload it returns but never into it, so the bytes of a block at or above the break of before the
+ * request need no clearing; nor does a huge block, a fresh mapping. A large calloc that grows the heap
+ * therefore costs no memset at all. In a heap image the file keeps what lay above the break, and every
+ * block is cleared.
+ *
+ * Aligned blocks
+ *
+ * A block is aligned to ALIGNMENT by its header. mm_memalign and mm_aligned_alloc take a larger one out of
+ * the index, so that an aligned payload fits in it wherever the boundary falls: the slack in front of the
+ * boundary (none, or at least MIN_BLOCK_SIZE bytes) goes back to the index as a free block, and the rest
+ * after the payload is split off as usual. The block is then an ordinary one, freed and resized like the
+ * others. mm_free_sized frees a block given its size, and mm_usable_size returns what it holds.
+ *
+ * Slabs
+ *
+ * With the header and the tree links, a 16-byte request costs a 48-byte block. Requests of at most
+ * slab_max bytes are therefore served from slabs instead: SLAB_PAGE_SIZE-byte pages carved out of a
+ * region of their own (reserved with mmap on first use, next to the heap rather than inside it), each
+ * holding objects of a single size class (one class every 16 bytes) with no header at all.
+ *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- slab (page aligned)
+ * |  Address of the first free object                             |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Address of the first object never handed out                 |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Size class (SLAB_NONE: spare)|  Objects in use               |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Garbage                    |P|  Objects in the quarantine    |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Bitmap of the objects handed out (four words)                |
+ * .                                                               .
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Address of the next slab in the list                         |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Address of the previous slab in the list                     |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- first object
+ * .                                                               .
+ * .  Objects (the first word of a free object links the next one) .
+ * .                                                               .
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ * mm_free and mm_realloc recognize an object by its address alone (it lies between slab_lo and
+ * slab_top), and find its slab, and hence its size class, by rounding the address down to the page.
+ * Slabs with free objects are kept in a list per class (the P bit is set while a slab is on it).
+ * An object's bit in the bitmap is set while it is handed out, so that freeing it twice is caught
+ * (as the free bit of a heap block catches it) instead of linking it into the free list twice. What
+ * mm_malloc and mm_free touch is in the first cache line of the header; the list links are after it.
+ * A slab whose last object is freed becomes a spare page for any class, unless it is the only slab
+ * left in the list of its class. mm_trim gives the spare pages at the top of the region back to the system.
+ *
+ * Heap images
+ *
+ * With the heap in a file mapped at a fixed address (mem_init_mapped in memlib.c), every block, and every
+ * pointer between blocks (the links of the tree, with tree_root and tree_null at the bottom of the heap, and
+ * those of the lists), is where it was when the file is mapped again by a later process. What lives outside the
+ * heap is saved by mm_detach into the root area of the image (mem_image_root) as an image_t: the heads and
+ * bitmaps of the segregated and TLSF lists, the rover, the quarantine and the secret of the hardened build,
+ * and a root pointer given by the program to find its own data again. mm_attach loads it back instead of
+ * calling mm_init, so a process that restarts finds its heap as it left it, without rebuilding anything.
+ * The quick cache is emptied by mm_detach, and slabs and huge blocks live in mappings of their own, which do
+ * not survive the process, so both are off (slab_max is 0 and mmap_threshold infinite) while the heap is an image.
+ *
+ * The image is only consistent between mm_detach and the next mm_attach or mm_init, which is what the
+ * clean flag of the image_t says: mm_attach turns down an image that was not detached, or was written by a
+ * build with another index or hardening (its config), and checks its boundaries (the prologue, the top block,
+ * the heads of the index), or with validate every block as mm_checkheap_incremental does. The flag goes to
+ * the file before anything else changes, so an image of a process that died is never taken for a clean one.
+ *
+ * Statistics
+ *
+ * mm_stats returns a snapshot of the heap: its current and peak size, the free space and how much of it
+ * is in the largest free block, and the shape of the tree. When mm.c is built with MM_STATS, the snapshot
+ * also carries event counters updated on the hot paths: requests by size class, tree_find searches,
+ * splits and coalesces, and which branch mm_realloc took. Without MM_STATS, the STAT macro expands to
+ * nothing, so the counters cost nothing.
  *
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef MM_HARDENED
+#include <time.h>
+#include <sys/random.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#ifdef MM_PROFILE
+#include "mm_prof.h"
+#endif
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -88,10 +309,33 @@ team_t team = {
 #define DSIZE 16
 #define CHUNKSIZE (1<<12)
 
+/*With MM_GROW_GEOMETRIC, the heap grows by at least 1/GEOMETRIC_DIVISOR of its size*/
+#define GEOMETRIC_DIVISOR 4
+
+/*With MM_GROW_HUGE, the break stays on a boundary of this many bytes (a transparent huge page)*/
+#define HUGE_PAGE_SIZE (2UL<<20)
+
+/*Memory policy of mbind that prefers a node but falls back to the others (from the kernel's mempolicy.h)*/
+#define MPOL_PREFERRED 1
+
 #define HEADER_SIZE 16 
 #define MIN_BLOCK_SIZE 48
 #define FAIL ((void*)-1)
 
+#define DEFAULT_TRIM_THRESHOLD (128*1024)
+#define DEFAULT_MMAP_THRESHOLD (1024*1024)
+
+/*Update an event counter of mm_stats, only when built with MM_STATS*/
+#ifdef MM_STATS
+#define STAT(stmt) do{ stmt; }while(0)
+#else
+#define STAT(stmt) do{ }while(0)
+#endif
+
+/*A block grown by mm_realloc more than once gets 1/GROWTH_FACTOR of its size as slack, but never more than MAX_GROWTH_SLACK bytes*/
+#define GROWTH_FACTOR 2
+#define MAX_GROWTH_SLACK (256*1024)
+
 /*pointer macros*/
 /*Pack a size and freed bit into a word*/
 #define PACK(size,free) ((size)|(free))
@@ -109,10 +353,20 @@ team_t team = {
 #define PREV_SIZE_MASKED(p) (PREV_SIZE(p) & ~0xf)
 #define PREV_FREE(p) (PREV_SIZE(p) & 0x1)
 
+/*The bits of the current size that hold the size itself: the low 4 bits hold flags, bit 47 the S bit of MM_PROFILE
+ * and the top 16 bits the tag of MM_HARDENED*/
+#define SIZE_MASK 0x00007ffffffffff0UL
+#define SAMPLED_BIT (1UL<<47)
+#define TAG_SHIFT 48
+
 /*Given the starting ptr p, read the size and allocated fields of the current block*/
 #define CUR_SIZE(p) (*(size_t*)((p)+8))
-#define CUR_SIZE_MASKED(p) (CUR_SIZE(p) & ~0xf)
+#define CUR_SIZE_MASKED(p) (CUR_SIZE(p) & SIZE_MASK)
 #define CUR_FREE(p) (CUR_SIZE(p) & 0x1)
+#define CUR_MMAPPED(p) (CUR_SIZE(p) & 0x2)
+#define CUR_GROWN(p) (CUR_SIZE(p) & 0x4)
+#define CUR_HELD(p) (CUR_SIZE(p) & 0x8)
+#define CUR_SAMPLED(p) (CUR_SIZE(p) & SAMPLED_BIT)
 
 /*Given the starting ptr p, compute address of the block ptr bp*/
 #define USER_BLOCK(p) ((p)+HEADER_SIZE)
@@ -121,8 +375,21 @@ team_t team = {
 #define PREV_BLOCK(p,sz) ((p)-(sz))
 #define NEXT_BLOCK(p,sz) ((p)+(sz))
 
+/*Given a pointer p, determine whether it may point to a block of the heap (end is the epilogue)*/
+#define IN_HEAP(p,end) ((void*)(p)>=mem_heap_lo()+MIN_BLOCK_SIZE && (void*)(p)<(end) && ((uintptr_t)(p) & (DSIZE-1))==0)
+
+/*Largest block size kept in the segregated lists, and the number of (exact) size classes*/
+#define SEG_MAX_SIZE 512
+#define SEG_CLASSES ((SEG_MAX_SIZE-MIN_BLOCK_SIZE)/DSIZE+1)
+
+/*Given the size of a block, compute the index of its segregated list*/
+#define SEG_INDEX(size) (((size)-MIN_BLOCK_SIZE)/DSIZE)
+
+/*Given the starting ptr p of a free block, determine whether it is tracked by a segregated list*/
+#define IS_IN_SEG(p) (CUR_SIZE_MASKED(p)<=SEG_MAX_SIZE)
+
 /*Given the starting ptr p of a free block, determine whether it is tracked by a Red-black Tree or not*/
-#define IS_IN_TREE(p) (CUR_SIZE_MASKED(p)>=MIN_BLOCK_SIZE)
+#define IS_IN_TREE(p) (CUR_SIZE_MASKED(p)>SEG_MAX_SIZE)
 
 /*The following macors are mainly for the free blocks*/
 /*Given the starting ptr p, read the addresses of the left and right children of this free block in the Red-black Tree*/
@@ -135,9 +402,231 @@ team_t team = {
 /*Given the starting ptr p, read the color(Red/Black) from the corresponding field of the free block*/
 #define IS_RED(p) ((*(int*)((p)+40)))
 
+/*Longest walk down a list of free blocks of mm_checkheap_sampled*/
+#define LIST_SAMPLE_STEPS 32
+
+/*Given two nodes a and b of the Red-black Tree, determine whether a comes before b in it (by size, then by address)*/
+#define TREE_BEFORE(a,b) (CUR_SIZE_MASKED(a)<CUR_SIZE_MASKED(b) || (CUR_SIZE_MASKED(a)==CUR_SIZE_MASKED(b) && (a)<(b)))
+
+/*Given the starting ptr p of a free block in a segregated list, read the addresses of its neighbours in the list*/
+#define SEG_NEXT(p) LEFT_CHILD(p)
+#define SEG_PREV(p) RIGHT_CHILD(p)
+
+#ifdef MM_INDEX_TLSF
+/*Second-level classes per power of two, the first level of the smallest block above SEG_MAX_SIZE, and the number of first levels*/
+#define TLSF_SL_BITS 4
+#define TLSF_SL_COUNT (1<<TLSF_SL_BITS)
+#define TLSF_FL_MIN 9
+#define TLSF_FL_COUNT (48-TLSF_FL_MIN)
+
+/*Blocks of the exact class of a request that tlsf_find looks at before moving on to the next class*/
+#define TLSF_PROBE 8
+#endif
+
+/*Bytes at the end of every block for the canary of MM_HARDENED, the poison of a freed block, how many of its bytes
+ * are poisoned (of a slab object: only its first words, as slab objects are freed far more often), the size of the
+ * quarantine, and the number of objects in the quarantine of slab objects*/
+#ifdef MM_HARDENED
+#define HARDENED 1
+#define GUARD_SIZE 8
+#else
+#define HARDENED 0
+#define GUARD_SIZE 0
+#endif
+#define POISON_WORD 0xdfdfdfdfdfdfdfdfUL
+#define POISON_MAX 64
+#define SLAB_POISON_MAX 16
+#define QUARANTINE_BYTES (256*1024)
+#define SLAB_QUARANTINE 256
+
+/*Whether sampled requests are recorded in a heap profile (mm_prof.c)*/
+#ifdef MM_PROFILE
+#define PROFILE 1
+#else
+#define PROFILE 0
+#endif
+
+/*Run a statement only in the hardened build*/
+#ifdef MM_HARDENED
+#define GUARD(stmt) do{ stmt; }while(0)
+#else
+#define GUARD(stmt) do{ }while(0)
+#endif
+
+/*Largest block size that can be held in the quick cache, the number of its classes, and the held bytes that trigger quick_flush*/
+#define QUICK_MAX_SIZE 1024
+#define QUICK_CLASSES ((QUICK_MAX_SIZE-MIN_BLOCK_SIZE)/DSIZE+1)
+#define QUICK_LIMIT (256*1024)
+
+/*Given the starting ptr p of a block held in the quick cache, read the addresses of its neighbours in its list*/
+#define QUICK_NEXT(p) LEFT_CHILD(p)
+#define QUICK_PREV(p) RIGHT_CHILD(p)
+
+/*Size of a slab, of the address space reserved for slabs, and of the header of a slab*/
+#define SLAB_PAGE_SIZE 4096
+#define SLAB_REGION_SIZE (1UL<<32)
+#define SLAB_HEADER_SIZE 80
+
+/*Words of the bitmap of a slab, a bit for every DSIZE bytes of objects (at most 251)*/
+#define SLAB_USED_WORDS 4
+
+/*Largest object size of a slab class, and the number of classes*/
+#define SLAB_MAX_SIZE 256
+#define SLAB_CLASSES (SLAB_MAX_SIZE/DSIZE)
+#define DEFAULT_SLAB_MAX SLAB_MAX_SIZE
+
+/*Size class of a spare slab*/
+#define SLAB_NONE 0xffffffffu
+
+/*Given the size of a request (1 to SLAB_MAX_SIZE bytes), compute its slab class; given a class, the object size and the number of objects of a slab*/
+#define SLAB_CLASS_OF(size) (((size)-1)/DSIZE)
+#define SLAB_OBJ_SIZE(cls) (((cls)+1)*DSIZE)
+#define SLAB_CAPACITY(cls) ((SLAB_PAGE_SIZE-SLAB_HEADER_SIZE)/SLAB_OBJ_SIZE(cls))
+
+/*Given the size of a request, determine whether a slab serves it and compute its class (the last GUARD_SIZE bytes
+  of an object hold its canary in the hardened build)*/
+#define SLAB_SERVES(size) (slab_max>GUARD_SIZE && (size)<=slab_max-GUARD_SIZE)
+#define SLAB_CLASS_FOR(size) ((size)+GUARD_SIZE==0 ? 0 : SLAB_CLASS_OF((size)+GUARD_SIZE))
+
+/*Given the start s of a slab and one of its objects p, compute the bit of p in the bitmap (that of its first DSIZE bytes,
+  which needs no division by the object size), and the word and mask of bit i*/
+#define SLAB_INDEX(s,p) ((unsigned int)((size_t)((p)-SLAB_FIRST(s))/DSIZE))
+#define SLAB_USED_WORD(s,i) (SLAB_USED(s)[(i)/64])
+#define SLAB_USED_BIT(i) (1UL<<((i)%64))
+
+/*Given a user ptr p, determine whether it is an object of a slab, and compute the start of that slab*/
+#define IS_SLAB(p) ((void*)(p)>=slab_lo && (void*)(p)<slab_top)
+#define SLAB_OF(p) ((void*)((uintptr_t)(p) & ~(uintptr_t)(SLAB_PAGE_SIZE-1)))
+
+/*Given the start s of a slab, read the fields of its header*/
+#define SLAB_FREE(s) (*(void**)(s))
+#define SLAB_BUMP(s) (*(void**)((s)+8))
+#define SLAB_CLASS(s) (*(unsigned int*)((s)+16))
+#define SLAB_IN_USE(s) (*(unsigned int*)((s)+20))
+#define SLAB_LISTED(s) (*(int*)((s)+24))
+#define SLAB_HELD(s) (*(unsigned int*)((s)+28))
+#define SLAB_USED(s) ((unsigned long*)((s)+32))
+#define SLAB_NEXT(s) (*(void**)((s)+64))
+#define SLAB_PREV(s) (*(void**)((s)+72))
+#define SLAB_FIRST(s) ((s)+SLAB_HEADER_SIZE)
+
+/*Given an object p of class cls, read its canary (MM_HARDENED)*/
+#define SLAB_CANARY(p,cls) (*(uintptr_t*)((p)+SLAB_OBJ_SIZE(cls)-GUARD_SIZE))
+
 /*root and null node(the prologue and epilogue) of Red-black Tree*/
 void *tree_root, *tree_null;
 
+/*heads of the segregated lists, and a bitmap of the non-empty ones*/
+void *seg_heads[SEG_CLASSES];
+unsigned long seg_bitmap;
+
+#ifdef MM_INDEX_TLSF
+/*heads of the TLSF lists of large free blocks, a bitmap of the first levels with a non-empty list, and one of the non-empty lists per first level*/
+void *tlsf_heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+unsigned long tlsf_fl_bitmap;
+unsigned int tlsf_sl_bitmap[TLSF_FL_COUNT];
+#endif
+
+/*free space at the top of the heap that triggers trimming, and the number of bytes given back so far*/
+size_t trim_threshold=DEFAULT_TRIM_THRESHOLD;
+size_t released_bytes;
+
+/*placement and growth policies (MM_PLACE_*, MM_GROW_*), and the rest of the block split last (MM_PLACE_NEXT)*/
+int placement=MM_PLACE_BEST;
+int growth=MM_GROW_EXACT;
+void *rover;
+
+/*whether heap growth is bound to the NUMA node of the growing thread (MM_OPT_NUMA), and the bytes bound so far*/
+int numa_bind;
+size_t numa_bound_bytes;
+
+/*largest block held in the quick cache (0: none), the lists of held blocks by size, and their number and size*/
+size_t quick_max;
+void *quick_heads[QUICK_CLASSES];
+size_t quick_blocks, quick_bytes;
+
+/*secret of the canaries and tags of MM_HARDENED, and the quarantine: a FIFO list of freed blocks, their number and size*/
+uintptr_t guard_secret;
+void *quarantine_head, *quarantine_tail;
+size_t quarantine_blocks, quarantine_bytes;
+
+/*next block (or slab) mm_checkheap_incremental looks at (NULL: the bottom of the heap), and the state of the random
+ * generator of mm_checkheap_sampled*/
+void *check_cursor;
+unsigned long check_rng=88172645463325252UL;
+
+/*mean number of bytes allocated between two requests sampled for the heap profile of MM_PROFILE (0: none), and the
+ * bytes left before the next one*/
+size_t prof_rate;
+size_t prof_countdown=(size_t)-1;
+
+/*smallest request served by its own mapping, and the number of bytes currently mapped that way*/
+size_t mmap_threshold=DEFAULT_MMAP_THRESHOLD;
+size_t mapped_bytes;
+
+/*largest request served by a slab (0: none), the reserved slab region and the end of the slabs carved out of it,
+ * the lists of slabs with free objects by class, and the list of spare slabs*/
+size_t slab_max=DEFAULT_SLAB_MAX;
+void *slab_lo, *slab_top;
+void *slab_partial[SLAB_CLASSES];
+void *slab_spare;
+
+/*quarantine of slab objects (MM_HARDENED): a ring of freed objects, the next slot to fill (that of the oldest object once
+ * the ring is full), and the number and size of the objects in it*/
+void *slab_quarantine[SLAB_QUARANTINE];
+unsigned int slab_quarantine_next;
+size_t slab_quarantine_blocks, slab_quarantine_bytes;
+
+/*State of the allocator outside the heap, saved by mm_detach in the root area of a heap image*/
+#define IMAGE_MAGIC 0x4547414d49504145UL
+#define IMAGE_VERSION 1
+#ifdef MM_INDEX_TLSF
+#define IMAGE_INDEX 1
+#else
+#define IMAGE_INDEX 0
+#endif
+#define IMAGE_CONFIG (IMAGE_VERSION | IMAGE_INDEX<<8 | HARDENED<<9)
+
+typedef struct {
+    uint64_t magic;
+    uint32_t config;            /*IMAGE_CONFIG of the build that wrote it*/
+    uint32_t clean;             /*set by mm_detach, cleared by mm_attach and mm_init*/
+    void *heap_lo;
+    size_t heap_size;
+    void *user_root;            /*the pointer given to mm_detach*/
+    void *seg_heads[SEG_CLASSES];
+    unsigned long seg_bitmap;
+#ifdef MM_INDEX_TLSF
+    void *tlsf_heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    unsigned long tlsf_fl_bitmap;
+    unsigned int tlsf_sl_bitmap[TLSF_FL_COUNT];
+#endif
+    void *rover;
+    uintptr_t guard_secret;
+    void *quarantine_head, *quarantine_tail;
+    size_t quarantine_blocks, quarantine_bytes;
+    size_t released_bytes, realloc_copies, peak_heap_size;
+} image_t;
+
+_Static_assert(sizeof(image_t)<=MEM_IMAGE_ROOT_SIZE, "image_t does not fit in the root area of a heap image");
+
+/*number of mm_realloc calls that had to move the data*/
+size_t realloc_copies;
+
+/*largest heap size since mm_init, and the event counters of mm_stats (only updated with MM_STATS)*/
+size_t peak_heap_size;
+mm_stats_t counters;
+
+/*
+ * image_dirty - clear the clean flag of the heap image and write it to the file, before the heap changes.
+ */
+void image_dirty(image_t *image){
+    uintptr_t page=mem_pagesize();
+
+    image->clean=0;
+    msync((void *)((uintptr_t)image & ~(page-1)), page, MS_SYNC);
+}
+
 /* 
  * mm_init - initialize the malloc package.
  */
@@ -159,9 +648,135 @@ int mm_init(void)
      * Recorded by the last WSIZE bytes.*/
     PREV_SIZE(NEXT_BLOCK(tree_root, MIN_BLOCK_SIZE))=0;
     CUR_SIZE(tree_root)=MIN_BLOCK_SIZE;
+
+    /*All segregated lists start out empty*/
+    memset(seg_heads, 0, sizeof(seg_heads));
+    seg_bitmap=0;
+    rover=NULL;
+    check_cursor=NULL;
+    memset(quick_heads, 0, sizeof(quick_heads));
+    quick_blocks=quick_bytes=0;
+    quarantine_head=quarantine_tail=NULL;
+    quarantine_blocks=quarantine_bytes=0;
+#ifdef MM_HARDENED
+    if(getrandom(&guard_secret, sizeof(guard_secret), GRND_NONBLOCK)!=sizeof(guard_secret)){
+        guard_secret=(uintptr_t)&guard_secret ^ ((uintptr_t)__builtin_frame_address(0)<<16) ^ (uintptr_t)time(NULL);
+    }
+#endif
+#ifdef MM_INDEX_TLSF
+    memset(tlsf_heads, 0, sizeof(tlsf_heads));
+    memset(tlsf_sl_bitmap, 0, sizeof(tlsf_sl_bitmap));
+    tlsf_fl_bitmap=0;
+#endif
+    released_bytes=0;
+    mapped_bytes=0;
+    realloc_copies=0;
+
+    /*Drop every slab*/
+    if(slab_lo!=NULL){
+        munmap(slab_lo, SLAB_REGION_SIZE);
+    }
+    slab_lo=slab_top=NULL;
+    memset(slab_partial, 0, sizeof(slab_partial));
+    slab_spare=NULL;
+    memset(slab_quarantine, 0, sizeof(slab_quarantine));
+    slab_quarantine_next=0;
+    slab_quarantine_blocks=slab_quarantine_bytes=0;
+
+    peak_heap_size=mem_heapsize();
+    memset(&counters, 0, sizeof(counters));
+#ifdef MM_PROFILE
+    /*the sampled blocks are gone with the heap*/
+    prof_reset();
+#endif
+
+    /*A heap image holds neither slabs nor huge blocks, and is no longer the one mm_detach left*/
+    if(mem_image_root()!=NULL){
+        slab_max=0;
+        mmap_threshold=(size_t)-1;
+        image_dirty(mem_image_root());
+    }
     return 0;
 }
 
+/*
+ * mm_setopt - set a tuning option (MM_OPT_* in mm.h). Options survive mm_init. Return 0 on success, -1 for an unknown option or a value out of range.
+ */
+int mm_setopt(int option, size_t value)
+{
+    switch(option){
+    case MM_OPT_TRIM_THRESHOLD:
+        trim_threshold=value;
+        return 0;
+    case MM_OPT_MMAP_THRESHOLD:
+        if(mem_image_root()!=NULL && value!=(size_t)-1){
+            return -1;
+        }
+        mmap_threshold=value;
+        return 0;
+    case MM_OPT_SLAB_MAX:
+        if(value>(mem_image_root()!=NULL ? 0 : SLAB_MAX_SIZE)){
+            return -1;
+        }
+        slab_max=value;
+        return 0;
+    case MM_OPT_QUICK_MAX:
+        if(value>(HARDENED ? 0 : QUICK_MAX_SIZE)){
+            return -1;
+        }
+        /*blocks already held keep their place until the next flush*/
+        quick_max=value;
+        return 0;
+    case MM_OPT_PLACEMENT:
+        if(value>MM_PLACE_NEXT){
+            return -1;
+        }
+        placement=value;
+        return 0;
+    case MM_OPT_GROWTH:
+        if(value>MM_GROW_HUGE){
+            return -1;
+        }
+        growth=value;
+        return 0;
+    case MM_OPT_NUMA:
+#ifdef SYS_mbind
+        if(value>1){
+            return -1;
+        }
+        numa_bind=value;
+        return 0;
+#else
+        return value>0 ? -1 : 0;
+#endif
+    case MM_OPT_PROF_RATE:
+#ifdef MM_PROFILE
+        prof_rate=value;
+        prof_countdown=value>0 ? prof_interval(value) : (size_t)-1;
+        return 0;
+#else
+        return value>0 ? -1 : 0;
+#endif
+    default:
+        return -1;
+    }
+}
+
+#ifdef MM_STATS
+/*
+ * stat_class - compute the size class of a request in mm_stats.
+ */
+static inline int stat_class(size_t size){
+    int cls;
+
+    if(size<16){
+        return 0;
+    }
+    cls=63-__builtin_clzl(size)-3;
+    return cls<MM_STATS_CLASSES ? cls : MM_STATS_CLASSES-1;
+}
+#endif
+
 /*The following functions of Red-black Tree are helper functions for the implementation of mm_malloc and mm_free. 
  * Note that in these functions, LEFT_CHILD(tree_root) always points to the TRUE Root of the Red-black Tree.*/
 
@@ -170,8 +785,16 @@ int mm_init(void)
  */
 void *tree_find(size_t size){
     void *node=LEFT_CHILD(tree_root), *best=tree_null;
+#ifdef MM_STATS
+    size_t depth=0;
+
+    counters.finds++;
+#endif
     
     while(node!=tree_null){
+#ifdef MM_STATS
+        depth++;
+#endif
 	if(CUR_SIZE_MASKED(node)<size){
 	    node=RIGHT_CHILD(node);
 	}else{
@@ -179,9 +802,44 @@ void *tree_find(size_t size){
 	    node=LEFT_CHILD(node);
 	}
     }
+#ifdef MM_STATS
+    counters.find_nodes+=depth;
+    if(depth>counters.find_max_depth){
+        counters.find_max_depth=depth;
+    }
+#endif
     return best;
 }
 
+/*
+ * tree_find_first - (First-fit Policy) find the first free block larger than or equal to size on the path down the tree.
+ */
+void *tree_find_first(size_t size){
+    void *node=LEFT_CHILD(tree_root);
+#ifdef MM_STATS
+    size_t depth=0;
+
+    counters.finds++;
+#endif
+
+    while(node!=tree_null){
+#ifdef MM_STATS
+        depth++;
+#endif
+        if(CUR_SIZE_MASKED(node)>=size){
+            break;
+        }
+        node=RIGHT_CHILD(node);
+    }
+#ifdef MM_STATS
+    counters.find_nodes+=depth;
+    if(depth>counters.find_max_depth){
+        counters.find_max_depth=depth;
+    }
+#endif
+    return node;
+}
+
 /*
  * tree_find_exact - check whether a block is a node of the Red-black Tree or not.
  * */
@@ -469,208 +1127,1421 @@ void tree_insert(void *node){
 
 
 
-/*With these helper functions in hand, now we are ready to implement mm_malloc, mm_free and mm_realloc*/
+/*The following functions maintain the segregated lists of small free blocks.*/
 
 /*
- * mm_malloc - Allocate a block
- *
- * If there exists a free block where the request fits, get the smallest one, segment it and allocate.
- * If there is no such block, increase brk.
+ * list_insert_ordered - insert node into the list starting at *head, which is kept in address order (MM_PLACE_BEST_ADDR).
  */
-void *mm_malloc(size_t size)
-{
-    size_t block_size, next_block_size;
-    void *free_block, *next_block;
+void list_insert_ordered(void **head, void *node){
+    void *prev=NULL, *next=*head;
 
-    block_size=ALIGN(HEADER_SIZE+size);
-    block_size=block_size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : block_size;
-    free_block=tree_find(block_size);
-    if(free_block==tree_null){/*no proper free block*/
-	/*set free_block to the end of last block and increase heap*/
-	free_block=mem_heap_hi()-WSIZE+1;
-	if(GET_FREE(free_block)){/*read from the header if the last block is free*/
-	    free_block=free_block-PREV_SIZE_MASKED(free_block);
-	    if(IS_IN_TREE(free_block)){
-		tree_delete(free_block);
-	    }
-	    /*Since this block is free, we only need to increase block-size minus size of this block*/
-	    mem_sbrk(block_size-CUR_SIZE_MASKED(free_block));
-	}else{/*the last block is not free*/
-	    mem_sbrk(block_size);
-	}
+    while(next!=NULL && next<node){
+        prev=next;
+        next=SEG_NEXT(next);
+    }
+    SEG_NEXT(node)=next;
+    SEG_PREV(node)=prev;
+    if(next!=NULL){
+        SEG_PREV(next)=node;
+    }
+    if(prev!=NULL){
+        SEG_NEXT(prev)=node;
     }else{
-        /*find a free block large enough*/
-	tree_delete(free_block);
-        next_block_size=CUR_SIZE_MASKED(free_block)-block_size;
-	if(next_block_size>0){
-            /*Divide the free block into two blocks, one for malloc and the other marked as free*/
-	    next_block=NEXT_BLOCK(free_block, block_size);
-            PREV_SIZE(NEXT_BLOCK(next_block,next_block_size))=next_block_size|1; /*set the header*/
-	    CUR_SIZE(next_block)=next_block_size|1;
-	    if(IS_IN_TREE(next_block)){
-		tree_insert(next_block);
-	    }
-	}
+        *head=node;
     }
-    CUR_SIZE(free_block)=block_size;
-    PREV_SIZE(NEXT_BLOCK(free_block,block_size))=block_size;
-    
-    return USER_BLOCK(free_block);
 }
 
+/*
+ * seg_insert - push node at the head of the list of its size class (or into its place with MM_PLACE_BEST_ADDR).
+ */
+void seg_insert(void *node){
+    int idx=SEG_INDEX(CUR_SIZE_MASKED(node));
 
+    if(placement==MM_PLACE_BEST_ADDR){
+        list_insert_ordered(&seg_heads[idx], node);
+    }else{
+        SEG_NEXT(node)=seg_heads[idx];
+        SEG_PREV(node)=NULL;
+        if(seg_heads[idx]!=NULL){
+            SEG_PREV(seg_heads[idx])=node;
+        }
+        seg_heads[idx]=node;
+    }
+    seg_bitmap|=1UL<<idx;
+}
 
 /*
- * mm_free - Freeing a block does nothing.
+ * seg_delete - unlink node from the list of its size class.
  */
-void mm_free(void *ptr)
-{
-    size_t size, new_size;
-    void *prev, *cur, *next, *new_block;
-
-    cur=ptr-HEADER_SIZE;
+void seg_delete(void *node){
+    int idx=SEG_INDEX(CUR_SIZE_MASKED(node));
 
-    if(CUR_FREE(cur)){
-	printf("Double Free Error: try to free an already freed memory block(%p).\n",cur);
-	return;
+    if(SEG_PREV(node)!=NULL){
+        SEG_NEXT(SEG_PREV(node))=SEG_NEXT(node);
+    }else{
+        seg_heads[idx]=SEG_NEXT(node);
+    }
+    if(SEG_NEXT(node)!=NULL){
+        SEG_PREV(SEG_NEXT(node))=SEG_PREV(node);
     }
+    if(seg_heads[idx]==NULL){
+        seg_bitmap&=~(1UL<<idx);
+    }
+}
 
-    new_block=cur;
-    new_size=CUR_SIZE_MASKED(cur);
+/*
+ * seg_find - (Best-fit Policy) return the head of the smallest non-empty class that fits size, NULL if none.
+ */
+void *seg_find(size_t size){
+    unsigned long classes;
 
-    /*coalesce with the previous block if free*/
-    if(PREV_FREE(cur)){
-	size=PREV_SIZE_MASKED(cur);
-	prev=PREV_BLOCK(cur,size);
-	if(IS_IN_TREE(prev)){
-	    tree_delete(prev);
-	}
-	new_block=prev;
-	new_size+=size;
+    classes=seg_bitmap & (~0UL<<SEG_INDEX(size));
+    if(classes==0){
+        return NULL;
     }
+    return seg_heads[__builtin_ctzl(classes)];
+}
 
-    /*coalesce with the next block if exists and free*/
-    size=CUR_SIZE_MASKED(cur);
-    next=NEXT_BLOCK(cur,size);
-    if(next+WSIZE<=mem_heap_hi() && CUR_FREE(next)){
-	size=CUR_SIZE_MASKED(next);
-	if(IS_IN_TREE(next)){
-	    tree_delete(next);
-	}
-	new_size+=size;
+#ifdef MM_INDEX_TLSF
+/*The following functions maintain the two-level segregated fit (TLSF) lists of large free blocks, used instead of the tree with MM_INDEX_TLSF.*/
+
+/*
+ * tlsf_mapping - compute the first level (power of two) and the second level (one of TLSF_SL_COUNT slices of it) of a size.
+ */
+static inline void tlsf_mapping(size_t size, int *fl, int *sl){
+    int log2=63-__builtin_clzl(size);
+
+    *sl=(size>>(log2-TLSF_SL_BITS)) & (TLSF_SL_COUNT-1);
+    *fl=log2-TLSF_FL_MIN;
+}
+
+/*
+ * tlsf_insert - push node at the head of the list of its class (or into its place with MM_PLACE_BEST_ADDR).
+ */
+void tlsf_insert(void *node){
+    int fl, sl;
+
+    tlsf_mapping(CUR_SIZE_MASKED(node), &fl, &sl);
+    if(placement==MM_PLACE_BEST_ADDR){
+        list_insert_ordered(&tlsf_heads[fl][sl], node);
+    }else{
+        SEG_NEXT(node)=tlsf_heads[fl][sl];
+        SEG_PREV(node)=NULL;
+        if(tlsf_heads[fl][sl]!=NULL){
+            SEG_PREV(tlsf_heads[fl][sl])=node;
+        }
+        tlsf_heads[fl][sl]=node;
     }
+    tlsf_sl_bitmap[fl]|=1U<<sl;
+    tlsf_fl_bitmap|=1UL<<fl;
+}
 
-    /*Setting the new free block after coalesce*/
-    CUR_SIZE(new_block)=new_size | 1;
-    PREV_SIZE(NEXT_BLOCK(new_block,new_size))=new_size | 1;
-    if(IS_IN_TREE(new_block)){
-	tree_insert(new_block);
+/*
+ * tlsf_delete - unlink node from the list of its class.
+ */
+void tlsf_delete(void *node){
+    int fl, sl;
+
+    tlsf_mapping(CUR_SIZE_MASKED(node), &fl, &sl);
+    if(SEG_PREV(node)!=NULL){
+        SEG_NEXT(SEG_PREV(node))=SEG_NEXT(node);
+    }else{
+        tlsf_heads[fl][sl]=SEG_NEXT(node);
+    }
+    if(SEG_NEXT(node)!=NULL){
+        SEG_PREV(SEG_NEXT(node))=SEG_PREV(node);
+    }
+    if(tlsf_heads[fl][sl]==NULL){
+        tlsf_sl_bitmap[fl]&=~(1U<<sl);
+        if(tlsf_sl_bitmap[fl]==0){
+            tlsf_fl_bitmap&=~(1UL<<fl);
+        }
     }
 }
 
 /*
- * mm_realloc_last_resort - Implemented simply in terms of mm_malloc and mm_free. It's a helper function 
- *                          that will be invoked by mm_realloc if there are no other options.
+ * tlsf_find - (Good-fit Policy) find a free block larger than or equal to size, tree_null if none.
+ * The class of size also holds blocks smaller than size, so the best fit among its first TLSF_PROBE blocks
+ * is taken if there is one; otherwise the head of the next non-empty class, any block of which fits.
+ * With MM_PLACE_FIRST or MM_PLACE_NEXT, only the head of the class of size is looked at.
  */
+void *tlsf_find(size_t size){
+    void *node, *best=tree_null;
+    unsigned long fl_map;
+    unsigned int sl_map;
+    int fl, sl, probes=0, max_probes;
+
+    STAT(counters.finds++);
+    /*every block in the lists is larger than SEG_MAX_SIZE, so any of them fits a smaller request*/
+    if(size<=SEG_MAX_SIZE){
+        size=SEG_MAX_SIZE+DSIZE;
+    }
+    tlsf_mapping(size, &fl, &sl);
+    max_probes=placement>=MM_PLACE_FIRST ? 1 : TLSF_PROBE;
+    for(node=tlsf_heads[fl][sl];node!=NULL && probes<max_probes;node=SEG_NEXT(node)){
+        probes++;
+        if(CUR_SIZE_MASKED(node)>=size && (best==tree_null || CUR_SIZE_MASKED(node)<CUR_SIZE_MASKED(best))){
+            best=node;
+            if(CUR_SIZE_MASKED(node)==size){
+                break;
+            }
+        }
+    }
+#ifdef MM_STATS
+    counters.find_nodes+=probes;
+    if((size_t)probes>counters.find_max_depth){
+        counters.find_max_depth=probes;
+    }
+#endif
+    if(best!=tree_null){
+        return best;
+    }
 
-void *mm_realloc_last_resort(void *ptr, size_t size)
-{
-    void *oldptr=ptr;
-    void *newptr;
-    size_t copySize;
+    sl_map=sl+1<TLSF_SL_COUNT ? tlsf_sl_bitmap[fl] & (~0U<<(sl+1)) : 0;
+    if(sl_map==0){
+        fl_map=tlsf_fl_bitmap & (~0UL<<(fl+1));
+        if(fl_map==0){
+            return tree_null;
+        }
+        fl=__builtin_ctzl(fl_map);
+        sl_map=tlsf_sl_bitmap[fl];
+    }
+    return tlsf_heads[fl][__builtin_ctz(sl_map)];
+}
+#endif
 
-    newptr=mm_malloc(size);
-    if(newptr==NULL)
-        return NULL;
-    copySize=CUR_SIZE_MASKED(oldptr-HEADER_SIZE)-HEADER_SIZE;
-    if(size<copySize){
-        copySize=size;
+/*The following functions dispatch a free block to the segregated lists or to the tree by its size.*/
+
+/*
+ * free_insert - start tracking a free block (of at least MIN_BLOCK_SIZE bytes).
+ */
+void free_insert(void *node){
+    if(IS_IN_SEG(node)){
+        seg_insert(node);
+    }else{
+#ifdef MM_INDEX_TLSF
+        tlsf_insert(node);
+#else
+        tree_insert(node);
+#endif
     }
-    memcpy(newptr,oldptr,copySize);
-    mm_free(oldptr);
-    return newptr;
 }
 
 /*
- * mm_realloc - 
+ * free_delete - stop tracking a free block.
  */
-void *mm_realloc(void *ptr, size_t size)
-{
-    void *oldptr=ptr-HEADER_SIZE;
-    void *old_next_block=NEXT_BLOCK(oldptr, CUR_SIZE_MASKED(oldptr));
-    void *newptr;
-    void *new_next_block;
-    size_t remainder_size;
-    size_t next_block_size;
-    
-    if(ptr==NULL){
-        newptr=mm_malloc(size);
-        return newptr;
+void free_delete(void *node){
+    if(node==rover){
+        rover=NULL;
+    }
+    if(IS_IN_SEG(node)){
+        seg_delete(node);
+    }else{
+#ifdef MM_INDEX_TLSF
+        tlsf_delete(node);
+#else
+        tree_delete(node);
+#endif
     }
+}
 
-    if(size==0){
-        mm_free(ptr);
-        return NULL;
+/*
+ * free_find - find a free block larger than or equal to size by the placement policy, tree_null if none.
+ * With MM_INDEX_TLSF, blocks larger than SEG_MAX_SIZE are found by good fit instead of best fit (see tlsf_find).
+ */
+void *free_find(size_t size){
+    void *node;
+
+    if(placement==MM_PLACE_NEXT && rover!=NULL && CUR_SIZE_MASKED(rover)>=size){
+        return rover;
     }
-    
-    if(old_next_block==(mem_heap_hi()-WSIZE+1)){
-        /*reaching the end of heap*/
-        if(ALIGN(size+HEADER_SIZE)<=CUR_SIZE_MASKED(oldptr)){
-            /*user requests to shrink the size*/
-            size=ALIGN(size+HEADER_SIZE);
-            if(size<CUR_SIZE_MASKED(oldptr)){
-                /*segment the current block into two blocks*/
-                remainder_size=CUR_SIZE_MASKED(oldptr)-size;
-                CUR_SIZE(oldptr)=size;
-                new_next_block=NEXT_BLOCK(oldptr,size);
-                PREV_SIZE(new_next_block)=size;
-                CUR_SIZE(new_next_block)=remainder_size | 1;
-                PREV_SIZE(NEXT_BLOCK(new_next_block,remainder_size))=remainder_size | 1;
-                if(IS_IN_TREE(new_next_block)){
-                    tree_insert(new_next_block);
-                }
-                newptr=oldptr+HEADER_SIZE;
-                return newptr;
-            }else{
-                newptr=oldptr+HEADER_SIZE;
-                return newptr;
-            }
-        }else{
-            /*user requests to increase the size, no other options*/
-            return mm_realloc_last_resort(ptr, size);
+    if(size<=SEG_MAX_SIZE){
+        node=seg_find(size);
+        if(node!=NULL){
+            return node;
         }
     }
+#ifdef MM_INDEX_TLSF
+    return tlsf_find(size);
+#else
+    if(placement>=MM_PLACE_FIRST){
+        return tree_find_first(size);
+    }
+    return tree_find(size);
+#endif
+}
 
-    if(ALIGN(size+HEADER_SIZE)<=CUR_SIZE_MASKED(oldptr)){
-        /*not reaching the end of heap while requesting to shrink the size*/
-        size=ALIGN(size+HEADER_SIZE);
-        if(size<CUR_SIZE_MASKED(oldptr)){
-            /*segment the current block into two blocks*/
-            remainder_size=CUR_SIZE_MASKED(oldptr)-size;
-            CUR_SIZE(oldptr)=size;
-            new_next_block=NEXT_BLOCK(oldptr,size);
-            PREV_SIZE(new_next_block)=size;
+/*
+ * check_absorb - keep the cursor of mm_checkheap_incremental on a block: called with the block of size bytes
+ * just formed at block out of several, or about to be given back, so that a cursor pointing into it moves to its start.
+ */
+static inline void check_absorb(void *block, size_t size){
+    if(check_cursor>block && check_cursor<block+size){
+        check_cursor=block;
+    }
+}
+
+/*
+ * heap_advise - ask for transparent huge pages (MM_GROW_HUGE) for the len bytes the heap just grew by at start, and
+ * the huge page they begin in, and bind them to the NUMA node of the calling thread (MM_OPT_NUMA).
+ */
+void heap_advise(void *start, size_t len){
+    uintptr_t page=mem_pagesize();
+    void *lo;
+#ifdef SYS_mbind
+    unsigned int cpu, node;
+    unsigned long mask;
+#endif
+
+    if(growth==MM_GROW_HUGE){
+        lo=(void *)((uintptr_t)start & ~(HUGE_PAGE_SIZE-1));
+        if(lo<mem_heap_lo()){
+            lo=mem_heap_lo();
+        }
+        madvise(lo, start+len-lo, MADV_HUGEPAGE);
+    }
+#ifdef SYS_mbind
+    if(numa_bind && getcpu(&cpu, &node)==0 && node<8*sizeof(mask)){
+        mask=1UL<<node;
+        lo=(void *)((uintptr_t)start & ~(page-1));
+        if(syscall(SYS_mbind, lo, start+len-lo, MPOL_PREFERRED, &mask, 8*sizeof(mask), 0)==0){
+            numa_bound_bytes+=len;
+        }else{
+            /*no NUMA here: grow as if the option had never been set*/
+            numa_bind=0;
+        }
+    }
+#else
+    (void)page;
+#endif
+}
+
+/*
+ * heap_extend - move the break up by incr bytes, keeping track of the peak heap size. Return FAIL on failure.
+ */
+void *heap_extend(size_t incr){
+    void *old_brk;
+
+    old_brk=mem_sbrk(incr);
+    if(old_brk==FAIL){
+        return FAIL;
+    }
+    if(mem_heapsize()>peak_heap_size){
+        peak_heap_size=mem_heapsize();
+    }
+    if(growth==MM_GROW_HUGE || numa_bind){
+        heap_advise(old_brk, incr);
+    }
+    return old_brk;
+}
+
+/*
+ * heap_shrink - give the free last block of the heap back to the system, keeping pad bytes of it.
+ * The block must not be tracked by any index; whatever is kept is put back into the index.
+ * Return the number of bytes released.
+ */
+size_t heap_shrink(void *block, size_t pad){
+    size_t size=CUR_SIZE_MASKED(block), keep;
+    uintptr_t brk, target;
+
+    check_absorb(block, size);
+    keep=ALIGN(pad);
+    if(keep>0 && keep<MIN_BLOCK_SIZE){
+        keep=MIN_BLOCK_SIZE;
+    }
+    if(growth==MM_GROW_HUGE && keep<size){
+        /*give back whole huge pages only, so that the break stays on a boundary*/
+        brk=(uintptr_t)mem_heap_hi()+1+WSIZE;
+        target=(brk-(size-keep)+HUGE_PAGE_SIZE-1) & ~(HUGE_PAGE_SIZE-1);
+        keep=target<brk ? size-(brk-target) : size;
+        if(keep>0 && keep<MIN_BLOCK_SIZE){
+            keep+=HUGE_PAGE_SIZE;
+        }
+    }
+    if(keep>=size || mem_sbrk(-(intptr_t)(size-keep))==FAIL){
+        free_insert(block);
+        return 0;
+    }
+    if(keep>0){
+        CUR_SIZE(block)=keep | 1;
+        PREV_SIZE(NEXT_BLOCK(block,keep))=keep | 1;
+        free_insert(block);
+    }
+    /*otherwise the header of the released block becomes the epilogue, which already holds the size of the (allocated) previous block*/
+    released_bytes+=size-keep;
+    return size-keep;
+}
+
+/*
+ * mmap_alloc - serve a huge request with a mapping of its own. Return the user pointer, NULL on failure.
+ */
+void *mmap_alloc(size_t size){
+    size_t page=mem_pagesize(), map_size;
+    void *block;
+
+    map_size=(HEADER_SIZE+GUARD_SIZE+size+page-1) & ~(page-1);
+    block=mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(block==MAP_FAILED){
+        return NULL;
+    }
+    PREV_SIZE(block)=0;
+    CUR_SIZE(block)=map_size | 0x2;
+    mapped_bytes+=map_size;
+    return USER_BLOCK(block);
+}
+
+/*
+ * mmap_resize - resize the mapping of a huge block, letting the kernel move its pages if needed.
+ * Return the new user pointer, NULL on failure (the old block is left untouched).
+ */
+void *mmap_resize(void *block, size_t size){
+    size_t page=mem_pagesize(), old_size=CUR_SIZE_MASKED(block), map_size;
+
+    map_size=(HEADER_SIZE+GUARD_SIZE+size+page-1) & ~(page-1);
+    if(map_size!=old_size){
+        block=mremap(block, old_size, map_size, MREMAP_MAYMOVE);
+        if(block==MAP_FAILED){
+            return NULL;
+        }
+        CUR_SIZE(block)=map_size | 0x2;
+        mapped_bytes+=map_size-old_size;
+    }
+    return USER_BLOCK(block);
+}
+
+/*The following functions manage the slabs of small objects.*/
+
+/*
+ * slab_link - put slab s at the head of the list of its class.
+ */
+void slab_link(void *s){
+    unsigned int cls=SLAB_CLASS(s);
+
+    SLAB_NEXT(s)=slab_partial[cls];
+    SLAB_PREV(s)=NULL;
+    if(slab_partial[cls]!=NULL){
+        SLAB_PREV(slab_partial[cls])=s;
+    }
+    slab_partial[cls]=s;
+    SLAB_LISTED(s)=1;
+}
+
+/*
+ * slab_unlink - take slab s out of the list of its class.
+ */
+void slab_unlink(void *s){
+    if(SLAB_PREV(s)!=NULL){
+        SLAB_NEXT(SLAB_PREV(s))=SLAB_NEXT(s);
+    }else{
+        slab_partial[SLAB_CLASS(s)]=SLAB_NEXT(s);
+    }
+    if(SLAB_NEXT(s)!=NULL){
+        SLAB_PREV(SLAB_NEXT(s))=SLAB_PREV(s);
+    }
+    SLAB_LISTED(s)=0;
+}
+
+/*
+ * slab_new - start an empty slab of class cls, from a spare page if there is one and otherwise from the
+ * slab region (reserved on first use). Return the slab, NULL if the region is exhausted.
+ */
+void *slab_new(unsigned int cls){
+    void *s, *region;
+
+    if(slab_spare!=NULL){
+        s=slab_spare;
+        slab_spare=SLAB_NEXT(s);
+    }else{
+        if(slab_lo==NULL){
+            region=mmap(NULL, SLAB_REGION_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+            if(region==MAP_FAILED){
+                return NULL;
+            }
+            slab_lo=slab_top=region;
+        }
+        if(slab_top+SLAB_PAGE_SIZE>slab_lo+SLAB_REGION_SIZE){
+            return NULL;
+        }
+        s=slab_top;
+        slab_top+=SLAB_PAGE_SIZE;
+    }
+    SLAB_FREE(s)=NULL;
+    SLAB_BUMP(s)=SLAB_FIRST(s);
+    SLAB_CLASS(s)=cls;
+    SLAB_IN_USE(s)=0;
+    SLAB_HELD(s)=0;
+    memset(SLAB_USED(s), 0, SLAB_USED_WORDS*sizeof(unsigned long));
+    slab_link(s);
+    return s;
+}
+
+/*
+ * slab_alloc - hand out an object of class cls. Return the object, NULL if no slab can be started.
+ */
+void *slab_alloc(unsigned int cls){
+    void *s, *obj;
+    unsigned int i;
+
+    s=slab_partial[cls];
+    if(s==NULL && (s=slab_new(cls))==NULL){
+        return NULL;
+    }
+    if(SLAB_FREE(s)!=NULL){
+        obj=SLAB_FREE(s);
+        SLAB_FREE(s)=*(void**)obj;
+    }else{
+        obj=SLAB_BUMP(s);
+        SLAB_BUMP(s)=obj+SLAB_OBJ_SIZE(cls);
+    }
+    i=SLAB_INDEX(s, obj);
+    SLAB_USED_WORD(s, i)|=SLAB_USED_BIT(i);
+    if(++SLAB_IN_USE(s)==SLAB_CAPACITY(cls)){
+        /*full: nothing left to hand out*/
+        slab_unlink(s);
+    }
+    return obj;
+}
+
+/*
+ * slab_put - link the object at ptr (of class cls, no longer handed out) into the free list of its slab, and give
+ * the slab to the spare pages once it is empty (unless it is the last slab of its class).
+ */
+void slab_put(void *ptr, unsigned int cls){
+    void *s=SLAB_OF(ptr);
+
+    *(void**)ptr=SLAB_FREE(s);
+    SLAB_FREE(s)=ptr;
+    if(!SLAB_LISTED(s)){
+        slab_link(s);
+    }
+    if(--SLAB_IN_USE(s)==0 && (slab_partial[cls]!=s || SLAB_NEXT(s)!=NULL)){
+        slab_unlink(s);
+        SLAB_CLASS(s)=SLAB_NONE;
+        SLAB_NEXT(s)=slab_spare;
+        slab_spare=s;
+    }
+}
+
+/*
+ * slab_handed_out - check that the object at ptr, given to caller, is handed out: its bit is set (the bitmap of
+ * an empty or spare slab is clear, so this needs no size class). The hardened build also checks that the slab is
+ * in use, that ptr is the start of an object (a header violation otherwise) and the canary of the object.
+ * Report (and, hardened, count) a violation. Return 1 if the object is sound, 0 otherwise.
+ */
+int slab_handed_out(void *ptr, const char *caller){
+    void *s=SLAB_OF(ptr);
+    unsigned int i;
+#ifdef MM_HARDENED
+    unsigned int cls=SLAB_CLASS(s);
+
+    if(cls==SLAB_NONE){
+        counters.double_frees++;
+        printf("Double Free Error: %s: try to free an already freed memory block(%p).\n", caller, ptr);
+        return 0;
+    }
+    if(ptr<SLAB_FIRST(s) || ptr>=SLAB_BUMP(s) || (unsigned int)(ptr-SLAB_FIRST(s))%SLAB_OBJ_SIZE(cls)){
+        counters.header_violations++;
+        printf("Heap Corruption Error: %s: %p is not an object of its slab.\n", caller, ptr);
+        return 0;
+    }
+#endif
+    i=SLAB_INDEX(s, ptr);
+    if(!(SLAB_USED_WORD(s, i) & SLAB_USED_BIT(i))){
+#ifdef MM_HARDENED
+        counters.double_frees++;
+        printf("Double Free Error: %s: try to free an already freed memory block(%p).\n", caller, ptr);
+#else
+        (void)caller;
+        printf("Double Free Error: try to free an already freed memory block(%p).\n",ptr);
+#endif
+        return 0;
+    }
+#ifdef MM_HARDENED
+    if(SLAB_CANARY(ptr, cls)!=(guard_secret^(uintptr_t)ptr)){
+        counters.canary_violations++;
+        printf("Heap Overflow Error: %s: the canary at the end of %p is overwritten.\n", caller, ptr);
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+#ifdef MM_HARDENED
+/*
+ * slab_release - check the oldest object of the quarantine of slab objects, in slot slab_quarantine_next, for
+ * writes after it was freed, and give it back to its slab.
+ */
+void slab_release(void){
+    void *ptr=slab_quarantine[slab_quarantine_next], *s=SLAB_OF(ptr);
+    unsigned int cls=SLAB_CLASS(s);
+    size_t size=SLAB_OBJ_SIZE(cls)-GUARD_SIZE;
+    unsigned long *p, *end;
+
+    slab_quarantine[slab_quarantine_next]=NULL;
+    slab_quarantine_blocks--;
+    slab_quarantine_bytes-=SLAB_OBJ_SIZE(cls);
+    SLAB_HELD(s)--;
+
+    p=ptr;
+    for(end=ptr+(size<SLAB_POISON_MAX ? size : SLAB_POISON_MAX);p<end && *p==POISON_WORD;p++)
+        ;
+    if(p<end){
+        counters.use_after_frees++;
+        printf("Use After Free Error: %p was written to at offset %zu after it was freed.\n", ptr, (size_t)((void*)p-ptr));
+    }
+    if(SLAB_CANARY(ptr, cls)!=(guard_secret^(uintptr_t)ptr)){
+        counters.canary_violations++;
+        printf("Heap Overflow Error: the canary at the end of %p is overwritten after it was freed.\n", ptr);
+    }
+    slab_put(ptr, cls);
+}
+
+/*
+ * slab_quarantine_flush - give every object of the quarantine of slab objects back to its slab.
+ */
+void slab_quarantine_flush(void){
+    unsigned int i;
+
+    for(i=0;i<SLAB_QUARANTINE;i++){
+        slab_quarantine_next=i;
+        if(slab_quarantine[i]!=NULL){
+            slab_release();
+        }
+    }
+    slab_quarantine_next=0;
+}
+#endif
+
+/*
+ * slab_free - give the object at ptr, of class cls, back to its slab (a checked, handed out object: see
+ * slab_handed_out). The hardened build poisons it instead and puts it in the quarantine of slab objects, a ring
+ * of SLAB_QUARANTINE slots, whose oldest object it checks and gives back once the ring is full.
+ */
+void slab_free(void *ptr, unsigned int cls){
+    void *s=SLAB_OF(ptr);
+    unsigned int i=SLAB_INDEX(s, ptr);
+#ifdef MM_HARDENED
+    size_t size=SLAB_OBJ_SIZE(cls)-GUARD_SIZE;
+    unsigned long *p, *end;
+#endif
+
+    SLAB_USED_WORD(s, i)&=~SLAB_USED_BIT(i);
+#ifdef MM_HARDENED
+    for(p=ptr, end=ptr+(size<SLAB_POISON_MAX ? size : SLAB_POISON_MAX);p<end;p++){
+        *p=POISON_WORD;
+    }
+    if(slab_quarantine[slab_quarantine_next]!=NULL){
+        slab_release();
+    }
+    slab_quarantine[slab_quarantine_next]=ptr;
+    slab_quarantine_next=(slab_quarantine_next+1)%SLAB_QUARANTINE;
+    slab_quarantine_blocks++;
+    slab_quarantine_bytes+=SLAB_OBJ_SIZE(cls);
+    SLAB_HELD(s)++;
+#else
+    slab_put(ptr, cls);
+#endif
+}
+
+/*
+ * slab_trim - give the spare slabs at the top of the slab region back to the system. Return the number of bytes released.
+ */
+size_t slab_trim(void){
+    void *s, **link;
+    size_t released;
+
+    if(slab_lo==NULL){
+        return 0;
+    }
+    released=0;
+    while(slab_top>slab_lo && SLAB_CLASS(slab_top-SLAB_PAGE_SIZE)==SLAB_NONE){
+        s=slab_top-SLAB_PAGE_SIZE;
+        for(link=&slab_spare;*link!=s;link=&SLAB_NEXT(*link))
+            ;
+        *link=SLAB_NEXT(s);
+        slab_top=s;
+        released+=SLAB_PAGE_SIZE;
+    }
+    if(released>0 && madvise(slab_top, released, MADV_DONTNEED)==0){
+        released_bytes+=released;
+        return released;
+    }
+    return 0;
+}
+
+/*The following functions take blocks out of the heap and put them back.*/
+
+/*
+ * heap_free - free the (allocated, heap) block cur: coalesce it with its free neighbours, then index the
+ * result or, if it is a large block at the top of the heap, give it back to the system.
+ */
+void heap_free(void *cur){
+    size_t size, new_size;
+    void *prev, *next, *new_block;
+
+    if(CUR_FREE(cur)){
+	printf("Double Free Error: try to free an already freed memory block(%p).\n",cur);
+	return;
+    }
+
+    new_block=cur;
+    new_size=CUR_SIZE_MASKED(cur);
+
+    /*coalesce with the previous block if free*/
+    if(PREV_FREE(cur)){
+	size=PREV_SIZE_MASKED(cur);
+	prev=PREV_BLOCK(cur,size);
+	free_delete(prev);
+	STAT(counters.coalesces++);
+	new_block=prev;
+	new_size+=size;
+    }
+
+    /*coalesce with the next block if exists and free*/
+    size=CUR_SIZE_MASKED(cur);
+    next=NEXT_BLOCK(cur,size);
+    if(next+WSIZE<=mem_heap_hi() && CUR_FREE(next)){
+	size=CUR_SIZE_MASKED(next);
+	free_delete(next);
+	STAT(counters.coalesces++);
+	new_size+=size;
+    }
+
+    /*Setting the new free block after coalesce*/
+    CUR_SIZE(new_block)=new_size | 1;
+    PREV_SIZE(NEXT_BLOCK(new_block,new_size))=new_size | 1;
+    check_absorb(new_block, new_size);
+    if(new_size>=trim_threshold && NEXT_BLOCK(new_block,new_size)==mem_heap_hi()-WSIZE+1){
+        /*a large free block at the top of the heap: give it back to the system*/
+        heap_shrink(new_block, 0);
+    }else{
+        free_insert(new_block);
+    }
+}
+
+/*
+ * quick_push - hold the (allocated, heap) block cur in the quick cache instead of freeing it.
+ */
+void quick_push(void *cur){
+    size_t size=CUR_SIZE_MASKED(cur);
+    int idx=SEG_INDEX(size);
+
+    CUR_SIZE(cur)=size | 0x8;
+    QUICK_NEXT(cur)=quick_heads[idx];
+    QUICK_PREV(cur)=NULL;
+    if(quick_heads[idx]!=NULL){
+        QUICK_PREV(quick_heads[idx])=cur;
+    }
+    quick_heads[idx]=cur;
+    quick_blocks++;
+    quick_bytes+=size;
+}
+
+/*
+ * quick_unlink - take the held block cur out of its list. It becomes an allocated block again.
+ */
+void quick_unlink(void *cur){
+    size_t size=CUR_SIZE_MASKED(cur);
+
+    if(QUICK_PREV(cur)!=NULL){
+        QUICK_NEXT(QUICK_PREV(cur))=QUICK_NEXT(cur);
+    }else{
+        quick_heads[SEG_INDEX(size)]=QUICK_NEXT(cur);
+    }
+    if(QUICK_NEXT(cur)!=NULL){
+        QUICK_PREV(QUICK_NEXT(cur))=QUICK_PREV(cur);
+    }
+    CUR_SIZE(cur)=size;
+    quick_blocks--;
+    quick_bytes-=size;
+}
+
+/*
+ * quick_pop - take a held block of exactly block_size bytes out of the quick cache. Return it (allocated), NULL if there is none.
+ */
+void *quick_pop(size_t block_size){
+    int idx=SEG_INDEX(block_size);
+    void *cur=quick_heads[idx];
+
+    if(cur==NULL){
+        return NULL;
+    }
+    STAT(counters.quick_hits++);
+    quick_unlink(cur);
+    return cur;
+}
+
+/*
+ * quick_flush - empty the quick cache: free every held block for real, coalescing the held blocks with
+ * each other and with their free neighbours.
+ */
+void quick_flush(void){
+    void *cur, *next;
+    int idx;
+
+    if(quick_blocks==0){
+        return;
+    }
+    STAT(counters.consolidations++);
+    for(idx=0;idx<QUICK_CLASSES;idx++){
+        for(cur=quick_heads[idx];cur!=NULL;cur=next){
+            next=QUICK_NEXT(cur);
+            CUR_SIZE(cur)=CUR_SIZE_MASKED(cur);
+            heap_free(cur);
+        }
+        quick_heads[idx]=NULL;
+    }
+    quick_blocks=quick_bytes=0;
+}
+
+/*
+ * quick_unpin - free the held blocks that mm_free, by coalescing into the free last block or by shrinking
+ * the heap, has left at the top of the heap, where they would keep the heap from shrinking.
+ */
+void quick_unpin(void){
+    void *end, *last;
+
+    while(quick_blocks>0){
+        end=mem_heap_hi()-WSIZE+1;
+        if(PREV_SIZE_MASKED(end)==0){
+            return;
+        }
+        last=end-PREV_SIZE_MASKED(end);
+        if(CUR_FREE(last)){
+            if(PREV_SIZE_MASKED(last)==0){
+                return;
+            }
+            last=last-PREV_SIZE_MASKED(last);
+        }
+        if(!CUR_HELD(last)){
+            return;
+        }
+        quick_unlink(last);
+        heap_free(last);
+    }
+}
+
+#ifdef MM_HARDENED
+/*The following functions guard the blocks of the hardened build.*/
+
+/*Given the starting ptr p of a block, compute its tag, and read and compute its canary*/
+#define GUARD_TAG(p) (((((uintptr_t)(p))^CUR_SIZE_MASKED(p)^CUR_MMAPPED(p)^guard_secret)*0x9E3779B97F4A7C15UL)>>TAG_SHIFT)
+#define CANARY(p) (*(uintptr_t*)((p)+CUR_SIZE_MASKED(p)-GUARD_SIZE))
+#define GUARD_CANARY(p) (guard_secret^(uintptr_t)(p))
+
+/*
+ * guard_seal - tag the header of the allocated block and write its canary, once its size is final.
+ */
+void guard_seal(void *block){
+    CUR_SIZE(block)=(CUR_SIZE(block) & ~(~0UL<<TAG_SHIFT)) | (GUARD_TAG(block)<<TAG_SHIFT);
+    CANARY(block)=GUARD_CANARY(block);
+}
+
+/*
+ * slab_seal - write the canary of the object of class cls just handed out at ptr.
+ */
+void slab_seal(void *ptr, unsigned int cls){
+    SLAB_CANARY(ptr, cls)=GUARD_CANARY(ptr);
+}
+
+/*
+ * guard_check - check the tag and the canary of the block handed to caller, which must be allocated.
+ * Report and count a violation. Return 1 if the block is sound, 0 otherwise.
+ */
+int guard_check(void *block, const char *caller){
+    if(CUR_FREE(block) || CUR_HELD(block)){
+        counters.double_frees++;
+        printf("Double Free Error: %s: try to free an already freed memory block(%p).\n", caller, block);
+        return 0;
+    }
+    if((CUR_SIZE(block)>>TAG_SHIFT)!=GUARD_TAG(block)){
+        counters.header_violations++;
+        printf("Heap Corruption Error: %s: the header of %p is corrupted (or it is not a block).\n", caller, block);
+        return 0;
+    }
+    if(CANARY(block)!=GUARD_CANARY(block)){
+        counters.canary_violations++;
+        printf("Heap Overflow Error: %s: the canary at the end of %p is overwritten.\n", caller, block);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * guard_poison_end - compute the end of the poisoned bytes of a freed block: the payload after the quarantine
+ * link (and before the canary), up to POISON_MAX bytes.
+ */
+static inline unsigned long *guard_poison_end(void *block){
+    size_t size=CUR_SIZE_MASKED(block)-HEADER_SIZE-WSIZE-GUARD_SIZE;
+
+    return USER_BLOCK(block)+WSIZE+(size<POISON_MAX ? size : POISON_MAX);
+}
+
+/*
+ * guard_neighbours - check the headers of the blocks next to block before it is coalesced with them: a free
+ * neighbour carries no tag and the same size in both its headers, an allocated one its tag.
+ * Report and count a violation. Return 1 if both are sound, 0 otherwise.
+ */
+int guard_neighbours(void *block){
+    void *next;
+    int sound=1;
+
+    if(PREV_FREE(block) && CUR_SIZE(PREV_BLOCK(block,PREV_SIZE_MASKED(block)))!=PREV_SIZE(block)){
+        sound=0;
+    }
+    next=NEXT_BLOCK(block,CUR_SIZE_MASKED(block));
+    if(next+WSIZE<=mem_heap_hi()){
+        if(CUR_FREE(next)){
+            if((CUR_SIZE(next)>>TAG_SHIFT)!=0 || CUR_HELD(next) || PREV_SIZE(NEXT_BLOCK(next,CUR_SIZE_MASKED(next)))!=CUR_SIZE(next)){
+                sound=0;
+            }
+        }else if((CUR_SIZE(next)>>TAG_SHIFT)!=GUARD_TAG(next)){
+            sound=0;
+        }
+    }
+    if(!sound){
+        counters.header_violations++;
+        printf("Heap Corruption Error: a header next to %p is corrupted, the block is not freed.\n", block);
+    }
+    return sound;
+}
+
+/*
+ * quarantine_release - check the oldest block of the quarantine for writes after it was freed, and free it for real.
+ */
+void quarantine_release(void){
+    void *block=quarantine_head;
+    unsigned long *p, *end;
+
+    quarantine_head=QUICK_NEXT(block);
+    if(quarantine_head==NULL){
+        quarantine_tail=NULL;
+    }
+    quarantine_blocks--;
+    quarantine_bytes-=CUR_SIZE_MASKED(block);
+
+    p=USER_BLOCK(block)+WSIZE;
+    for(end=guard_poison_end(block);p<end && *p==POISON_WORD;p++)
+        ;
+    if(p<end){
+        counters.use_after_frees++;
+        printf("Use After Free Error: %p was written to at offset %zu after it was freed.\n", block, (size_t)((void*)p-USER_BLOCK(block)));
+    }
+    if(CANARY(block)!=GUARD_CANARY(block)){
+        counters.canary_violations++;
+        printf("Heap Overflow Error: the canary at the end of %p is overwritten after it was freed.\n", block);
+    }
+    CUR_SIZE(block)=CUR_SIZE_MASKED(block);
+    if(guard_neighbours(block)){
+        heap_free(block);
+    }
+}
+
+/*
+ * quarantine_push - poison the (allocated, checked) heap block and append it to the quarantine instead of
+ * freeing it, releasing the oldest blocks once the quarantine is full.
+ */
+void quarantine_push(void *block){
+    unsigned long *p, *end;
+
+    CUR_SIZE(block)|=0x8;
+    for(p=USER_BLOCK(block)+WSIZE, end=guard_poison_end(block);p<end;p++){
+        *p=POISON_WORD;
+    }
+    QUICK_NEXT(block)=NULL;
+    if(quarantine_tail!=NULL){
+        QUICK_NEXT(quarantine_tail)=block;
+    }else{
+        quarantine_head=block;
+    }
+    quarantine_tail=block;
+    quarantine_blocks++;
+    quarantine_bytes+=CUR_SIZE_MASKED(block);
+    while(quarantine_bytes>QUARANTINE_BYTES){
+        quarantine_release();
+    }
+}
+#endif
+
+/*
+ * quarantine_flush - release every block of the quarantine and every object of the quarantine of slab objects (nothing to do unless built with MM_HARDENED).
+ */
+void quarantine_flush(void){
+#ifdef MM_HARDENED
+    while(quarantine_head!=NULL){
+        quarantine_release();
+    }
+    slab_quarantine_flush();
+#endif
+}
+
+/*
+ * heap_growth - compute how far to move the break, by the growth policy, for a request that lacks incr bytes at the top of the heap.
+ */
+size_t heap_growth(size_t incr){
+    size_t grow=incr;
+    uintptr_t brk;
+
+    if(growth==MM_GROW_EXACT){
+        return incr;
+    }
+    if(growth==MM_GROW_HUGE){
+        brk=(uintptr_t)mem_heap_hi()+1+WSIZE;
+        return ((brk+incr+HUGE_PAGE_SIZE-1) & ~(HUGE_PAGE_SIZE-1))-brk;
+    }
+    if(growth==MM_GROW_GEOMETRIC){
+        if(mem_heapsize()/GEOMETRIC_DIVISOR>grow){
+            grow=mem_heapsize()/GEOMETRIC_DIVISOR;
+        }
+        /*a surplus of trim_threshold would be given back by the next mm_free at the top*/
+        if(grow-incr>trim_threshold/2){
+            grow=incr+trim_threshold/2;
+        }
+    }
+    return (grow+CHUNKSIZE-1) & ~(size_t)(CHUNKSIZE-1);
+}
+
+/*
+ * heap_take_found - take a free block of at least block_size bytes out of the index, given free_block, what
+ * free_find(block_size) returned for it. If there is no such block, empty the quick cache and look again, then
+ * increase brk (by less if the last block is free, by more if the growth policy says so). Return the block,
+ * still marked free, NULL if the heap cannot grow.
+ */
+void *heap_take_found(size_t block_size, void *free_block){
+    size_t have=0, grow;
+
+    if(free_block==tree_null && quick_blocks>0){
+        /*the held blocks may coalesce into one that fits*/
+        quick_flush();
+        free_block=free_find(block_size);
+    }
+    if(free_block!=tree_null){
+        free_delete(free_block);
+        return free_block;
+    }
+    /*set free_block to the end of last block and increase heap*/
+    free_block=mem_heap_hi()-WSIZE+1;
+    if(GET_FREE(free_block)){/*read from the header if the last block is free*/
+        free_block=free_block-PREV_SIZE_MASKED(free_block);
+        have=CUR_SIZE_MASKED(free_block);
+    }
+    /*Since the last block may be free, we only need to increase block-size minus size of this block*/
+    grow=heap_growth(block_size-have);
+    if(heap_extend(grow)==FAIL && (grow==block_size-have || heap_extend(grow=block_size-have)==FAIL)){
+        return NULL;
+    }
+    if(have>0){
+        free_delete(free_block);
+    }
+    CUR_SIZE(free_block)=(have+grow) | 1;
+    /*the last block swallows the old epilogue, where the cursor may wait*/
+    check_absorb(free_block, have+grow);
+    return free_block;
+}
+
+/*
+ * heap_take - take a free block of at least block_size bytes out of the index, chosen by the placement policy
+ * (see heap_take_found).
+ */
+void *heap_take(size_t block_size){
+    return heap_take_found(block_size, free_find(block_size));
+}
+
+/*
+ * heap_split - allocate the first block_size bytes of a block taken by heap_take, and free the rest.
+ * A rest smaller than MIN_BLOCK_SIZE could not be tracked as a free block, so it is left in the
+ * allocated block instead. Return the size of the allocated block.
+ */
+size_t heap_split(void *block, size_t block_size){
+    size_t next_block_size;
+    void *next_block;
+
+    next_block_size=CUR_SIZE_MASKED(block)-block_size;
+    if(next_block_size>=MIN_BLOCK_SIZE){
+        /*Divide the free block into two blocks, one for malloc and the other marked as free*/
+        STAT(counters.splits++);
+        next_block=NEXT_BLOCK(block, block_size);
+        PREV_SIZE(NEXT_BLOCK(next_block,next_block_size))=next_block_size|1; /*set the header*/
+        CUR_SIZE(next_block)=next_block_size|1;
+        free_insert(next_block);
+        if(placement==MM_PLACE_NEXT){
+            rover=next_block;
+        }
+    }else{
+        block_size=CUR_SIZE_MASKED(block);
+    }
+    CUR_SIZE(block)=block_size;
+    PREV_SIZE(NEXT_BLOCK(block,block_size))=block_size;
+    return block_size;
+}
+
+#ifdef MM_PROFILE
+/*
+ * prof_malloc - serve a request sampled for the heap profile from the heap (or a mapping of its own), never from a
+ * slab or the quick cache, so that the block has a header to carry the S bit, and record it with the stack of the
+ * caller. Draw the distance to the next sample.
+ */
+void *prof_malloc(size_t size, void *caller){
+    size_t block_size;
+    void *block;
+
+    prof_countdown=prof_interval(prof_rate);
+    if(size>=mmap_threshold){
+        block=mmap_alloc(size);
+        if(block==NULL){
+            return NULL;
+        }
+        block-=HEADER_SIZE;
+    }else{
+        block_size=ALIGN(HEADER_SIZE+GUARD_SIZE+size);
+        block_size=block_size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : block_size;
+        block=heap_take(block_size);
+        if(block==NULL){
+            return NULL;
+        }
+        heap_split(block, block_size);
+    }
+    CUR_SIZE(block)|=SAMPLED_BIT;
+    GUARD(guard_seal(block));
+    prof_record(USER_BLOCK(block), size, prof_rate, caller);
+    return USER_BLOCK(block);
+}
+#endif
+
+/*With these helper functions in hand, now we are ready to implement mm_malloc, mm_free and mm_realloc*/
+
+/*
+ * mm_malloc - Allocate a block
+ *
+ * If there exists a free block where the request fits, get one by the placement policy (the smallest one
+ * by default), segment it and allocate. If there is no such block, increase brk.
+ */
+void *mm_malloc(size_t size)
+{
+    size_t block_size;
+    void *block;
+
+    STAT(counters.mallocs[stat_class(size)]++);
+#ifdef MM_PROFILE
+    if(size>=prof_countdown){
+        return prof_malloc(size, __builtin_return_address(0));
+    }
+    prof_countdown-=size;
+#endif
+    if(SLAB_SERVES(size)){
+        block=slab_alloc(SLAB_CLASS_FOR(size));
+        GUARD(if(block!=NULL) slab_seal(block, SLAB_CLASS_FOR(size)));
+        return block;
+    }
+    if(size>=mmap_threshold){
+        block=mmap_alloc(size);
+        GUARD(if(block!=NULL) guard_seal(block-HEADER_SIZE));
+        return block;
+    }
+    block_size=ALIGN(HEADER_SIZE+GUARD_SIZE+size);
+    block_size=block_size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : block_size;
+    if(block_size<=quick_max){
+        block=quick_pop(block_size);
+        if(block!=NULL){
+            return USER_BLOCK(block);
+        }
+    }
+    block=heap_take(block_size);
+    if(block==NULL){
+        return NULL;
+    }
+    heap_split(block, block_size);
+    GUARD(guard_seal(block));
+    return USER_BLOCK(block);
+}
+
+
+
+/*
+ * mm_free - Freeing a block does nothing.
+ */
+void mm_free(void *ptr)
+{
+    void *cur, *next, *top;
+
+    if(ptr==NULL){
+	return;
+    }
+    if(IS_SLAB(ptr)){
+        STAT(counters.frees[stat_class(SLAB_OBJ_SIZE(SLAB_CLASS(SLAB_OF(ptr))))]++);
+        if(slab_handed_out(ptr, "mm_free")){
+            slab_free(ptr, SLAB_CLASS(SLAB_OF(ptr)));
+        }
+        return;
+    }
+    cur=ptr-HEADER_SIZE;
+    STAT(counters.frees[stat_class(CUR_SIZE_MASKED(cur)-HEADER_SIZE)]++);
+#ifdef MM_PROFILE
+    if(CUR_SAMPLED(cur)){
+        prof_forget(ptr);
+        CUR_SIZE(cur)&=~SAMPLED_BIT;
+    }
+#endif
+#ifdef MM_HARDENED
+    if(!guard_check(cur, "mm_free")){
+        return;
+    }
+    if(!CUR_MMAPPED(cur)){
+        quarantine_push(cur);
+        return;
+    }
+#endif
+
+    if(CUR_MMAPPED(cur)){
+        mapped_bytes-=CUR_SIZE_MASKED(cur);
+        munmap(cur, CUR_SIZE_MASKED(cur));
+        return;
+    }
+    if(CUR_HELD(cur) || CUR_FREE(cur)){
+        /*(before the quick cache, whose links would overwrite those of a block in the index)*/
+        printf("Double Free Error: try to free an already freed memory block(%p).\n",cur);
+        return;
+    }
+    top=mem_heap_hi()-WSIZE+1;
+    next=NEXT_BLOCK(cur,CUR_SIZE_MASKED(cur));
+    if(CUR_SIZE_MASKED(cur)<=quick_max && next!=top && !(CUR_FREE(next) && NEXT_BLOCK(next,CUR_SIZE_MASKED(next))==top)){
+        /*defer the coalescing (but not at the top of the heap, where a held block would keep the heap from shrinking)*/
+        quick_push(cur);
+        if(quick_bytes>QUICK_LIMIT){
+            quick_flush();
+        }
+        return;
+    }
+    heap_free(cur);
+    quick_unpin();
+}
+
+/*
+ * mm_realloc_last_resort - Implemented simply in terms of mm_malloc and mm_free. It's a helper function 
+ *                          that will be invoked by mm_realloc if there are no other options.
+ */
+
+void *mm_realloc_last_resort(void *ptr, size_t size)
+{
+    void *oldptr=ptr;
+    void *newptr;
+    size_t copySize;
+
+    newptr=mm_malloc(size);
+    if(newptr==NULL)
+        return NULL;
+    copySize=CUR_SIZE_MASKED(oldptr-HEADER_SIZE)-HEADER_SIZE;
+    if(size<copySize){
+        copySize=size;
+    }
+    memcpy(newptr,oldptr,copySize);
+    mm_free(oldptr);
+    return newptr;
+}
+
+/*
+ * mm_realloc_grow - grow the (heap) block at oldptr so that it holds size bytes, moving the data only when
+ *                   there is no other option. In order of preference, the block
+ *                   1. absorbs its free next block,
+ *                   2. extends the heap, if it (or its free next block) is the last block,
+ *                   3. slides down into its free previous block (together with the next block, if free),
+ *                   4. is reallocated by mm_realloc_last_resort.
+ *                   A block that has been grown before gets GROWTH_FACTOR of its size as slack (up to
+ *                   MAX_GROWTH_SLACK bytes), so that buffers grown step by step do not move at every step.
+ */
+void *mm_realloc_grow(void *oldptr, size_t size)
+{
+    void *block=oldptr, *prev=NULL, *next, *end, *newptr;
+    size_t old_size, prev_size=0, next_size=0, needed, want, avail, remainder_size;
+
+    old_size=CUR_SIZE_MASKED(oldptr);
+    needed=ALIGN(size+HEADER_SIZE+GUARD_SIZE);
+    want=needed;
+    if(CUR_GROWN(oldptr)){
+        want=ALIGN(old_size+old_size/GROWTH_FACTOR);
+        if(want<needed){
+            want=needed;
+        }else if(want-needed>MAX_GROWTH_SLACK){
+            want=needed+MAX_GROWTH_SLACK;
+        }
+    }
+
+    end=mem_heap_hi()-WSIZE+1;
+    next=NEXT_BLOCK(oldptr, old_size);
+    if(next<end && CUR_FREE(next)){
+        next_size=CUR_SIZE_MASKED(next);
+    }
+    if(PREV_FREE(oldptr)){
+        prev_size=PREV_SIZE_MASKED(oldptr);
+        prev=PREV_BLOCK(oldptr, prev_size);
+    }
+
+    avail=old_size+next_size;
+    if(avail>=needed){
+        /*merge with the next block*/
+        STAT(counters.realloc_merge_next++);
+        if(next_size>0){
+            free_delete(next);
+        }
+    }else if(NEXT_BLOCK(oldptr, avail)==end){
+        /*nothing but free space behind us: extend the heap*/
+        if(heap_extend(want-avail)==FAIL){
+            return NULL;
+        }
+        STAT(counters.realloc_extend++);
+        if(next_size>0){
+            free_delete(next);
+        }
+        avail=want;
+    }else if(prev_size>0 && prev_size+avail>=needed){
+        /*slide down into the previous block*/
+        free_delete(prev);
+        if(next_size>0){
+            free_delete(next);
+        }
+        memmove(USER_BLOCK(prev), USER_BLOCK(oldptr), old_size-HEADER_SIZE);
+        realloc_copies++;
+        STAT(counters.realloc_merge_prev++);
+        block=prev;
+        avail+=prev_size;
+    }else{
+        newptr=mm_realloc_last_resort(USER_BLOCK(oldptr), want-HEADER_SIZE-GUARD_SIZE);
+        if(newptr!=NULL){
+            realloc_copies++;
+            STAT(counters.realloc_last_resort++);
+            if(!IS_SLAB(newptr) && !CUR_MMAPPED(newptr-HEADER_SIZE)){
+                CUR_SIZE(newptr-HEADER_SIZE)|=0x4;
+            }
+        }
+        return newptr;
+    }
+
+    /*keep what we want of the available space and free the rest, unless the rest is too small to be a free block*/
+    check_absorb(block, avail);
+    if(avail>=want+MIN_BLOCK_SIZE){
+        STAT(counters.splits++);
+        remainder_size=avail-want;
+        avail=want;
+        next=NEXT_BLOCK(block, avail);
+        CUR_SIZE(next)=remainder_size | 1;
+        PREV_SIZE(NEXT_BLOCK(next, remainder_size))=remainder_size | 1;
+        free_insert(next);
+    }
+    CUR_SIZE(block)=avail | 0x4;
+    PREV_SIZE(NEXT_BLOCK(block, avail))=avail;
+    return USER_BLOCK(block);
+}
+
+/*
+ * mm_realloc_resize - resize the block at ptr (not NULL) to size (not 0) bytes for mm_realloc.
+ */
+void *mm_realloc_resize(void *ptr, size_t size)
+{
+    void *oldptr=ptr-HEADER_SIZE;
+    void *old_next_block;
+    void *newptr;
+    void *new_next_block;
+    size_t remainder_size;
+    size_t next_block_size;
+    size_t old_size;
+    unsigned int cls;
+
+    if(IS_SLAB(ptr)){
+        cls=SLAB_CLASS(SLAB_OF(ptr));
+        old_size=SLAB_OBJ_SIZE(cls)-GUARD_SIZE;
+        if(SLAB_CLASS_FOR(size)==cls){
+            /*shrink in place (only within the class, which mm_free_sized computes from the size)*/
+            STAT(counters.realloc_shrink++);
+            return ptr;
+        }
+        /*move to another class, or out of the slabs*/
+        newptr=mm_malloc(size);
+        if(newptr==NULL){
+            return NULL;
+        }
+        memcpy(newptr, ptr, size<old_size ? size : old_size);
+        slab_free(ptr, cls);
+        realloc_copies++;
+        STAT(counters.realloc_last_resort++);
+        return newptr;
+    }
+
+    if(CUR_MMAPPED(oldptr)){
+        if(size>=mmap_threshold){
+            /*stay huge: let mremap grow or shrink the mapping without copying*/
+            STAT(counters.realloc_remap++);
+            return mmap_resize(oldptr, size);
+        }
+        /*the block became small enough for the heap*/
+        realloc_copies++;
+        STAT(counters.realloc_last_resort++);
+        return mm_realloc_last_resort(ptr, size);
+    }
+    old_next_block=NEXT_BLOCK(oldptr, CUR_SIZE_MASKED(oldptr));
+    
+    if(old_next_block==(mem_heap_hi()-WSIZE+1)){
+        /*reaching the end of heap*/
+        if(ALIGN(size+HEADER_SIZE+GUARD_SIZE)<=CUR_SIZE_MASKED(oldptr)){
+            /*user requests to shrink the size*/
+            STAT(counters.realloc_shrink++);
+            size=ALIGN(size+HEADER_SIZE+GUARD_SIZE);
+            size=size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : size;
+            if(size+MIN_BLOCK_SIZE<=CUR_SIZE_MASKED(oldptr)){
+                /*segment the current block into two blocks*/
+                STAT(counters.splits++);
+                remainder_size=CUR_SIZE_MASKED(oldptr)-size;
+                CUR_SIZE(oldptr)=size;
+                new_next_block=NEXT_BLOCK(oldptr,size);
+                PREV_SIZE(new_next_block)=size;
+                CUR_SIZE(new_next_block)=remainder_size | 1;
+                PREV_SIZE(NEXT_BLOCK(new_next_block,remainder_size))=remainder_size | 1;
+                if(remainder_size>=trim_threshold){
+                    heap_shrink(new_next_block, 0);
+                }else{
+                    free_insert(new_next_block);
+                }
+                newptr=oldptr+HEADER_SIZE;
+                return newptr;
+            }else{
+                newptr=oldptr+HEADER_SIZE;
+                return newptr;
+            }
+        }else{
+            /*user requests to increase the size: the heap can simply be extended*/
+            return mm_realloc_grow(oldptr, size);
+        }
+    }
+
+    if(ALIGN(size+HEADER_SIZE+GUARD_SIZE)<=CUR_SIZE_MASKED(oldptr)){
+        /*not reaching the end of heap while requesting to shrink the size*/
+        STAT(counters.realloc_shrink++);
+        size=ALIGN(size+HEADER_SIZE+GUARD_SIZE);
+        size=size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : size;
+        if(size<CUR_SIZE_MASKED(oldptr) && (CUR_FREE(old_next_block) || size+MIN_BLOCK_SIZE<=CUR_SIZE_MASKED(oldptr))){
+            /*segment the current block into two blocks (a remainder too small to be a free block on its own
+             *is only split off when it can be merged into the free next block)*/
+            STAT(counters.splits++);
+            remainder_size=CUR_SIZE_MASKED(oldptr)-size;
+            CUR_SIZE(oldptr)=size;
+            new_next_block=NEXT_BLOCK(oldptr,size);
+            PREV_SIZE(new_next_block)=size;
             if(CUR_FREE(old_next_block)){
                 /*coalesce with the next block if free(it is guaranteed to exist since it is not the end of heap)*/
                 next_block_size=CUR_SIZE_MASKED(old_next_block);
-                if(IS_IN_TREE(old_next_block)){
-                    tree_delete(old_next_block);
-                }
+                free_delete(old_next_block);
+                STAT(counters.coalesces++);
                 remainder_size+=next_block_size;
                 CUR_SIZE(new_next_block)=remainder_size | 1;
                 PREV_SIZE(NEXT_BLOCK(new_next_block,remainder_size))=remainder_size | 1;
-                if(IS_IN_TREE(new_next_block)){
-                    tree_insert(new_next_block);
-                }
+                check_absorb(new_next_block, remainder_size);
+                free_insert(new_next_block);
                 newptr=oldptr+HEADER_SIZE;
                 return newptr;
             }else{
                 /*no coalescence*/
                 CUR_SIZE(new_next_block)=remainder_size | 1;
                 PREV_SIZE(NEXT_BLOCK(new_next_block,remainder_size))=remainder_size | 1;
-                if(IS_IN_TREE(new_next_block)){
-                    tree_insert(new_next_block);
-                }
+                free_insert(new_next_block);
                 newptr=oldptr+HEADER_SIZE;
                 return newptr;
             }
@@ -681,46 +2552,532 @@ void *mm_realloc(void *ptr, size_t size)
         }
     }else{
         /*User requests to increase the size*/
-        size=ALIGN(size+HEADER_SIZE);
-        if(CUR_FREE(old_next_block)){
-            if((CUR_SIZE_MASKED(old_next_block)+CUR_SIZE_MASKED(oldptr)-size)>0){
-                /*we will merge these two blocks into one since the sum of their size
-                 * is strictly bigger than requested size*/
-                remainder_size=CUR_SIZE_MASKED(old_next_block)+CUR_SIZE_MASKED(oldptr)-size;
-                if(IS_IN_TREE(old_next_block)){
-                    tree_delete(old_next_block);
-                }
-                new_next_block=NEXT_BLOCK(oldptr,size);
-                CUR_SIZE(oldptr)=size;
-                PREV_SIZE(new_next_block)=size;
-                CUR_SIZE(new_next_block)=remainder_size | 1;
-                PREV_SIZE(NEXT_BLOCK(new_next_block, remainder_size))=remainder_size | 1;
-                if(IS_IN_TREE(new_next_block)){
-                    tree_insert(new_next_block);
-                }
-                newptr=oldptr+HEADER_SIZE;
-                return newptr;
-            }else if((CUR_SIZE_MASKED(old_next_block)+CUR_SIZE_MASKED(oldptr)-size)==0){
-                /*The sum of their size precisely equals the requested size*/
-                if(IS_IN_TREE(old_next_block)){
-                    tree_delete(old_next_block);
+        return mm_realloc_grow(oldptr, size);
+    }
+}
+
+/*
+ * mm_realloc - resize a block, in place whenever possible.
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+    void *newptr;
+#ifdef MM_PROFILE
+    size_t countdown;
+#endif
+
+    if(ptr==NULL){
+        newptr=mm_malloc(size);
+        return newptr;
+    }
+
+    if(size==0){
+        mm_free(ptr);
+        return NULL;
+    }
+    STAT(counters.reallocs[stat_class(size)]++);
+    if(IS_SLAB(ptr) && !slab_handed_out(ptr, "mm_realloc")){
+        return NULL;
+    }
+#ifdef MM_HARDENED
+    if(!IS_SLAB(ptr) && !guard_check(ptr-HEADER_SIZE, "mm_realloc")){
+        return NULL;
+    }
+#endif
+#ifdef MM_PROFILE
+    /*the block leaves the profile and is sampled anew as a request of size bytes, not by the mm_malloc that moves it*/
+    if(!IS_SLAB(ptr) && CUR_SAMPLED(ptr-HEADER_SIZE)){
+        prof_forget(ptr);
+        CUR_SIZE(ptr-HEADER_SIZE)&=~SAMPLED_BIT;
+    }
+    countdown=prof_countdown;
+    prof_countdown=(size_t)-1;
+#endif
+    newptr=mm_realloc_resize(ptr, size);
+#ifdef MM_PROFILE
+    prof_countdown=countdown;
+    if(newptr!=NULL && size>=prof_countdown && !IS_SLAB(newptr)){
+        prof_countdown=prof_interval(prof_rate);
+        CUR_SIZE(newptr-HEADER_SIZE)|=SAMPLED_BIT;
+        prof_record(newptr, size, prof_rate, __builtin_return_address(0));
+    }else if(newptr!=NULL && size<prof_countdown){
+        prof_countdown-=size;
+    }
+#endif
+#ifdef MM_HARDENED
+    /*(a slab object keeps its canary, or got it from mm_malloc)*/
+    if(newptr!=NULL && !IS_SLAB(newptr)){
+        guard_seal(newptr-HEADER_SIZE);
+    }
+#endif
+    return newptr;
+}
+
+
+
+/*
+ * mm_calloc - allocate a block for nmemb elements of size bytes, zeroed. Return NULL if the product overflows.
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    size_t bytes, clear;
+    void *ptr, *fresh;
+
+    if(size!=0 && nmemb>((size_t)-1)/size){
+        return NULL;
+    }
+    bytes=nmemb*size;
+    fresh=mem_heap_hi()+1;
+#ifdef MM_PROFILE
+    if(bytes>=prof_countdown){
+        STAT(counters.mallocs[stat_class(bytes)]++);
+        ptr=prof_malloc(bytes, __builtin_return_address(0));
+    }else
+#endif
+    ptr=mm_malloc(bytes);
+    if(ptr==NULL){
+        return NULL;
+    }
+    if(IS_SLAB(ptr) || mem_image_root()!=NULL){
+        clear=bytes;
+    }else if(CUR_MMAPPED(ptr-HEADER_SIZE)){
+        clear=0;
+    }else{
+        /*only what lies below the old break can have been written before*/
+        clear=ptr>=fresh ? 0 : (size_t)(fresh-ptr)<bytes ? (size_t)(fresh-ptr) : bytes;
+    }
+    memset(ptr, 0, clear);
+    return ptr;
+}
+
+/*
+ * heap_memalign - allocate size bytes whose payload, offset bytes in (a multiple of ALIGNMENT), is aligned to
+ * alignment (a power of two). Beyond ALIGNMENT, take a block from the index (or the top of the heap) large
+ * enough for the payload wherever the alignment falls in it, give the slack before the aligned block back
+ * to the index as a free block of its own, and split off the rest as mm_malloc does. caller is the caller to
+ * record if the request is sampled for the heap profile. Return NULL if the request cannot be served.
+ */
+void *heap_memalign(size_t alignment, size_t offset, size_t size, void *caller){
+    size_t block_size, total, lead;
+    void *block;
+
+    if(alignment==0 || (alignment & (alignment-1))!=0 || offset%ALIGNMENT!=0){
+        return NULL;
+    }
+    if(alignment<=ALIGNMENT){
+#ifdef MM_PROFILE
+        if(size>=prof_countdown){
+            STAT(counters.mallocs[stat_class(size)]++);
+            return prof_malloc(size, caller);
+        }
+#endif
+        return mm_malloc(size);
+    }
+    if(size>((size_t)-1)/4 || alignment>((size_t)-1)/4 || offset>alignment){
+        return NULL;
+    }
+    STAT(counters.mallocs[stat_class(size)]++);
+    block_size=ALIGN(HEADER_SIZE+GUARD_SIZE+size);
+    block_size=block_size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : block_size;
+    block=heap_take(block_size+alignment+MIN_BLOCK_SIZE);
+    if(block==NULL){
+        return NULL;
+    }
+    lead=(((uintptr_t)USER_BLOCK(block)+offset+alignment-1) & ~(uintptr_t)(alignment-1))-offset-(uintptr_t)USER_BLOCK(block);
+    if(lead>0 && lead<MIN_BLOCK_SIZE){
+        /*too little slack for a free block: go on to the next boundary*/
+        lead+=alignment;
+    }
+    if(lead>0){
+        /*the previous block is allocated (or held), so the slack needs no coalescing*/
+        total=CUR_SIZE_MASKED(block);
+        CUR_SIZE(block)=lead | 1;
+        PREV_SIZE(NEXT_BLOCK(block,lead))=lead | 1;
+        free_insert(block);
+        block=NEXT_BLOCK(block,lead);
+        CUR_SIZE(block)=(total-lead) | 1;
+    }
+    heap_split(block, block_size);
+#ifdef MM_PROFILE
+    if(size>=prof_countdown){
+        prof_countdown=prof_interval(prof_rate);
+        CUR_SIZE(block)|=SAMPLED_BIT;
+        prof_record(USER_BLOCK(block), size, prof_rate, caller);
+    }else{
+        prof_countdown-=size;
+    }
+#else
+    (void)caller;
+#endif
+    GUARD(guard_seal(block));
+    return USER_BLOCK(block);
+}
+
+/*
+ * mm_memalign - allocate size bytes aligned to alignment, rounded up to a power of two if it is not one.
+ * Requests aligned beyond ALIGNMENT are always served from the heap, never from a slab, the quick cache or a
+ * mapping of their own; the block is freed, resized and measured like any other.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    size_t align=ALIGNMENT;
+
+    while(align<alignment && align<=((size_t)-1)/4){
+        align*=2;
+    }
+    return heap_memalign(align, 0, size, __builtin_return_address(0));
+}
+
+/*
+ * mm_aligned_alloc - allocate size bytes aligned to alignment, as C11 aligned_alloc: NULL if alignment is not
+ * a power of two.
+ */
+void *mm_aligned_alloc(size_t alignment, size_t size)
+{
+    return heap_memalign(alignment, 0, size, __builtin_return_address(0));
+}
+
+/*
+ * mm_memalign_offset - allocate size bytes such that the payload, offset bytes in (a multiple of ALIGNMENT not
+ * larger than alignment), is aligned to alignment: for an allocator on top of mm.c that puts a prefix of its
+ * own in front of the memory it hands out.
+ */
+void *mm_memalign_offset(size_t alignment, size_t offset, size_t size)
+{
+    return heap_memalign(alignment, offset, size, __builtin_return_address(0));
+}
+
+/*
+ * mm_usable_size - return the bytes of the block ptr that may be used, at least those asked for: the size of
+ * its slab class, or its block without the header (and the canary).
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if(ptr==NULL){
+        return 0;
+    }
+    if(IS_SLAB(ptr)){
+        return SLAB_OBJ_SIZE(SLAB_CLASS(SLAB_OF(ptr)))-GUARD_SIZE;
+    }
+    return CUR_SIZE_MASKED(ptr-HEADER_SIZE)-HEADER_SIZE-GUARD_SIZE;
+}
+
+/*
+ * mm_free_sized - free the block ptr, given the size it was asked for with (or last resized to). A slab object
+ * is freed as an object of the class of size, without loading the class from its slab header (the bit of the
+ * object is still checked). A heap block keeps its flags in its header, which mm_free must read anyway, so it
+ * is freed by mm_free. The hardened build checks the size against the block (or the class of the object),
+ * and counts a size larger than the block or of another class as a header violation (it is not freed then).
+ */
+void mm_free_sized(void *ptr, size_t size)
+{
+    unsigned int cls;
+
+    if(ptr==NULL){
+        return;
+    }
+#ifdef MM_HARDENED
+    if(size>mm_usable_size(ptr)){
+        counters.header_violations++;
+        printf("Heap Corruption Error: mm_free_sized: %p is freed with %zu bytes, more than its block holds.\n", IS_SLAB(ptr) ? ptr : ptr-HEADER_SIZE, size);
+        return;
+    }
+#else
+    (void)size;
+#endif
+    if(IS_SLAB(ptr)){
+        cls=SLAB_CLASS_FOR(size);
+        STAT(counters.frees[stat_class(SLAB_OBJ_SIZE(cls))]++);
+        if(!slab_handed_out(ptr, "mm_free_sized")){
+            return;
+        }
+#ifdef MM_HARDENED
+        if(cls!=SLAB_CLASS(SLAB_OF(ptr))){
+            counters.header_violations++;
+            printf("Heap Corruption Error: mm_free_sized: %p is freed with %zu bytes, not the size of its class.\n", ptr, size);
+            return;
+        }
+#endif
+        slab_free(ptr, cls);
+        return;
+    }
+    mm_free(ptr);
+}
+
+/*
+ * batch_carve - carve n blocks of block_size bytes, one after the other, out of block (taken by heap_take, of
+ * at least n*block_size bytes), and store them in ptrs[0..n-1]. Only the last one is split against the rest.
+ */
+void batch_carve(void *block, size_t block_size, size_t n, void **ptrs){
+    size_t total=CUR_SIZE_MASKED(block), i;
+
+    for(i=0;i<n-1;i++){
+        CUR_SIZE(block)=block_size;
+        PREV_SIZE(NEXT_BLOCK(block,block_size))=block_size;
+        GUARD(guard_seal(block));
+        ptrs[i]=USER_BLOCK(block);
+        block=NEXT_BLOCK(block,block_size);
+    }
+    /*the last block gets whatever cannot be split off*/
+    CUR_SIZE(block)=(total-(n-1)*block_size) | 1;
+    heap_split(block, block_size);
+    GUARD(guard_seal(block));
+    ptrs[n-1]=USER_BLOCK(block);
+}
+
+/*
+ * mm_malloc_batch - allocate n blocks of size bytes each and store them in ptrs[0..n-1]. Heap blocks are
+ * carved one after the other out of a single free block (or a single extension of the heap), so the whole
+ * batch costs one search of the index. When no free block holds the whole batch but smaller ones exist,
+ * the batch fills them instead of growing the heap: each free block found for one block (by the placement
+ * policy, as mm_malloc would) is carved into as many blocks as it holds, and a search costs one piece of
+ * the batch rather than one block. Return 0 on success, -1 if the blocks cannot all be allocated (nothing
+ * is allocated then).
+ */
+int mm_malloc_batch(size_t size, size_t n, void **ptrs)
+{
+    size_t block_size, i, k;
+    void *block, *found;
+
+    if(n==0){
+        return 0;
+    }
+    block_size=ALIGN(HEADER_SIZE+GUARD_SIZE+size);
+    block_size=block_size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : block_size;
+    if(SLAB_SERVES(size) || size>=mmap_threshold || n>((size_t)-1)/block_size ||
+       (PROFILE && n*size>=prof_countdown)){
+        /*objects without a heap header (or one of them is sampled): one at a time*/
+        for(i=0;i<n;i++){
+            ptrs[i]=mm_malloc(size);
+            if(ptrs[i]==NULL){
+                while(i-- > 0){
+                    mm_free(ptrs[i]);
                 }
-                new_next_block=NEXT_BLOCK(oldptr,size);
-                CUR_SIZE(ptr)=size;
-                PREV_SIZE(new_next_block)=size;
-                newptr=oldptr+HEADER_SIZE;
-                return newptr;
-            }else{
-                /*The sum of their size is still not large enough, have to find new block*/
-                return mm_realloc_last_resort(ptr,size);
+                return -1;
+            }
+        }
+        return 0;
+    }
+    STAT(counters.mallocs[stat_class(size)]+=n);
+#ifdef MM_PROFILE
+    prof_countdown-=n*size;
+#endif
+    found=free_find(n*block_size);
+    if(found!=tree_null || (found=free_find(block_size))==tree_null){
+        /*the whole batch in one free block, or in one extension of the heap*/
+        block=heap_take_found(n*block_size, found);
+        if(block==NULL){
+            return -1;
+        }
+        batch_carve(block, block_size, n, ptrs);
+        return 0;
+    }
+    for(i=0;i<n;i+=k){
+        if(i>0){
+            found=free_find(block_size);
+        }
+        k=found==tree_null ? n-i : CUR_SIZE_MASKED(found)/block_size;
+        k=k<n-i ? k : n-i;
+        block=heap_take_found(k*block_size, found);
+        if(block==NULL){
+            while(i-- > 0){
+                mm_free(ptrs[i]);
             }
+            return -1;
+        }
+        batch_carve(block, block_size, k, ptrs+i);
+    }
+    return 0;
+}
+
+static int cmp_ptr(const void *a, const void *b){
+    uintptr_t x=(uintptr_t)*(void *const *)a, y=(uintptr_t)*(void *const *)b;
+
+    return x<y ? -1 : x>y;
+}
+
+/*
+ * mm_free_batch - free the n blocks in ptrs (NULL entries are skipped). Heap blocks are sorted by address,
+ * and every run of adjacent blocks is merged and freed as one block, so blocks that were allocated together
+ * are coalesced and indexed once. The order of ptrs is not preserved.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    size_t i, j, heap_n=0, run_size;
+    void *run, *cur;
+
+    /*move the heap blocks to the front, freeing everything else on the way*/
+    for(i=0;i<n;i++){
+        if(ptrs[i]==NULL){
+            continue;
+        }
+        if(HARDENED || IS_SLAB(ptrs[i]) || CUR_MMAPPED(ptrs[i]-HEADER_SIZE) || CUR_SAMPLED(ptrs[i]-HEADER_SIZE)){
+            /*(every block goes through the checks and the quarantine of mm_free in the hardened build, and a
+             *sampled block has to leave the heap profile)*/
+            mm_free(ptrs[i]);
         }else{
-            return mm_realloc_last_resort(ptr,size);
+            ptrs[heap_n++]=ptrs[i];
+        }
+    }
+    /*a batch from mm_malloc_batch is usually still in address order*/
+    for(i=1;i<heap_n && ptrs[i-1]<ptrs[i];i++)
+        ;
+    if(i<heap_n){
+        qsort(ptrs, heap_n, sizeof(void *), cmp_ptr);
+    }
+    for(i=0;i<heap_n;i=j){
+        run=ptrs[i]-HEADER_SIZE;
+        STAT(counters.frees[stat_class(CUR_SIZE_MASKED(run)-HEADER_SIZE)]++);
+        run_size=CUR_SIZE_MASKED(run);
+        for(j=i+1;j<heap_n && !CUR_FREE(run);j++){
+            cur=ptrs[j]-HEADER_SIZE;
+            if(cur!=NEXT_BLOCK(run,run_size) || CUR_FREE(cur)){
+                break;
+            }
+            STAT(counters.frees[stat_class(CUR_SIZE_MASKED(cur)-HEADER_SIZE)]++);
+            run_size+=CUR_SIZE_MASKED(cur);
+        }
+        if(j>i+1){
+            CUR_SIZE(run)=run_size;
+            PREV_SIZE(NEXT_BLOCK(run,run_size))=run_size;
+        }
+        heap_free(run);
+    }
+    quick_unpin();
+}
+
+/*
+ * mm_trim - give free memory back to the system: shrink the heap so that at most pad free bytes remain
+ * at the top, release the pages inside the other free blocks and the spare slabs at the top of the slab
+ * region. Return 1 if any memory was released.
+ * (Interior pages are counted in mm_released_bytes every time they are released.)
+ */
+int mm_trim(size_t pad)
+{
+    void *cur, *end;
+    size_t page=mem_pagesize(), released=0;
+    uintptr_t lo, hi;
+
+    quick_flush();
+    quarantine_flush();
+    end=mem_heap_hi()-WSIZE+1;
+    if(GET_FREE(end)){
+        cur=end-PREV_SIZE_MASKED(end);
+        free_delete(cur);
+        released+=heap_shrink(cur, pad);
+    }
+
+    cur=mem_heap_lo()+MIN_BLOCK_SIZE;
+    end=mem_heap_hi()-WSIZE+1;
+    while(cur<end){
+        if(CUR_FREE(cur)){
+            /*keep the header and links at the start, and the next header at the end*/
+            lo=((uintptr_t)cur+MIN_BLOCK_SIZE+page-1) & ~(page-1);
+            hi=((uintptr_t)cur+CUR_SIZE_MASKED(cur)) & ~(page-1);
+            if(lo<hi && madvise((void *)lo, hi-lo, MADV_DONTNEED)==0){
+                released+=hi-lo;
+                released_bytes+=hi-lo;
+            }
+        }
+        cur=NEXT_BLOCK(cur,CUR_SIZE_MASKED(cur));
+    }
+    released+=slab_trim();
+    return released>0;
+}
+
+/*
+ * mm_released_bytes - return the number of bytes given back to the system since mm_init.
+ */
+size_t mm_released_bytes(void)
+{
+    return released_bytes;
+}
+
+/*
+ * mm_realloc_copies - return the number of mm_realloc calls since mm_init that had to move the data.
+ */
+size_t mm_realloc_copies(void)
+{
+    return realloc_copies;
+}
+
+/*
+ * mm_mapped_bytes - return the number of bytes currently mapped for huge blocks (not part of the heap).
+ */
+size_t mm_mapped_bytes(void)
+{
+    return mapped_bytes;
+}
+
+/*
+ * mm_footprint - return the number of bytes currently obtained from the system: the heap, the huge blocks and the slabs.
+ */
+size_t mm_footprint(void)
+{
+    return mem_heapsize()+mapped_bytes+(size_t)(slab_top-slab_lo);
+}
+
+/*
+ * tree_height_from - count the nodes and return the height of the subtree rooted at node.
+ */
+size_t tree_height_from(void *node, size_t *nodes){
+    size_t left, right;
+
+    if(node==tree_null){
+        return 0;
+    }
+    (*nodes)++;
+    left=tree_height_from(LEFT_CHILD(node), nodes);
+    right=tree_height_from(RIGHT_CHILD(node), nodes);
+    return 1+(left>right ? left : right);
+}
+
+/*
+ * mm_stats - take a snapshot of the heap and of the event counters (see mm.h).
+ */
+mm_stats_t mm_stats(void)
+{
+    mm_stats_t stats=counters;
+    void *cur, *end, *s;
+
+#ifdef MM_STATS
+    stats.enabled=1;
+#endif
+    stats.heap_size=mem_heapsize();
+    stats.peak_heap_size=peak_heap_size;
+    stats.mapped_bytes=mapped_bytes;
+    stats.released_bytes=released_bytes;
+    stats.numa_bound_bytes=numa_bound_bytes;
+    stats.realloc_copies=realloc_copies;
+    stats.quick_blocks=quick_blocks;
+    stats.quick_bytes=quick_bytes;
+    stats.quarantine_blocks=quarantine_blocks+slab_quarantine_blocks;
+    stats.quarantine_bytes=quarantine_bytes+slab_quarantine_bytes;
+
+    cur=mem_heap_lo()+MIN_BLOCK_SIZE;
+    end=mem_heap_hi()-WSIZE+1;
+    while(cur<end){
+        if(CUR_FREE(cur)){
+            stats.free_blocks++;
+            stats.free_bytes+=CUR_SIZE_MASKED(cur);
+            if(CUR_SIZE_MASKED(cur)>stats.largest_free){
+                stats.largest_free=CUR_SIZE_MASKED(cur);
+            }
         }
+        cur=NEXT_BLOCK(cur,CUR_SIZE_MASKED(cur));
     }
-}
-
+    stats.fragmentation=stats.free_bytes ? 1.0-(double)stats.largest_free/stats.free_bytes : 0.0;
 
+    for(s=slab_lo;s<slab_top;s+=SLAB_PAGE_SIZE){
+        stats.slab_pages++;
+        if(SLAB_CLASS(s)!=SLAB_NONE){
+            stats.slab_objects+=SLAB_IN_USE(s)-SLAB_HELD(s);
+            stats.slab_bytes+=(SLAB_IN_USE(s)-SLAB_HELD(s))*SLAB_OBJ_SIZE(SLAB_CLASS(s));
+        }
+    }
+    stats.tree_height=tree_height_from(LEFT_CHILD(tree_root), &stats.tree_nodes);
+    return stats;
+}
 
 /*The following functions of the red-black tree are helper funtions for us to check the heap consistency*/
 
@@ -755,15 +3112,16 @@ void tree_print_preorder(){
  * tree_check_preorder_from -check whether the tree has allocated blocks starint from (void *)node in a preorder fashion.
  */
 int tree_check_preorder_from(void *node){
+    /*the node first: the links of an allocated (or held) block are not those of the tree*/
+    if(!CUR_FREE(node)){
+        printf("Error: %p is an allocated block in Red-black tree.\n", node);
+        return 0;
+    }
     if(LEFT_CHILD(node)!=tree_null){
         if(!tree_check_preorder_from(LEFT_CHILD(node))){
             return 0;
         }
     }
-    if(!CUR_FREE(node)){
-        printf("Error: %p is an allocated block in Red-black tree.\n", node);
-        return 0;
-    }
     if(RIGHT_CHILD(node)!=tree_null){
         if(!tree_check_preorder_from(RIGHT_CHILD(node))){
             return 0;
@@ -784,11 +3142,336 @@ int tree_check_preorder(){
 }
 
 
+/*
+ * seg_check - check every segregated list: each node must be free, of the exact size of its class
+ * and correctly linked, and seg_bitmap must agree with the lists. Return the number of listed blocks, -1 on error.
+ */
+long seg_check(int verbose){
+    void *node, *prev;
+    long count=0;
+    int idx;
+
+    for(idx=0;idx<SEG_CLASSES;idx++){
+        if((seg_heads[idx]!=NULL)!=((seg_bitmap>>idx)&1)){
+            printf("Error: bitmap bit %d does not match the segregated list of size %d\n", idx, MIN_BLOCK_SIZE+idx*DSIZE);
+            return -1;
+        }
+        prev=NULL;
+        for(node=seg_heads[idx];node!=NULL;node=SEG_NEXT(node)){
+            if(!CUR_FREE(node)){
+                printf("Error: %p is an allocated block in a segregated list.\n", node);
+                return -1;
+            }
+            if(CUR_SIZE_MASKED(node)!=(size_t)(MIN_BLOCK_SIZE+idx*DSIZE)){
+                printf("Error: %p of size %zu is in the segregated list of size %d\n", node, CUR_SIZE_MASKED(node), MIN_BLOCK_SIZE+idx*DSIZE);
+                return -1;
+            }
+            if(SEG_PREV(node)!=prev){
+                printf("Error: %p has a broken back link in a segregated list\n", node);
+                return -1;
+            }
+            if(verbose){
+                printf("[%d] %p : %zu\n", idx, node, CUR_SIZE_MASKED(node));
+            }
+            prev=node;
+            count++;
+        }
+    }
+    return count;
+}
+
+#ifdef MM_INDEX_TLSF
+/*
+ * tlsf_check - check every TLSF list: each node must be free, in the class of its size and correctly linked,
+ * and both bitmaps must agree with the lists. Return the number of listed blocks, -1 on error.
+ */
+long tlsf_check(int verbose){
+    void *node, *prev;
+    long count=0;
+    int fl, sl, node_fl, node_sl;
+
+    for(fl=0;fl<TLSF_FL_COUNT;fl++){
+        if((tlsf_sl_bitmap[fl]!=0)!=((tlsf_fl_bitmap>>fl)&1)){
+            printf("Error: first-level bit %d does not match its second-level bitmap\n", fl);
+            return -1;
+        }
+        for(sl=0;sl<TLSF_SL_COUNT;sl++){
+            if((tlsf_heads[fl][sl]!=NULL)!=((tlsf_sl_bitmap[fl]>>sl)&1)){
+                printf("Error: bitmap bit %d,%d does not match its TLSF list\n", fl, sl);
+                return -1;
+            }
+            prev=NULL;
+            for(node=tlsf_heads[fl][sl];node!=NULL;node=SEG_NEXT(node)){
+                if(!CUR_FREE(node)){
+                    printf("Error: %p is an allocated block in a TLSF list.\n", node);
+                    return -1;
+                }
+                tlsf_mapping(CUR_SIZE_MASKED(node), &node_fl, &node_sl);
+                if(!IS_IN_TREE(node) || node_fl!=fl || node_sl!=sl){
+                    printf("Error: %p of size %zu is in the TLSF list %d,%d\n", node, CUR_SIZE_MASKED(node), fl, sl);
+                    return -1;
+                }
+                if(SEG_PREV(node)!=prev){
+                    printf("Error: %p has a broken back link in a TLSF list\n", node);
+                    return -1;
+                }
+                if(verbose){
+                    printf("[%d,%d] %p : %zu\n", fl, sl, node, CUR_SIZE_MASKED(node));
+                }
+                prev=node;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+#endif
+
+/*
+ * index_holds - check whether the block is in the index (its segregated list, the tree or its TLSF list),
+ * whatever its header says. A list is followed for no more blocks than the heap can hold, in case it is broken.
+ */
+int index_holds(void *block){
+    size_t size=CUR_SIZE_MASKED(block), steps=mem_heapsize()/MIN_BLOCK_SIZE;
+    void *node=NULL;
+
+    if(size<=SEG_MAX_SIZE){
+        node=seg_heads[SEG_INDEX(size)];
+    }else{
+#ifdef MM_INDEX_TLSF
+        int fl, sl;
+
+        tlsf_mapping(size, &fl, &sl);
+        node=tlsf_heads[fl][sl];
+#else
+        return tree_find_exact(block);
+#endif
+    }
+    for(;node!=NULL && steps>0;node=SEG_NEXT(node), steps--){
+        if(node==block){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * quick_check - check the quick cache: every held block must have the H bit (and not the F bit) and the
+ * exact size of its class, must not be in the index too, and the counts must agree with the lists. Return the
+ * number of held blocks, -1 on error.
+ */
+long quick_check(int verbose){
+    void *node, *prev;
+    size_t bytes=0;
+    long count=0;
+    int idx;
+
+    for(idx=0;idx<QUICK_CLASSES;idx++){
+        prev=NULL;
+        for(node=quick_heads[idx];node!=NULL;node=QUICK_NEXT(node)){
+            if(!CUR_HELD(node) || CUR_FREE(node)){
+                printf("Error: %p is in the quick cache but not marked as held\n", node);
+                return -1;
+            }
+            if(QUICK_PREV(node)!=prev){
+                printf("Error: %p has a broken back link in the quick cache\n", node);
+                return -1;
+            }
+            if(CUR_SIZE_MASKED(node)!=(size_t)(MIN_BLOCK_SIZE+idx*DSIZE)){
+                printf("Error: %p of size %zu is in the quick list of size %d\n", node, CUR_SIZE_MASKED(node), MIN_BLOCK_SIZE+idx*DSIZE);
+                return -1;
+            }
+            if(index_holds(node)){
+                printf("Error: %p is in the quick cache and in the index\n", node);
+                return -1;
+            }
+            if(verbose){
+                printf("(quick %d) %p : %zu\n", idx, node, CUR_SIZE_MASKED(node));
+            }
+            bytes+=CUR_SIZE_MASKED(node);
+            prev=node;
+            count++;
+        }
+    }
+    if((size_t)count!=quick_blocks || bytes!=quick_bytes){
+        printf("Error: the quick cache holds %ld blocks of %zu bytes, but counts %zu of %zu bytes\n", count, bytes, quick_blocks, quick_bytes);
+        return -1;
+    }
+    return count;
+}
+
+#ifdef MM_HARDENED
+/*
+ * quarantine_check - check the quarantines: every block in the quarantine must be held, every object in the
+ * quarantine of slab objects must be a freed object of a slab in use, and the counts must agree with them.
+ * Return the number of quarantined blocks and objects, -1 on error.
+ */
+long quarantine_check(int verbose){
+    void *node, *last=NULL, *slab;
+    size_t bytes=0;
+    long count=0;
+    unsigned int i;
+
+    for(node=quarantine_head;node!=NULL;node=QUICK_NEXT(node)){
+        if(!CUR_HELD(node) || CUR_FREE(node)){
+            printf("Error: %p is in the quarantine but not marked as held\n", node);
+            return -1;
+        }
+        if(verbose){
+            printf("(quarantine) %p : %zu\n", node, CUR_SIZE_MASKED(node));
+        }
+        bytes+=CUR_SIZE_MASKED(node);
+        last=node;
+        count++;
+    }
+    if(last!=quarantine_tail || (size_t)count!=quarantine_blocks || bytes!=quarantine_bytes){
+        printf("Error: the quarantine holds %ld blocks of %zu bytes, but counts %zu of %zu bytes\n", count, bytes, quarantine_blocks, quarantine_bytes);
+        return -1;
+    }
+    bytes=0;
+    for(i=0;i<SLAB_QUARANTINE;i++){
+        node=slab_quarantine[i];
+        if(node==NULL){
+            continue;
+        }
+        slab=SLAB_OF(node);
+        if(!IS_SLAB(node) || SLAB_CLASS(slab)==SLAB_NONE || (SLAB_USED_WORD(slab, SLAB_INDEX(slab, node)) & SLAB_USED_BIT(SLAB_INDEX(slab, node)))){
+            printf("Error: %p is in the quarantine of slab objects but not a freed slab object\n", node);
+            return -1;
+        }
+        if(verbose){
+            printf("(quarantine) %p : %u\n", node, SLAB_OBJ_SIZE(SLAB_CLASS(slab)));
+        }
+        bytes+=SLAB_OBJ_SIZE(SLAB_CLASS(slab));
+        count++;
+    }
+    if((size_t)count!=quarantine_blocks+slab_quarantine_blocks || bytes!=slab_quarantine_bytes){
+        printf("Error: the quarantine of slab objects holds %zu objects of %zu bytes, but counts %zu of %zu bytes\n",
+               count-quarantine_blocks, bytes, slab_quarantine_blocks, slab_quarantine_bytes);
+        return -1;
+    }
+    return count;
+}
+#endif
+
+/*
+ * slab_check_page - check the slab s (in use, not spare): its objects in use, free and never handed out must add
+ * up to its capacity, its free list must only link objects of the slab that are not handed out, its bitmap must
+ * count the objects in use but in the quarantine (whose canaries the hardened build checks), and it must be in the
+ * list of its class exactly when it has free objects. Return 0 if it is consistent, -1 on error.
+ */
+int slab_check_page(void *s){
+    void *obj, *end;
+    unsigned int cls=SLAB_CLASS(s), free_objs=0, used=0, i;
+
+    if(cls>=SLAB_CLASSES){
+        printf("Error: slab %p has an invalid class %u\n", s, cls);
+        return -1;
+    }
+    end=SLAB_FIRST(s)+SLAB_CAPACITY(cls)*SLAB_OBJ_SIZE(cls);
+    if(SLAB_BUMP(s)<SLAB_FIRST(s) || SLAB_BUMP(s)>end || (SLAB_BUMP(s)-SLAB_FIRST(s))%SLAB_OBJ_SIZE(cls)){
+        printf("Error: slab %p has an invalid bump pointer %p\n", s, SLAB_BUMP(s));
+        return -1;
+    }
+    for(obj=SLAB_FREE(s);obj!=NULL;obj=*(void**)obj){
+        if(obj<SLAB_FIRST(s) || obj>=SLAB_BUMP(s) || (obj-SLAB_FIRST(s))%SLAB_OBJ_SIZE(cls) || ++free_objs>SLAB_CAPACITY(cls)){
+            printf("Error: slab %p has an invalid object %p in its free list\n", s, obj);
+            return -1;
+        }
+        i=SLAB_INDEX(s, obj);
+        if(SLAB_USED_WORD(s, i) & SLAB_USED_BIT(i)){
+            printf("Error: slab %p has the object %p in its free list, but handed out\n", s, obj);
+            return -1;
+        }
+    }
+    for(i=0;i<SLAB_USED_WORDS;i++){
+        used+=__builtin_popcountl(SLAB_USED(s)[i]);
+    }
+    if(used+SLAB_HELD(s)!=SLAB_IN_USE(s)){
+        printf("Error: slab %p has %u objects in use, but %u handed out in its bitmap and %u in the quarantine\n", s, SLAB_IN_USE(s), used, SLAB_HELD(s));
+        return -1;
+    }
+#ifdef MM_HARDENED
+    for(obj=SLAB_FIRST(s);obj<SLAB_BUMP(s);obj+=SLAB_OBJ_SIZE(cls)){
+        i=SLAB_INDEX(s, obj);
+        if((SLAB_USED_WORD(s, i) & SLAB_USED_BIT(i)) && SLAB_CANARY(obj, cls)!=GUARD_CANARY(obj)){
+            printf("Error: the canary at the end of %p is overwritten\n", obj);
+            return -1;
+        }
+    }
+#endif
+    if(SLAB_IN_USE(s)+free_objs+(end-SLAB_BUMP(s))/SLAB_OBJ_SIZE(cls)!=SLAB_CAPACITY(cls)){
+        printf("Error: slab %p has %u objects in use and %u free, but room for %u\n", s, SLAB_IN_USE(s), free_objs, SLAB_CAPACITY(cls));
+        return -1;
+    }
+    if(SLAB_LISTED(s)!=(SLAB_IN_USE(s)<SLAB_CAPACITY(cls))){
+        printf("Error: slab %p %s the list of its class\n", s, SLAB_LISTED(s) ? "is full but in" : "has free objects but is not in");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * slab_check - check every slab with slab_check_page, and that the lists of slabs with free objects and the spare
+ * list hold exactly the slabs they should. Return the number of slabs, -1 on error.
+ */
+long slab_check(int verbose){
+    void *s, *prev;
+    long count=0, listed=0, spare=0;
+    unsigned int idx;
+
+    for(s=slab_lo;s<slab_top;s+=SLAB_PAGE_SIZE){
+        count++;
+        if(SLAB_CLASS(s)==SLAB_NONE){
+            spare++;
+            continue;
+        }
+        if(slab_check_page(s)<0){
+            return -1;
+        }
+        listed+=SLAB_LISTED(s);
+        if(verbose){
+            printf("slab %p : %u x %u bytes\n", s, SLAB_IN_USE(s), SLAB_OBJ_SIZE(SLAB_CLASS(s)));
+        }
+    }
+    for(idx=0;idx<SLAB_CLASSES;idx++){
+        prev=NULL;
+        for(s=slab_partial[idx];s!=NULL;s=SLAB_NEXT(s)){
+            if(SLAB_CLASS(s)!=idx || SLAB_PREV(s)!=prev){
+                printf("Error: slab %p is misplaced in the list of class %u\n", s, idx);
+                return -1;
+            }
+            prev=s;
+            listed--;
+        }
+    }
+    for(s=slab_spare;s!=NULL;s=SLAB_NEXT(s)){
+        spare--;
+    }
+    if(listed!=0 || spare!=0){
+        printf("Error: the slab lists do not match the slabs\n");
+        return -1;
+    }
+    return count;
+}
+
 /*With all these helper functions, now we can implement mm_checkheap*/
 void mm_checkheap(int verbose) 
 {
     void *cur, *end;
-
+    long seg_listed, seg_seen=0, quick_held, quick_seen=0;
+    int rover_seen=0;
+#ifdef MM_INDEX_TLSF
+    long tlsf_listed, tlsf_seen=0;
+#endif
+
+#ifdef MM_INDEX_TLSF
+    /*Are the TLSF lists well formed?*/
+    tlsf_listed=tlsf_check(verbose);
+    if(tlsf_listed>=0){
+        printf("Pass: every block in the TLSF lists is free and in its size class\n");
+    }
+#else
     /*Is every block in the tree marked as free?*/
     if(tree_check_preorder()){
         printf("Pass: every block in the tree is marked as free\n");
@@ -797,38 +3480,569 @@ void mm_checkheap(int verbose)
     if(verbose){
         tree_print_preorder();
     }
+#endif
+
+    /*Are the segregated lists well formed?*/
+    seg_listed=seg_check(verbose);
+    if(seg_listed>=0){
+        printf("Pass: every block in the segregated lists is free and in its size class\n");
+    }
+
+    /*Is the quick cache consistent?*/
+    quick_held=quick_check(verbose);
+    if(quick_held>=0){
+        printf("Pass: every block in the quick cache is held and in its size class\n");
+    }
+
+#ifdef MM_HARDENED
+    /*Is the quarantine consistent?*/
+    if(quarantine_check(verbose)>=0){
+        printf("Pass: every block in the quarantine is held\n");
+    }
+#endif
+
+    /*Are the slabs consistent?*/
+    if(slab_check(verbose)>=0){
+        printf("Pass: every slab is consistent with its lists\n");
+    }
 
     /*Are there any contiguous free blocks that somehow escaped coalescing?*/
     cur=mem_heap_lo()+MIN_BLOCK_SIZE;
     end=mem_heap_hi()-WSIZE+1;
     while(cur<end){
+        if(CUR_HELD(cur)){
+            quick_seen++;
+        }
+#ifdef MM_HARDENED
+        /*Is every allocated (or quarantined) block intact?*/
+        if(!CUR_FREE(cur) && (CUR_SIZE(cur)>>TAG_SHIFT)!=GUARD_TAG(cur)){
+            printf("Error: the header of %p is corrupted\n", cur);
+            break;
+        }
+        if(!CUR_FREE(cur) && CANARY(cur)!=GUARD_CANARY(cur)){
+            printf("Error: the canary at the end of %p is overwritten\n", cur);
+        }
+#endif
         if(CUR_FREE(cur)){
             if(PREV_FREE(cur)){
                 /*Contiguous free blocks detected*/
                 printf("Error: %p,%p are contiguous free blocks\n", PREV_BLOCK(cur,CUR_SIZE_MASKED(cur)),cur);
                 break;
             }
-            /*Is every free block with size larger than MIN_BLOCK_SIZE actually tracked by the tree?*/
+            /*Is there a free block too small to be tracked at all?*/
+            if(CUR_SIZE_MASKED(cur)<MIN_BLOCK_SIZE){
+                printf("Error: %p is a free block of %zu bytes, smaller than MIN_BLOCK_SIZE\n", cur, CUR_SIZE_MASKED(cur));
+                break;
+            }
+            /*Is every free block with size larger than SEG_MAX_SIZE actually tracked by the tree?*/
+#ifdef MM_INDEX_TLSF
+            if(IS_IN_TREE(cur)){
+                tlsf_seen++;
+            }
+#else
             if(IS_IN_TREE(cur) && !tree_find_exact(cur)){
-                printf("Error: %p is a free block with size larger than MIN_BLOCK_SIZE, but it is not tracked by the tree\n", cur);
+                printf("Error: %p is a free block with size larger than SEG_MAX_SIZE, but it is not tracked by the tree\n", cur);
                 break;
             }
+#endif
+            if(IS_IN_SEG(cur)){
+                seg_seen++;
+            }
+            if(cur==rover){
+                rover_seen=1;
+            }
         }
         if(verbose){
             printf("---[ %zu ]---", CUR_SIZE_MASKED(cur));
         }
         cur=NEXT_BLOCK(cur,CUR_SIZE_MASKED(cur));
     }
-    printf("/n");
+    printf("\n");
+
+    /*Is every small free block actually tracked by its segregated list?*/
+    if(cur>=end && seg_listed>=0 && seg_seen!=seg_listed){
+        printf("Error: %ld small free blocks in the heap, but %ld in the segregated lists\n", seg_seen, seg_listed);
+    }
+
+    /*Is every held block of the heap actually in the quick cache or the quarantine?*/
+    if(cur>=end && quick_held>=0 && (size_t)quick_seen!=quick_held+quarantine_blocks){
+        printf("Error: %ld held blocks in the heap, but %ld in the quick cache and %zu in the quarantine\n", quick_seen, quick_held, quarantine_blocks);
+    }
+
+    /*Is the rover of MM_PLACE_NEXT a free block?*/
+    if(cur>=end && rover!=NULL && !rover_seen){
+        printf("Error: the rover %p is not a free block of the heap\n", rover);
+    }
+#ifdef MM_INDEX_TLSF
+    /*Is every large free block actually tracked by its TLSF list?*/
+    if(cur>=end && tlsf_listed>=0 && tlsf_seen!=tlsf_listed){
+        printf("Error: %ld large free blocks in the heap, but %ld in the TLSF lists\n", tlsf_seen, tlsf_listed);
+    }
+#endif
+}
+
+/*
+ * list_check_node - check the links of node in the doubly linked list starting at head (a segregated, TLSF or
+ * quick list): node must be linked back by both of its neighbours, or be the head. Return 1 if so, 0 otherwise.
+ */
+int list_check_node(void *node, void *head, void *end){
+    void *prev=SEG_PREV(node), *next=SEG_NEXT(node);
+
+    if((prev==NULL ? head!=node : !IN_HEAP(prev,end) || SEG_NEXT(prev)!=node) || (next!=NULL && (!IN_HEAP(next,end) || SEG_PREV(next)!=node))){
+        printf("Error: %p has broken links in its list\n", node);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * tree_check_node - check the links of node in the Red-black Tree: it must be a child of its parent, its children
+ * must have it as their parent and come before and after it, and a red node can have neither a red child nor the
+ * root for parent. Return 1 if so, 0 otherwise.
+ */
+int tree_check_node(void *node, void *end){
+    void *parent=TREE_PARENT(node), *left=LEFT_CHILD(node), *right=RIGHT_CHILD(node);
+
+    if(parent==tree_root ? LEFT_CHILD(tree_root)!=node : !IN_HEAP(parent,end) || (LEFT_CHILD(parent)!=node && RIGHT_CHILD(parent)!=node)){
+        printf("Error: %p is not a child of its parent %p in the tree\n", node, parent);
+        return 0;
+    }
+    if((left!=tree_null && (!IN_HEAP(left,end) || TREE_PARENT(left)!=node || !TREE_BEFORE(left,node)))
+       || (right!=tree_null && (!IN_HEAP(right,end) || TREE_PARENT(right)!=node || !TREE_BEFORE(node,right)))){
+        printf("Error: %p has a misplaced child in the tree\n", node);
+        return 0;
+    }
+    if(IS_RED(node) && (parent==tree_root || IS_RED(left) || IS_RED(right))){
+        printf("Error: %p is a red node with a red child, or a red root\n", node);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * block_check - check the block cur of the heap (end is the epilogue) in constant time: its size, the boundary tag
+ * after it, and
+ *  - for a free block: that the block before it is not free, and its links in the index;
+ *  - for a held block: its links in the quick cache;
+ *  - in the hardened build, for an allocated or held block: its tag and canary.
+ * Return 1 if the block is sound, 0 if it is not, -1 if not even its size is (the blocks after it cannot be found).
+ */
+int block_check(void *cur, void *end){
+    size_t size=CUR_SIZE_MASKED(cur);
+    void *next;
+#ifdef MM_INDEX_TLSF
+    int fl, sl;
+#endif
+
+    next=NEXT_BLOCK(cur,size);
+    if(size<MIN_BLOCK_SIZE || size%DSIZE || next>end){
+        printf("Error: %p has an invalid size %zu\n", cur, size);
+        return -1;
+    }
+    if(PREV_SIZE_MASKED(next)!=size || PREV_FREE(next)!=CUR_FREE(cur)){
+        printf("Error: the size after %p does not match its header\n", cur);
+        return 0;
+    }
+    if(CUR_FREE(cur)){
+        if(PREV_FREE(cur) || CUR_HELD(cur)){
+            printf("Error: %p is a free block after a free block, or held\n", cur);
+            return 0;
+        }
+        if(IS_IN_SEG(cur)){
+            return list_check_node(cur, seg_heads[SEG_INDEX(size)], end);
+        }
+#ifdef MM_INDEX_TLSF
+        tlsf_mapping(size, &fl, &sl);
+        return list_check_node(cur, tlsf_heads[fl][sl], end);
+#else
+        return tree_check_node(cur, end);
+#endif
+    }
+#ifdef MM_HARDENED
+    if((CUR_SIZE(cur)>>TAG_SHIFT)!=GUARD_TAG(cur)){
+        printf("Error: the header of %p is corrupted\n", cur);
+        return 0;
+    }
+    if(CANARY(cur)!=GUARD_CANARY(cur)){
+        printf("Error: the canary at the end of %p is overwritten\n", cur);
+        return 0;
+    }
+#else
+    if(CUR_HELD(cur)){
+        if(size>QUICK_MAX_SIZE){
+            printf("Error: %p of size %zu is held, but too large for the quick cache\n", cur, size);
+            return 0;
+        }
+        return list_check_node(cur, quick_heads[(size-MIN_BLOCK_SIZE)/DSIZE], end);
+    }
+#endif
+    return 1;
+}
+
+/*
+ * index_check - check in constant time what no block can tell: the bitmaps of the segregated (and TLSF) lists
+ * must agree with their heads, and the rover must be a free block. Return the number of errors.
+ */
+long index_check(void *end){
+    long errors=0;
+    int idx;
+#ifdef MM_INDEX_TLSF
+    int sl;
+#endif
+
+    for(idx=0;idx<SEG_CLASSES;idx++){
+        if((seg_heads[idx]!=NULL)!=((seg_bitmap>>idx)&1)){
+            printf("Error: bitmap bit %d does not match the segregated list of size %d\n", idx, MIN_BLOCK_SIZE+idx*DSIZE);
+            errors++;
+        }
+    }
+#ifdef MM_INDEX_TLSF
+    for(idx=0;idx<TLSF_FL_COUNT;idx++){
+        if((tlsf_sl_bitmap[idx]!=0)!=((tlsf_fl_bitmap>>idx)&1)){
+            printf("Error: first-level bit %d does not match its second-level bitmap\n", idx);
+            errors++;
+        }
+        for(sl=0;sl<TLSF_SL_COUNT;sl++){
+            if((tlsf_heads[idx][sl]!=NULL)!=((tlsf_sl_bitmap[idx]>>sl)&1)){
+                printf("Error: bitmap bit %d,%d does not match its TLSF list\n", idx, sl);
+                errors++;
+            }
+        }
+    }
+#endif
+    if(rover!=NULL && (!IN_HEAP(rover,end) || !CUR_FREE(rover))){
+        printf("Error: the rover %p is not a free block of the heap\n", rover);
+        errors++;
+    }
+    return errors;
+}
+
+/*
+ * mm_checkheap_incremental - check the next budget blocks of the heap with block_check, then the slabs (one per
+ * unit of budget) with slab_check_page, resuming where the last call stopped. After the last slab, the next call
+ * starts over at the bottom of the heap, with index_check. Nothing is printed unless an error is found.
+ * Return the number of errors found.
+ */
+long mm_checkheap_incremental(size_t budget){
+    void *cur=check_cursor, *end=mem_heap_hi()-WSIZE+1;
+    long errors=0;
+    int sound;
+
+    for(;budget>0;budget--){
+        if(cur==NULL){
+            errors+=index_check(end);
+            cur=mem_heap_lo()+MIN_BLOCK_SIZE;
+        }
+        if(cur==end){
+            cur=slab_lo;
+        }
+        if(cur>=mem_heap_lo() && cur<end){
+            sound=block_check(cur, end);
+            errors+=sound<=0;
+            /*past a block of invalid size, the rest of the heap cannot be found*/
+            cur=sound<0 ? end : NEXT_BLOCK(cur,CUR_SIZE_MASKED(cur));
+        }else if(cur>=slab_lo && cur<slab_top){
+            if(SLAB_CLASS(cur)!=SLAB_NONE && slab_check_page(cur)<0){
+                errors++;
+            }
+            cur+=SLAB_PAGE_SIZE;
+        }else{
+            /*past the last slab (or there are none): the pass is over*/
+            cur=NULL;
+        }
+    }
+    check_cursor=cur;
+    return errors;
 }
 
+/*
+ * check_random - draw the next number of the xorshift generator of mm_checkheap_sampled.
+ */
+static inline unsigned long check_random(void){
+    check_rng^=check_rng>>12;
+    check_rng^=check_rng<<25;
+    check_rng^=check_rng>>27;
+    return check_rng*2685821657736338717UL;
+}
 
+/*
+ * check_random_bit - pick one of the set bits of bits (not 0) at random.
+ */
+static inline int check_random_bit(unsigned long bits){
+    int k=check_random()%__builtin_popcountl(bits);
 
+    while(k-->0){
+        bits&=bits-1;
+    }
+    return __builtin_ctzl(bits);
+}
 
+/*
+ * list_sample - walk a random number of steps (less than LIST_SAMPLE_STEPS) down a list from its head node, checking
+ * the back link of every node on the way. Return the node reached, NULL if a link is broken or leaves the heap.
+ */
+void *list_sample(void *node, void *end){
+    int steps=check_random()%LIST_SAMPLE_STEPS;
+    void *next;
+
+    for(;steps>0 && SEG_NEXT(node)!=NULL;steps--){
+        next=SEG_NEXT(node);
+        if(!IN_HEAP(next,end) || SEG_PREV(next)!=node){
+            return NULL;
+        }
+        node=next;
+    }
+    return node;
+}
 
+/*
+ * free_sample - pick a free block of the heap at random: from a random non-empty segregated list, or at the end
+ * of a random path down the tree (from a random non-empty TLSF list with MM_INDEX_TLSF).
+ * Return the block, tree_null if no block is free, NULL if a link of the index leaves the heap.
+ */
+void *free_sample(void *end){
+    int large;
+    void *node;
+#ifdef MM_INDEX_TLSF
+    int fl;
+
+    large=tlsf_fl_bitmap!=0;
+#else
+    void *child;
+
+    large=LEFT_CHILD(tree_root)!=tree_null;
+#endif
+    if(seg_bitmap!=0 && (!large || check_random()%2)){
+        return list_sample(seg_heads[check_random_bit(seg_bitmap)], end);
+    }
+    if(!large){
+        return tree_null;
+    }
+#ifdef MM_INDEX_TLSF
+    fl=check_random_bit(tlsf_fl_bitmap);
+    node=tlsf_heads[fl][check_random_bit(tlsf_sl_bitmap[fl])];
+    return node!=NULL && IN_HEAP(node,end) ? list_sample(node, end) : NULL;
+#else
+    node=LEFT_CHILD(tree_root);
+    while(IN_HEAP(node,end)){
+        child=check_random()%2 ? LEFT_CHILD(node) : RIGHT_CHILD(node);
+        if(child==tree_null){
+            return node;
+        }
+        node=child;
+    }
+    return NULL;
+#endif
+}
 
+/*
+ * mm_checkheap_sampled - check samples blocks picked at random with block_check: free blocks from the indices
+ * (see free_sample), each together with the blocks right before and after it. When there are slabs, every other
+ * sample is a random slab instead, checked with slab_check_page. Allocated blocks are only reached next to free
+ * ones; mm_checkheap_incremental reaches every block. Nothing is printed unless an error is found.
+ * Return the number of errors found.
+ */
+long mm_checkheap_sampled(size_t samples){
+    void *block, *next, *s, *end=mem_heap_hi()-WSIZE+1;
+    long errors=0;
+    size_t i;
+    int sound;
+
+    for(i=0;i<samples;i++){
+        if(slab_top>slab_lo && i%2){
+            s=slab_lo+check_random()%((slab_top-slab_lo)/SLAB_PAGE_SIZE)*SLAB_PAGE_SIZE;
+            if(SLAB_CLASS(s)!=SLAB_NONE && slab_check_page(s)<0){
+                errors++;
+            }
+            continue;
+        }
+        block=free_sample(end);
+        if(block==tree_null){
+            continue;
+        }
+        if(block==NULL){
+            printf("Error: a link of the index of free blocks is broken\n");
+            errors++;
+            continue;
+        }
+        sound=block_check(block, end);
+        errors+=sound<=0;
+        if(sound<0){
+            continue;
+        }
+        next=NEXT_BLOCK(block,CUR_SIZE_MASKED(block));
+        if(next<end){
+            errors+=block_check(next, end)<=0;
+        }
+        if(block>mem_heap_lo()+MIN_BLOCK_SIZE){
+            if(!IN_HEAP(PREV_BLOCK(block,PREV_SIZE_MASKED(block)),end)){
+                printf("Error: the size before %p leaves the heap\n", block);
+                errors++;
+            }else{
+                errors+=block_check(PREV_BLOCK(block,PREV_SIZE_MASKED(block)), end)<=0;
+            }
+        }
+    }
+    return errors;
+}
 
+/*
+ * mm_detach - save the state of the allocator in the heap image, with root (any pointer into the heap, for the
+ * program to find its data again), and write the image to its file. The heap must not change after this until
+ * mm_attach (or mm_init). Return 0 on success, -1 if the heap is not an image or cannot be written.
+ */
+int mm_detach(void *root){
+    image_t *image=mem_image_root();
 
+    if(image==NULL){
+        return -1;
+    }
+    quick_flush();
+    image->magic=IMAGE_MAGIC;
+    image->config=IMAGE_CONFIG;
+    image->heap_lo=mem_heap_lo();
+    image->heap_size=mem_heapsize();
+    image->user_root=root;
+    memcpy(image->seg_heads, seg_heads, sizeof(seg_heads));
+    image->seg_bitmap=seg_bitmap;
+#ifdef MM_INDEX_TLSF
+    memcpy(image->tlsf_heads, tlsf_heads, sizeof(tlsf_heads));
+    memcpy(image->tlsf_sl_bitmap, tlsf_sl_bitmap, sizeof(tlsf_sl_bitmap));
+    image->tlsf_fl_bitmap=tlsf_fl_bitmap;
+#endif
+    image->rover=rover;
+    image->guard_secret=guard_secret;
+    image->quarantine_head=quarantine_head;
+    image->quarantine_tail=quarantine_tail;
+    image->quarantine_blocks=quarantine_blocks;
+    image->quarantine_bytes=quarantine_bytes;
+    image->released_bytes=released_bytes;
+    image->realloc_copies=realloc_copies;
+    image->peak_heap_size=peak_heap_size;
+    /*the heap first, then the flag that vouches for it*/
+    if(mem_sync()<0){
+        return -1;
+    }
+    image->clean=1;
+    return mem_sync();
+}
 
+/*
+ * image_check - check the heap of an image in constant time (unless validate): the prologue, the top block, and
+ * the heads and bitmaps of the index; with validate, every block with block_check. Return the number of errors.
+ */
+long image_check(int validate){
+    void *end=mem_heap_hi()-WSIZE+1, *cur, *top;
+    long errors;
+    int idx, sound;
+#ifdef MM_INDEX_TLSF
+    int sl;
+#endif
+
+    if(CUR_SIZE_MASKED(tree_root)!=MIN_BLOCK_SIZE || end<mem_heap_lo()+MIN_BLOCK_SIZE){
+        printf("Error: the image has no prologue\n");
+        return 1;
+    }
+    errors=index_check(end);
+    if(PREV_SIZE_MASKED(end)!=0){
+        top=PREV_BLOCK(end,PREV_SIZE_MASKED(end));
+        if(!IN_HEAP(top,end)){
+            printf("Error: the size before the epilogue leaves the heap\n");
+            errors++;
+        }else{
+            errors+=block_check(top, end)<=0;
+        }
+    }
+    for(idx=0;idx<SEG_CLASSES;idx++){
+        if(seg_heads[idx]!=NULL && (!IN_HEAP(seg_heads[idx],end) || !CUR_FREE(seg_heads[idx]))){
+            printf("Error: the head of the segregated list of size %d is not a free block\n", MIN_BLOCK_SIZE+idx*DSIZE);
+            errors++;
+        }
+    }
+#ifdef MM_INDEX_TLSF
+    for(idx=0;idx<TLSF_FL_COUNT;idx++){
+        for(sl=0;sl<TLSF_SL_COUNT;sl++){
+            if(tlsf_heads[idx][sl]!=NULL && (!IN_HEAP(tlsf_heads[idx][sl],end) || !CUR_FREE(tlsf_heads[idx][sl]))){
+                printf("Error: the head of TLSF list %d,%d is not a free block\n", idx, sl);
+                errors++;
+            }
+        }
+    }
+#else
+    cur=LEFT_CHILD(tree_root);
+    if(cur!=tree_null && (!IN_HEAP(cur,end) || !CUR_FREE(cur) || TREE_PARENT(cur)!=tree_root)){
+        printf("Error: the root of the tree is not a free block\n");
+        errors++;
+    }
+#endif
+    if(validate){
+        for(cur=mem_heap_lo()+MIN_BLOCK_SIZE;cur<end;cur=NEXT_BLOCK(cur,CUR_SIZE_MASKED(cur))){
+            sound=block_check(cur, end);
+            errors+=sound<=0;
+            if(sound<0){
+                break;
+            }
+        }
+    }
+    return errors;
+}
 
+/*
+ * mm_attach - take over the heap image left by mm_detach, instead of calling mm_init, and store in *root (unless
+ * root is NULL) the pointer given to mm_detach. The image is checked with image_check first. Return 0 on success,
+ * -1 if the heap is not an image, was not detached cleanly, was written by another build or fails its check; the
+ * heap must then be emptied (mem_reset_brk) and set up again with mm_init.
+ */
+int mm_attach(int validate, void **root){
+    image_t *image=mem_image_root();
 
+    if(image==NULL || image->magic!=IMAGE_MAGIC || image->config!=IMAGE_CONFIG || !image->clean
+       || image->heap_lo!=mem_heap_lo() || image->heap_size!=mem_heapsize()){
+        return -1;
+    }
+    tree_root=tree_null=mem_heap_lo();
+    memcpy(seg_heads, image->seg_heads, sizeof(seg_heads));
+    seg_bitmap=image->seg_bitmap;
+#ifdef MM_INDEX_TLSF
+    memcpy(tlsf_heads, image->tlsf_heads, sizeof(tlsf_heads));
+    memcpy(tlsf_sl_bitmap, image->tlsf_sl_bitmap, sizeof(tlsf_sl_bitmap));
+    tlsf_fl_bitmap=image->tlsf_fl_bitmap;
+#endif
+    rover=image->rover;
+    guard_secret=image->guard_secret;
+    quarantine_head=image->quarantine_head;
+    quarantine_tail=image->quarantine_tail;
+    quarantine_blocks=image->quarantine_blocks;
+    quarantine_bytes=image->quarantine_bytes;
+    released_bytes=image->released_bytes;
+    realloc_copies=image->realloc_copies;
+    peak_heap_size=image->peak_heap_size;
+    /*the rest is as mm_init leaves it*/
+    check_cursor=NULL;
+    memset(quick_heads, 0, sizeof(quick_heads));
+    quick_blocks=quick_bytes=0;
+    mapped_bytes=0;
+    if(slab_lo!=NULL){
+        munmap(slab_lo, SLAB_REGION_SIZE);
+    }
+    slab_lo=slab_top=NULL;
+    memset(slab_partial, 0, sizeof(slab_partial));
+    slab_spare=NULL;
+    memset(slab_quarantine, 0, sizeof(slab_quarantine));
+    slab_quarantine_next=0;
+    slab_quarantine_blocks=slab_quarantine_bytes=0;
+    slab_max=0;
+    mmap_threshold=(size_t)-1;
+    memset(&counters, 0, sizeof(counters));
+#ifdef MM_PROFILE
+    prof_reset();
+#endif
+    if(image_check(validate)>0){
+        return -1;
+    }
+    image_dirty(image);
+    if(root!=NULL){
+        *root=image->user_root;
+    }
+    return 0;
+}
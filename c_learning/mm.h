@@ -0,0 +1,132 @@
+/*
+ * mm.h - interface of the malloc package in mm.c
+ */
+#ifndef MM_H
+#define MM_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int mm_init (void);
+extern void *mm_malloc (size_t size);
+extern void mm_free (void *ptr);
+extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_calloc(size_t nmemb, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern void *mm_aligned_alloc(size_t alignment, size_t size);
+extern void *mm_memalign_offset(size_t alignment, size_t offset, size_t size);
+extern void mm_free_sized(void *ptr, size_t size);
+extern size_t mm_usable_size(void *ptr);
+extern void mm_checkheap(int verbose);
+extern long mm_checkheap_incremental(size_t budget);
+extern long mm_checkheap_sampled(size_t samples);
+extern int mm_malloc_batch(size_t size, size_t n, void **ptrs);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/*Tuning options for mm_setopt*/
+#define MM_OPT_TRIM_THRESHOLD 1   /*free space at the top of the heap that triggers trimming, (size_t)-1 for never*/
+#define MM_OPT_MMAP_THRESHOLD 2   /*smallest request given a mapping of its own, (size_t)-1 for never*/
+#define MM_OPT_SLAB_MAX 3         /*largest request served by a slab (at most 256, canary included with MM_HARDENED), 0 for never*/
+#define MM_OPT_PLACEMENT 4        /*which free block serves a request, one of MM_PLACE_* below*/
+#define MM_OPT_GROWTH 5           /*how far the heap grows when no free block fits, one of MM_GROW_* below*/
+#define MM_OPT_QUICK_MAX 6        /*largest block (header included, at most 1024, 0 with MM_HARDENED) freed into the quick cache, 0 for never*/
+#define MM_OPT_PROF_RATE 7        /*mean number of bytes allocated between two requests sampled for the heap profile (needs MM_PROFILE, see mm_prof.h), 0 for none*/
+#define MM_OPT_NUMA 8             /*1 to bind what the heap grows by to the NUMA node of the growing thread (where mbind works), 0 for the system default*/
+
+/*Placement policies*/
+#define MM_PLACE_BEST 0           /*smallest fitting block (the default)*/
+#define MM_PLACE_BEST_ADDR 1      /*smallest fitting block, the lowest address among those of the same size*/
+#define MM_PLACE_FIRST 2          /*first fitting block the search of the index comes across*/
+#define MM_PLACE_NEXT 3           /*what is left of the block split last, if it fits; first fit otherwise*/
+
+/*Growth policies*/
+#define MM_GROW_EXACT 0           /*by exactly what the request lacks (the default)*/
+#define MM_GROW_CHUNK 1           /*by what the request lacks, rounded up to CHUNKSIZE (4 KiB)*/
+#define MM_GROW_GEOMETRIC 2       /*by a quarter of the heap, or what the request lacks if that is more*/
+#define MM_GROW_HUGE 3            /*to the next 2 MiB boundary, with transparent huge pages asked for*/
+
+extern int mm_setopt(int option, size_t value);
+extern int mm_trim(size_t pad);
+extern size_t mm_released_bytes(void);
+extern size_t mm_mapped_bytes(void);
+extern size_t mm_realloc_copies(void);
+extern size_t mm_footprint(void);
+
+/*Heap images (a heap mapped from a file with mem_init_mapped, see memlib.h)*/
+extern int mm_attach(int validate, void **root);
+extern int mm_detach(void *root);
+
+/*
+ * Snapshot returned by mm_stats. The event counters are only maintained when mm.c is built
+ * with -DMM_STATS (enabled is then 1); the heap state is always filled in.
+ * Requests are counted by size class: class 0 holds sizes below 16 bytes, class i sizes
+ * in [2^(i+3), 2^(i+4)), and the last class everything larger.
+ */
+#define MM_STATS_CLASSES 24
+
+typedef struct {
+    int enabled;
+    /*event counters*/
+    size_t mallocs[MM_STATS_CLASSES];
+    size_t frees[MM_STATS_CLASSES];
+    size_t reallocs[MM_STATS_CLASSES];
+    size_t finds;                   /*tree_find searches*/
+    size_t find_nodes;              /*tree nodes visited by them*/
+    size_t find_max_depth;          /*deepest search*/
+    size_t splits, coalesces;
+    size_t realloc_shrink;          /*mm_realloc branches: shrunk in place*/
+    size_t realloc_merge_next;      /*grown into the free next block*/
+    size_t realloc_extend;          /*grown by extending the heap*/
+    size_t realloc_merge_prev;      /*grown by sliding into the free previous block*/
+    size_t realloc_last_resort;     /*moved by mm_realloc_last_resort*/
+    size_t realloc_remap;           /*huge block resized with mremap*/
+    size_t quick_hits;              /*requests served from the quick cache*/
+    size_t consolidations;          /*passes emptying the quick cache*/
+    /*violations detected by the hardened build (MM_HARDENED), counted even without MM_STATS*/
+    size_t canary_violations;       /*overflows past the end of a block*/
+    size_t header_violations;       /*headers that fail their check*/
+    size_t double_frees;
+    size_t use_after_frees;         /*blocks written to while in the quarantine*/
+    /*heap state*/
+    size_t heap_size, peak_heap_size;
+    size_t mapped_bytes, released_bytes, realloc_copies;
+    size_t numa_bound_bytes;        /*heap growth bound to a NUMA node (MM_OPT_NUMA)*/
+    size_t free_blocks, free_bytes, largest_free;
+    size_t tree_nodes, tree_height;
+    size_t slab_pages;              /*slabs in use or spare*/
+    size_t slab_objects, slab_bytes;/*objects in use in the slabs, and their size*/
+    size_t quick_blocks, quick_bytes;/*blocks held in the quick cache, and their size*/
+    size_t quarantine_blocks, quarantine_bytes;/*freed blocks and slab objects held in the quarantines (MM_HARDENED)*/
+    double fragmentation;           /*1 - largest_free/free_bytes*/
+} mm_stats_t;
+
+extern mm_stats_t mm_stats(void);
+
+/*
+ * Students work in teams of one or two.  Teams enter their team name,
+ * personal names and github usernames in a struct of this type in their mm.c file.
+ */
+typedef struct {
+    char *teamname; /* Team name */
+    char *name1;    /* First member's full name */
+    char *id1;      /* First member's github username */
+    char *name2;    /* Second member's full name (if any) */
+    char *id2;      /* Second member's github username */
+} team_t;
+
+extern team_t team;
+
+/*Every payload returned by mm_malloc is aligned to ALIGNMENT bytes*/
+#define ALIGNMENT 16
+
+/*Round size up to the nearest multiple of ALIGNMENT*/
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(size_t)(ALIGNMENT-1))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
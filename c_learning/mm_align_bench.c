@@ -0,0 +1,151 @@
+/*
+ * mm_align_bench - aligned buffers from mm_memalign against over-allocating and rounding the pointer up
+ *
+ * A pool of slots is churned by random operations: an empty slot gets a buffer of a random size, aligned to
+ * the cache line (64 bytes, sizes of 32 bytes to 2 KiB) or to the page (4096 bytes, sizes of 1 to 64 KiB),
+ * whose first and last cache lines are written; a full one is freed. Each run starts from an empty heap with
+ * the same operations:
+ *     round            mm_malloc of the size plus the alignment, the pointer rounded up and the address of the
+ *                      block kept in front of it for mm_free (what callers had to do without mm_memalign)
+ *     memalign         mm_memalign and mm_free
+ * For each: the time per operation, the heap at the end, the utilization (the bytes asked for by the live
+ * buffers over the heap) and the buffers that were not aligned.
+ *
+ * usage: mm_align_bench [slots] [operations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define CACHE_LINE 64
+#define NUM_METHODS 2
+
+static const char *method_names[NUM_METHODS]={"round", "memalign"};
+
+static unsigned long rng_state=88172645463325252UL;
+
+static unsigned long rng_next(void){
+    rng_state^=rng_state>>12;
+    rng_state^=rng_state<<25;
+    rng_state^=rng_state>>27;
+    return rng_state*2685821657736338717UL;
+}
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+/*allocate size bytes aligned to alignment by the given method, NULL if the heap is exhausted*/
+static void *align_alloc(int method, size_t alignment, size_t size){
+    void *block, *ptr;
+
+    if(method>0){
+        return mm_memalign(alignment, size);
+    }
+    block=mm_malloc(size+alignment+sizeof(void *));
+    if(block==NULL){
+        return NULL;
+    }
+    ptr=(void *)(((uintptr_t)block+sizeof(void *)+alignment-1) & ~(uintptr_t)(alignment-1));
+    ((void **)ptr)[-1]=block;
+    return ptr;
+}
+
+static void align_free(int method, void *ptr){
+    if(method==0){
+        mm_free(((void **)ptr)[-1]);
+    }else{
+        mm_free(ptr);
+    }
+}
+
+/*run the operations on the slots with the given method and print a line of results; return 0, -1 if the heap is exhausted*/
+static int run(int method, size_t alignment, size_t min_size, size_t max_size, long slots, long ops,
+               void **ptrs, size_t *sizes){
+    long i, slot, misaligned=0;
+    size_t live=0, heap, touch;
+    double start, secs;
+
+    mem_reset_brk();
+    if(mm_init()<0){
+        return -1;
+    }
+    memset(ptrs, 0, slots*sizeof(void *));
+    rng_state=88172645463325252UL;
+    start=now();
+    for(i=0;i<ops;i++){
+        slot=rng_next()%slots;
+        if(ptrs[slot]!=NULL){
+            align_free(method, ptrs[slot]);
+            live-=sizes[slot];
+            ptrs[slot]=NULL;
+            continue;
+        }
+        sizes[slot]=min_size+rng_next()%(max_size-min_size+1);
+        ptrs[slot]=align_alloc(method, alignment, sizes[slot]);
+        if(ptrs[slot]==NULL){
+            return -1;
+        }
+        misaligned+=((uintptr_t)ptrs[slot] & (alignment-1))!=0;
+        touch=sizes[slot]<CACHE_LINE ? sizes[slot] : CACHE_LINE;
+        memset(ptrs[slot], (int)i, touch);
+        memset((char *)ptrs[slot]+sizes[slot]-touch, (int)i, touch);
+        live+=sizes[slot];
+    }
+    secs=now()-start;
+    heap=mm_footprint();
+    printf("%-16s %10.1f %12.2f %11.1f%% %11ld\n", method_names[method], secs*1e9/ops, heap/1e6,
+           heap>0 ? 100.0*live/heap : 0.0, misaligned);
+    return 0;
+}
+
+int main(int argc, char **argv){
+    static const struct {
+        size_t alignment, min_size, max_size;
+    } workloads[]={
+        {CACHE_LINE, 32, 2048},
+        {4096, 1024, 64*1024},
+    };
+    long slots, ops;
+    void **ptrs;
+    size_t *sizes, w;
+    int method;
+
+    slots=argc>1 ? atol(argv[1]) : 20000;
+    ops=argc>2 ? atol(argv[2]) : 2000000;
+    if(slots<1 || ops<1){
+        fprintf(stderr, "usage: mm_align_bench [slots] [operations]\n");
+        return 2;
+    }
+    ptrs=malloc(slots*sizeof(void *));
+    sizes=malloc(slots*sizeof(size_t));
+    if(ptrs==NULL || sizes==NULL){
+        fprintf(stderr, "mm_align_bench: out of memory\n");
+        return 1;
+    }
+    mem_init();
+    for(w=0;w<sizeof(workloads)/sizeof(workloads[0]);w++){
+        printf("%salignment %zu, %zu to %zu bytes, %ld slots, %ld operations\n", w>0 ? "\n" : "",
+               workloads[w].alignment, workloads[w].min_size, workloads[w].max_size, slots, ops);
+        printf("%-16s %10s %12s %12s %11s\n", "method", "ns/op", "heap (MB)", "utilization", "misaligned");
+        for(method=0;method<NUM_METHODS;method++){
+            if(run(method, workloads[w].alignment, workloads[w].min_size, workloads[w].max_size, slots, ops,
+                   ptrs, sizes)<0){
+                fprintf(stderr, "mm_align_bench: heap exhausted\n");
+                return 1;
+            }
+        }
+    }
+    mem_deinit();
+    free(ptrs);
+    free(sizes);
+    return 0;
+}
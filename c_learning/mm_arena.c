@@ -0,0 +1,174 @@
+/*
+ * Arenas
+ *
+ * Objects that all die at the same time (everything a request handler allocates, say) do not
+ * need to be freed one by one: an arena takes chunks of chunk_size bytes from mm_malloc and hands
+ * out their space by bumping a pointer, and arena_reset gives all of it back at once.
+ *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- chunk (returned by mm_malloc)
+ * |  Address of the next chunk of the arena                       |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Address of the end of the chunk                              |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- first object
+ * .                                                               .
+ * .  Objects handed out so far                                    .
+ * .                                                               .
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- cur
+ * .                                                               .
+ * .  Free space                                                   .
+ * .                                                               .
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- end
+ *
+ * Only the chunk at the head of the list is bumped into. A request that does not fit in what is
+ * left of it starts a new chunk; a request larger than a quarter of chunk_size gets a chunk of its
+ * own, linked behind the head so that the space left in the head is not lost.
+ * arena_reset frees every chunk but one of the usual size, which the arena starts over with, and
+ * arena_destroy frees them all. Every object is aligned to ALIGNMENT bytes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+#include "mm_arena.h"
+
+#define CHUNK_HEADER 16
+
+/*Given the address c of a chunk, read its link and its end, and compute the address of its first object*/
+#define CHUNK_NEXT(c) (*(void **)(c))
+#define CHUNK_END(c) (*(char **)((char *)(c)+8))
+#define CHUNK_FIRST(c) ((char *)(c)+CHUNK_HEADER)
+
+struct arena {
+    void *chunks;           /*every chunk of the arena, the one bumped into first*/
+    char *cur, *end;        /*free space of the chunk at the head*/
+    size_t chunk_size;
+    size_t num_chunks;
+    size_t used;            /*bytes handed out since the last reset*/
+};
+
+/*
+ * arena_create - create an empty arena growing by chunks of chunk_size bytes (ARENA_DEFAULT_CHUNK if 0).
+ * Return NULL if the heap is exhausted.
+ */
+arena_t *arena_create(size_t chunk_size){
+    arena_t *arena;
+
+    if(chunk_size==0){
+        chunk_size=ARENA_DEFAULT_CHUNK;
+    }
+    if(chunk_size<4*CHUNK_HEADER){
+        chunk_size=4*CHUNK_HEADER;
+    }
+    arena=mm_malloc(sizeof(arena_t));
+    if(arena==NULL){
+        return NULL;
+    }
+    memset(arena, 0, sizeof(arena_t));
+    arena->chunk_size=ALIGN(chunk_size);
+    return arena;
+}
+
+/*
+ * arena_grow - serve a request of size bytes (already aligned) that does not fit in the head chunk.
+ */
+static void *arena_grow(arena_t *arena, size_t size){
+    void *chunk;
+    size_t chunk_size;
+
+    chunk_size=arena->chunk_size;
+    if(size>(chunk_size-CHUNK_HEADER)/4){
+        chunk_size=CHUNK_HEADER+size;
+    }
+    chunk=mm_malloc(chunk_size);
+    if(chunk==NULL){
+        return NULL;
+    }
+    CHUNK_END(chunk)=(char *)chunk+chunk_size;
+    arena->num_chunks++;
+    arena->used+=size;
+    if(chunk_size!=arena->chunk_size && arena->chunks!=NULL){
+        /*a chunk of its own: keep bumping into the head*/
+        CHUNK_NEXT(chunk)=CHUNK_NEXT(arena->chunks);
+        CHUNK_NEXT(arena->chunks)=chunk;
+        return CHUNK_FIRST(chunk);
+    }
+    CHUNK_NEXT(chunk)=arena->chunks;
+    arena->chunks=chunk;
+    arena->cur=CHUNK_FIRST(chunk)+size;
+    arena->end=CHUNK_END(chunk);
+    return CHUNK_FIRST(chunk);
+}
+
+/*
+ * arena_alloc - allocate size bytes from the arena. Return NULL if the heap is exhausted.
+ */
+void *arena_alloc(arena_t *arena, size_t size){
+    void *p;
+
+    size=size==0 ? ALIGNMENT : ALIGN(size);
+    if(size>(size_t)(arena->end-arena->cur)){
+        return arena_grow(arena, size);
+    }
+    p=arena->cur;
+    arena->cur+=size;
+    arena->used+=size;
+    return p;
+}
+
+/*
+ * arena_reset - release every object of the arena. One chunk of the usual size is kept for reuse,
+ * every other chunk goes back to the heap.
+ */
+void arena_reset(arena_t *arena){
+    void *chunk, *next, *keep=NULL;
+
+    for(chunk=arena->chunks;chunk!=NULL;chunk=next){
+        next=CHUNK_NEXT(chunk);
+        if(keep==NULL && (size_t)(CHUNK_END(chunk)-(char *)chunk)==arena->chunk_size){
+            keep=chunk;
+        }else{
+            mm_free(chunk);
+        }
+    }
+    arena->chunks=keep;
+    arena->num_chunks=0;
+    arena->cur=arena->end=NULL;
+    if(keep!=NULL){
+        CHUNK_NEXT(keep)=NULL;
+        arena->num_chunks=1;
+        arena->cur=CHUNK_FIRST(keep);
+        arena->end=CHUNK_END(keep);
+    }
+    arena->used=0;
+}
+
+/*
+ * arena_destroy - release every chunk of the arena and the arena itself.
+ */
+void arena_destroy(arena_t *arena){
+    void *chunk, *next;
+
+    if(arena==NULL){
+        return;
+    }
+    for(chunk=arena->chunks;chunk!=NULL;chunk=next){
+        next=CHUNK_NEXT(chunk);
+        mm_free(chunk);
+    }
+    mm_free(arena);
+}
+
+/*
+ * arena_used - return the number of bytes handed out since the arena was created or last reset.
+ */
+size_t arena_used(const arena_t *arena){
+    return arena->used;
+}
+
+/*
+ * arena_chunks - return the number of chunks the arena holds.
+ */
+size_t arena_chunks(const arena_t *arena){
+    return arena->num_chunks;
+}
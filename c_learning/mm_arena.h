@@ -0,0 +1,34 @@
+/*
+ * mm_arena.h - region allocator on top of the heap in mm.c
+ *
+ * An arena hands out memory by bumping a pointer through big chunks taken from mm_malloc.
+ * Nothing is freed one object at a time: arena_reset releases every object of the arena at
+ * once (in time proportional to the number of chunks) and arena_destroy releases the arena
+ * itself. See mm_arena.c for the details.
+ */
+#ifndef MM_ARENA_H
+#define MM_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct arena arena_t;
+
+/*Size of the chunks of an arena created with chunk_size 0*/
+#define ARENA_DEFAULT_CHUNK (64*1024)
+
+extern arena_t *arena_create(size_t chunk_size);
+extern void *arena_alloc(arena_t *arena, size_t size);
+extern void arena_reset(arena_t *arena);
+extern void arena_destroy(arena_t *arena);
+extern size_t arena_used(const arena_t *arena);
+extern size_t arena_chunks(const arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
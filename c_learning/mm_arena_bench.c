@@ -0,0 +1,134 @@
+/*
+ * mm_arena_bench - per-request cost of an arena (mm_arena.c) against plain mm_malloc/mm_free
+ *
+ * Every request allocates a burst of objects of random sizes, touches them, and drops all of
+ * them at the end. The same requests are run three ways:
+ *     malloc       mm_malloc for every object, mm_free for every object at the end
+ *     arena        arena_alloc for every object, one arena_reset at the end
+ *     malloc/heap  like malloc, but with the slabs turned off (MM_OPT_SLAB_MAX 0), so that every
+ *                  object goes through the tree or the segregated lists and is coalesced when freed
+ *
+ * usage: mm_arena_bench [requests] [max_objects_per_request] [max_size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_arena.h"
+
+enum mode { MODE_MALLOC, MODE_ARENA, MODE_HEAP };
+
+static long num_requests;
+static int *counts;         /*objects of every request*/
+static size_t *sizes;       /*sizes of all objects, request after request*/
+static void **objs;
+
+static unsigned long rng_state=88172645463325252UL;
+
+static unsigned long rng_next(void){
+    rng_state^=rng_state>>12;
+    rng_state^=rng_state<<25;
+    rng_state^=rng_state>>27;
+    return rng_state*2685821657736338717UL;
+}
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+/*run every request, return the elapsed time and the peak footprint of the heap*/
+static double run(enum mode mode, size_t *peak){
+    arena_t *arena=NULL;
+    size_t *size=sizes;
+    double start;
+    long r;
+    int i, n;
+
+    mem_reset_brk();
+    if(mode==MODE_HEAP){
+        mm_setopt(MM_OPT_SLAB_MAX, 0);
+    }
+    if(mm_init()<0){
+        fprintf(stderr, "mm_arena_bench: mm_init failed\n");
+        exit(1);
+    }
+    if(mode==MODE_ARENA){
+        arena=arena_create(0);
+    }
+    *peak=0;
+    start=now();
+    for(r=0;r<num_requests;r++){
+        n=counts[r];
+        for(i=0;i<n;i++){
+            objs[i]=mode==MODE_ARENA ? arena_alloc(arena, size[i]) : mm_malloc(size[i]);
+            if(objs[i]==NULL){
+                fprintf(stderr, "mm_arena_bench: out of memory\n");
+                exit(1);
+            }
+            *(char *)objs[i]=(char)i;
+        }
+        if(mm_footprint()>*peak){
+            *peak=mm_footprint();
+        }
+        if(mode==MODE_ARENA){
+            arena_reset(arena);
+        }else{
+            for(i=0;i<n;i++){
+                mm_free(objs[i]);
+            }
+        }
+        size+=n;
+    }
+    arena_destroy(arena);
+    return now()-start;
+}
+
+int main(int argc, char **argv){
+    static const char *names[]={"malloc", "arena", "malloc/heap"};
+    int max_objs;
+    size_t max_size, peak;
+    long r, total=0;
+    double secs;
+    enum mode mode;
+
+    num_requests=argc>1 ? atol(argv[1]) : 20000;
+    max_objs=argc>2 ? atoi(argv[2]) : 256;
+    max_size=argc>3 ? strtoul(argv[3], NULL, 0) : 512;
+    if(num_requests<1 || max_objs<1 || max_size<1){
+        fprintf(stderr, "usage: mm_arena_bench [requests] [max_objects_per_request] [max_size]\n");
+        return 2;
+    }
+    counts=malloc(num_requests*sizeof(int));
+    for(r=0;r<num_requests;r++){
+        counts[r]=1+rng_next()%max_objs;
+        total+=counts[r];
+    }
+    sizes=malloc(total*sizeof(size_t));
+    objs=malloc(max_objs*sizeof(void *));
+    if(counts==NULL || sizes==NULL || objs==NULL){
+        fprintf(stderr, "mm_arena_bench: out of memory\n");
+        return 1;
+    }
+    for(r=0;r<total;r++){
+        sizes[r]=1+rng_next()%max_size;
+    }
+
+    mem_init();
+    printf("%ld requests, %ld objects of 1 to %zu bytes\n", num_requests, total, max_size);
+    printf("%-12s %14s %14s %12s\n", "mode", "ns/request", "ns/object", "peak heap");
+    for(mode=MODE_MALLOC;mode<=MODE_HEAP;mode++){
+        run(mode, &peak);
+        secs=run(mode, &peak);
+        printf("%-12s %14.0f %14.1f %12zu\n", names[mode], secs*1e9/num_requests, secs*1e9/total, peak);
+    }
+    free(counts);
+    free(sizes);
+    free(objs);
+    return 0;
+}
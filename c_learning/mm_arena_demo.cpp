@@ -0,0 +1,58 @@
+/*
+ * mm_arena_demo - the containers of c++/vector_and_list.cpp and c++/set_test.cpp, allocated from an
+ * arena on the mm.c heap through mm_arena_resource
+ */
+#include<iostream>
+#include<list>
+#include<set>
+#include<vector>
+#include<memory_resource>
+
+#include "memlib.h"
+#include "mm_arena_resource.hpp"
+
+using namespace std;
+
+int main(){
+    mem_init();
+    if(mm_init()<0){
+	cerr<<"mm_init failed"<<endl;
+	return 1;
+    }
+    mm_arena_resource arena;
+
+    for(int request=0;request<2;request++){
+	{
+	    pmr::vector<int> v({1,2,3,4}, &arena);
+	    pmr::list<int> l({1,2,3,4}, &arena);
+	    for(auto t=v.begin(); t!=v.end(); t++){
+		cout<<&(*t)<<endl;
+	    }
+	    cout<<"#############"<<endl;
+	    for(auto it=l.begin(); it!=l.end(); it++){
+		cout<<&(*it)<<endl;
+	    }
+
+	    pmr::set<int> mp(&arena);
+	    mp.insert(30);
+	    mp.insert(171);
+	    mp.insert(111);
+	    mp.insert(2);
+	    mp.insert(5);
+	    cout<<"Elements are: \n";
+	    for(auto it=mp.begin();it!=mp.end();it++){
+		cout<<(*it)<<endl;
+	    }
+	    auto it=mp.lower_bound(31);
+	    cout<<"The lowerbound of key 31 is ";
+	    cout<<(*it)<<endl;
+	    cout<<arena_used(arena.get())<<" bytes in "<<arena_chunks(arena.get())<<" chunk(s)"<<endl;
+	}
+	/*the containers are gone: everything they allocated is given back at once,
+	 *and the next request gets the same addresses again*/
+	arena.release();
+	cout<<"=== reset ==="<<endl;
+    }
+    mm_checkheap(0);
+    return 0;
+}
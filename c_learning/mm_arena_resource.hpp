@@ -0,0 +1,77 @@
+/*
+ * mm_arena_resource.hpp - std::pmr::memory_resource backed by an arena (mm_arena.h)
+ *
+ * Lets the standard containers allocate from the mm.c heap through an arena:
+ *
+ *     mm_arena_resource arena;
+ *     std::pmr::set<int> s(&arena);
+ *     std::pmr::list<int> l(&arena);
+ *
+ * Deallocation is a no-op; the memory of every container using the resource comes back at once
+ * with release() (once the containers are gone) or when the resource is destroyed. Alignments
+ * above ALIGNMENT are served by over-allocating.
+ */
+#ifndef MM_ARENA_RESOURCE_HPP
+#define MM_ARENA_RESOURCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+#include "mm.h"
+#include "mm_arena.h"
+
+class mm_arena_resource : public std::pmr::memory_resource {
+public:
+    explicit mm_arena_resource(std::size_t chunk_size=0) : arena(arena_create(chunk_size)){
+        if(arena==nullptr){
+            throw std::bad_alloc();
+        }
+    }
+
+    ~mm_arena_resource(){
+        arena_destroy(arena);
+    }
+
+    mm_arena_resource(const mm_arena_resource&)=delete;
+    mm_arena_resource& operator=(const mm_arena_resource&)=delete;
+
+    /*give back everything allocated so far (no container may still use it)*/
+    void release(){
+        arena_reset(arena);
+    }
+
+    arena_t *get() const {
+        return arena;
+    }
+
+private:
+    arena_t *arena;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void *p;
+
+        if(alignment<=ALIGNMENT){
+            p=arena_alloc(arena, bytes);
+        }else{
+            p=arena_alloc(arena, bytes+alignment-ALIGNMENT);
+            if(p!=nullptr){
+                p=reinterpret_cast<void*>((reinterpret_cast<std::uintptr_t>(p)+alignment-1) & ~(std::uintptr_t)(alignment-1));
+            }
+        }
+        if(p==nullptr){
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this==&other;
+    }
+};
+
+#endif
@@ -0,0 +1,1085 @@
+/*
+ * mm_bench - trace-driven benchmark and regression gate for the allocator in mm.c
+ *
+ * A trace is a sequence of allocator requests on numbered blocks. In a trace file, one request
+ * per line:
+ *
+ *     a <id> <size>      p[id]=mm_malloc(size)
+ *     f <id>             mm_free(p[id])
+ *     r <id> <size>      p[id]=mm_realloc(p[id], size)
+ *     b <id> <n> <size>  mm_malloc_batch(size, n, &p[id]), i.e. ids id to id+n-1
+ *     B <id> <n>         mm_free_batch(&p[id], n)
+ *
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * Every trace is run three times on a fresh heap:
+ *  1. a checked run: every payload is filled with a pattern that is verified when the block is
+ *     freed or reallocated, payloads must be aligned and inside the heap, and the peak heap size
+ *     (including huge blocks and slabs mapped outside it, see mm_footprint) is compared with the
+ *     peak number of live payload bytes (utilization); the heap size left at the end of the trace
+ *     shows how much memory was given back, and the number of mm_realloc calls that had to move
+ *     the data is counted;
+ *  2. a throughput run without any instrumentation (best of -n repetitions);
+ *  3. a latency run timing every request (a batch request as a whole), reported as percentiles.
+ * The ops column and the throughput count every id of a batch request as one request.
+ *
+ * Without -f, the built-in synthetic traces are run:
+ *     bintree   build and tear down binary trees of small nodes
+ *     realloc   buffers grown step by step with mm_realloc, between small allocations
+ *     random    random sizes (log-uniform up to 64 KiB) with a random live set
+ *     phase     phases of small, large and mixed objects that leave holes behind each other
+ *     bigbuf    a few buffers grown with mm_realloc to tens of megabytes
+ *     frag      medium objects allocated, freed and shrunk a little at random (small leftovers)
+ *     burst     bursts of 16 to 64 same-size nodes allocated and freed together, one request per node
+ *     batch     the same bursts with one mm_malloc_batch/mm_free_batch request per burst
+ *
+ * With -P, every trace is run under every combination of placement and growth policy instead
+ * (checked and throughput runs), and the utilization and throughput are printed as two tables,
+ * one row per combination.
+ *
+ * usage: mm_bench [-f tracefile]... [-t trace]... [-w dir] [-n reps] [-s seed] [-o option=value]... [-c] [-v] [-S] [-P] [-T]
+ *     -f file   run a trace file (may be repeated)
+ *     -t name   run only the named synthetic trace (may be repeated)
+ *     -w dir    write the synthetic traces to dir/<name>.rep and exit
+ *     -n reps   repetitions of the throughput run (default 3)
+ *     -s seed   seed for the synthetic traces (default 1)
+ *     -o opt=v  set an allocator option with mm_setopt before running (may be repeated):
+ *               trim (MM_OPT_TRIM_THRESHOLD), mmap (MM_OPT_MMAP_THRESHOLD), slab (MM_OPT_SLAB_MAX),
+ *               place (MM_OPT_PLACEMENT: best, best_addr, first or next),
+ *               grow (MM_OPT_GROWTH: exact, chunk, geometric or huge), quick (MM_OPT_QUICK_MAX),
+ *               prof (MM_OPT_PROF_RATE, needs mm.c built with MM_PROFILE, see mm_bench_prof),
+ *               numa (MM_OPT_NUMA)
+ *     -c        run mm_checkheap after every request of the checked run (slow)
+ *     -v        print mm_checkheap output and per-trace details
+ *     -S        print the mm_stats snapshot after the checked run of each trace
+ *               (event counters need mm.c built with MM_STATS, see mm_bench_stats)
+ *     -P        compare the placement and growth policies
+ *     -T        also count the dTLB load misses and page faults of the best throughput run (with
+ *               perf_event_open; n/a where the system does not provide the counter)
+ *
+ * The exit status is non-zero if any trace fails the checked run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define MAX_TRACES 64
+
+/*A request of a trace*/
+struct op {
+    char type;      /*'a', 'f', 'r', 'b' or 'B'*/
+    int id;
+    int count;      /*number of ids of a 'b' or 'B' request (1 for the others)*/
+    size_t size;
+};
+
+struct trace {
+    char name[256];
+    struct op *ops;
+    int num_ops, cap_ops;
+    int num_objs;   /*requests counting every id of a batch request*/
+    int num_ids;
+};
+
+/*Results of the three runs of a trace*/
+struct result {
+    int valid;
+    size_t peak_heap, peak_live, end_heap;
+    size_t reallocs, copies;
+    double secs;
+    long long tlb_misses, faults;  /*of the best throughput run, -1 if not counted*/
+    double p50, p90, p99, p999, max;
+};
+
+static int check_every_op;
+static int verbose;
+static int print_stats;
+static int count_events;
+static unsigned long rng_state;
+
+/*seed of the synthetic trace being generated*/
+static unsigned long gen_seed;
+
+/*
+ * xorshift64* - the synthetic traces must be identical on every machine, so do not use rand().
+ */
+static unsigned long rng_next(void){
+    rng_state^=rng_state>>12;
+    rng_state^=rng_state<<25;
+    rng_state^=rng_state>>27;
+    return rng_state*2685821657736338717UL;
+}
+
+static unsigned long rng_range(unsigned long lo, unsigned long hi){
+    return lo+rng_next()%(hi-lo+1);
+}
+
+/*log-uniform size in [lo, hi]*/
+static size_t rng_logsize(size_t lo, size_t hi){
+    int bits=64-__builtin_clzl(hi);
+    size_t size;
+
+    do{
+        size=rng_next()>>(64-rng_range(1, bits));
+    }while(size<lo || size>hi);
+    return size;
+}
+
+static void *xrealloc(void *p, size_t size){
+    p=realloc(p, size);
+    if(p==NULL){
+        fprintf(stderr, "mm_bench: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void trace_add_batch(struct trace *t, char type, int id, int count, size_t size){
+    if(t->num_ops==t->cap_ops){
+        t->cap_ops=t->cap_ops ? 2*t->cap_ops : 1024;
+        t->ops=xrealloc(t->ops, t->cap_ops*sizeof(struct op));
+    }
+    t->ops[t->num_ops].type=type;
+    t->ops[t->num_ops].id=id;
+    t->ops[t->num_ops].count=count;
+    t->ops[t->num_ops].size=size;
+    t->num_ops++;
+    t->num_objs+=count;
+    if(id+count>t->num_ids){
+        t->num_ids=id+count;
+    }
+}
+
+static void trace_add(struct trace *t, char type, int id, size_t size){
+    trace_add_batch(t, type, id, 1, size);
+}
+
+/*
+ * The synthetic traces. Each one frees everything it allocated before it ends.
+ */
+
+/*allocate a subtree of the given depth in depth-first order, return the next free id*/
+static int gen_subtree(struct trace *t, int id, int depth){
+    trace_add(t, 'a', id++, depth%2 ? 32 : 48);
+    if(depth>0){
+        id=gen_subtree(t, id, depth-1);
+        id=gen_subtree(t, id, depth-1);
+    }
+    return id;
+}
+
+/*free the ids [first, last) in a random order*/
+static void gen_teardown(struct trace *t, int first, int last){
+    int n=last-first, i, j, tmp, *order;
+
+    order=xrealloc(NULL, n*sizeof(int));
+    for(i=0;i<n;i++){
+        order[i]=first+i;
+    }
+    for(i=n-1;i>0;i--){
+        j=(int)rng_range(0, i);
+        tmp=order[i];
+        order[i]=order[j];
+        order[j]=tmp;
+    }
+    for(i=0;i<n;i++){
+        trace_add(t, 'f', order[i], 0);
+    }
+    free(order);
+}
+
+static void gen_bintree(struct trace *t){
+    int round, first, last, prev_first=0, prev_last=0;
+
+    for(round=0;round<40;round++){
+        /*two trees are live at a time, so the newer one is built around the holes of the older one*/
+        first=(round%2)*(1<<13);
+        last=gen_subtree(t, first, (int)rng_range(8, 11));
+        gen_teardown(t, prev_first, prev_last);
+        prev_first=first;
+        prev_last=last;
+    }
+    gen_teardown(t, prev_first, prev_last);
+}
+
+static void gen_realloc(struct trace *t){
+    int buf, step, small[512], num_small=0, next_id=8, k;
+    size_t size[8];
+
+    for(buf=0;buf<8;buf++){
+        size[buf]=rng_range(16, 256);
+        trace_add(t, 'a', buf, size[buf]);
+    }
+    for(step=0;step<20000;step++){
+        buf=(int)rng_range(0, 7);
+        size[buf]+=rng_range(16, 512);
+        /*every now and then a buffer is emptied and started over*/
+        if(size[buf]>(1<<17)){
+            size[buf]=64;
+        }
+        trace_add(t, 'r', buf, size[buf]);
+        /*small allocations in between keep the buffers from always growing in place*/
+        if(step%3==0){
+            if(num_small==512 || (num_small>0 && rng_range(0, 1))){
+                k=(int)rng_range(0, num_small-1);
+                trace_add(t, 'f', small[k], 0);
+                small[k]=small[--num_small];
+            }
+            small[num_small++]=next_id;
+            trace_add(t, 'a', next_id++, rng_range(16, 128));
+        }
+    }
+    for(buf=0;buf<8;buf++){
+        trace_add(t, 'f', buf, 0);
+    }
+    while(num_small>0){
+        trace_add(t, 'f', small[--num_small], 0);
+    }
+}
+
+static void gen_random(struct trace *t){
+    int live[4096], num_live=0, next_id=0, i, k;
+
+    for(i=0;i<100000;i++){
+        if(num_live<64 || (num_live<4096 && rng_range(0, 99)<52)){
+            live[num_live++]=next_id;
+            trace_add(t, 'a', next_id++, rng_logsize(1, 1<<16));
+        }else if(rng_range(0, 9)==0){
+            k=(int)rng_range(0, num_live-1);
+            trace_add(t, 'r', live[k], rng_logsize(1, 1<<16));
+        }else{
+            k=(int)rng_range(0, num_live-1);
+            trace_add(t, 'f', live[k], 0);
+            live[k]=live[--num_live];
+        }
+    }
+    while(num_live>0){
+        trace_add(t, 'f', live[--num_live], 0);
+    }
+}
+
+static void gen_phase(struct trace *t){
+    int phase, i, first=0, n;
+    size_t lo[]={16, 1024, 64, 8192, 16}, hi[]={128, 4096, 1024, 32768, 64};
+
+    for(phase=0;phase<5;phase++){
+        n=phase%2 ? 2000 : 20000;
+        for(i=0;i<n;i++){
+            trace_add(t, 'a', first+i, rng_range(lo[phase], hi[phase]));
+        }
+        /*each phase leaves one object out of eight alive, pinning holes for the next phase*/
+        for(i=0;i<n;i++){
+            if(i%8){
+                trace_add(t, 'f', first+i, 0);
+            }
+        }
+        first+=n;
+    }
+    for(i=0;i<first;i+=8){
+        trace_add(t, 'f', i, 0);
+    }
+}
+
+static void gen_bigbuf(struct trace *t){
+    int buf, step, small=4;
+    size_t size[4];
+
+    for(buf=0;buf<4;buf++){
+        size[buf]=rng_range(4096, 65536);
+        trace_add(t, 'a', buf, size[buf]);
+    }
+    for(step=0;step<400;step++){
+        buf=(int)rng_range(0, 3);
+        size[buf]+=rng_range(64*1024, 512*1024);
+        trace_add(t, 'r', buf, size[buf]);
+        /*a small allocation right behind the buffer keeps it from growing in place*/
+        trace_add(t, 'a', small, rng_range(16, 4096));
+        if(small>4){
+            trace_add(t, 'f', small-1, 0);
+        }
+        small++;
+    }
+    trace_add(t, 'f', small-1, 0);
+    for(buf=0;buf<4;buf++){
+        trace_add(t, 'f', buf, 0);
+    }
+}
+
+/*
+ * Medium objects that are allocated, freed and shrunk by a few bytes at random: every best-fit
+ * allocation and every shrink is liable to leave a remainder smaller than a block can be.
+ */
+static void gen_frag(struct trace *t){
+    int live[2048], num_live=0, next_id=0, i, k;
+    size_t sizes[2048];
+
+    for(i=0;i<100000;i++){
+        if(num_live<256 || (num_live<2048 && rng_range(0, 99)<50)){
+            live[num_live]=next_id;
+            sizes[num_live]=rng_range(300, 2000);
+            trace_add(t, 'a', next_id++, sizes[num_live++]);
+        }else if(rng_range(0, 2)==0){
+            k=(int)rng_range(0, num_live-1);
+            if(sizes[k]>300){
+                sizes[k]-=rng_range(8, 40);
+            }
+            trace_add(t, 'r', live[k], sizes[k]);
+        }else{
+            k=(int)rng_range(0, num_live-1);
+            trace_add(t, 'f', live[k], 0);
+            num_live--;
+            live[k]=live[num_live];
+            sizes[k]=sizes[num_live];
+        }
+    }
+    while(num_live>0){
+        trace_add(t, 'f', live[--num_live], 0);
+    }
+}
+
+/*
+ * Bursts of same-size nodes that are allocated together and freed together, like a parser building
+ * and dropping the tree of a request: "batch" uses the batch requests, "burst" the same requests one by one.
+ */
+static void gen_bursts(struct trace *t, int batched){
+    int first[64], count[64], num_live=0, next_id=0, i, j, k;
+    size_t size;
+
+    /*both variants must see the same bursts*/
+    rng_state=gen_seed*0x9E3779B97F4A7C15UL+0xb;
+
+    for(i=0;i<5000;i++){
+        if(num_live==64 || (num_live>8 && rng_range(0, 1))){
+            k=(int)rng_range(0, num_live-1);
+            if(batched){
+                trace_add_batch(t, 'B', first[k], count[k], 0);
+            }else{
+                for(j=0;j<count[k];j++){
+                    trace_add(t, 'f', first[k]+j, 0);
+                }
+            }
+            num_live--;
+            first[k]=first[num_live];
+            count[k]=count[num_live];
+        }else{
+            first[num_live]=next_id;
+            count[num_live]=(int)rng_range(16, 64);
+            size=rng_range(264, 1024);
+            if(batched){
+                trace_add_batch(t, 'b', next_id, count[num_live], size);
+            }else{
+                for(j=0;j<count[num_live];j++){
+                    trace_add(t, 'a', next_id+j, size);
+                }
+            }
+            next_id+=count[num_live++];
+        }
+    }
+    while(num_live>0){
+        num_live--;
+        if(batched){
+            trace_add_batch(t, 'B', first[num_live], count[num_live], 0);
+        }else{
+            for(j=0;j<count[num_live];j++){
+                trace_add(t, 'f', first[num_live]+j, 0);
+            }
+        }
+    }
+}
+
+static void gen_batch(struct trace *t){
+    gen_bursts(t, 1);
+}
+
+static void gen_burst(struct trace *t){
+    gen_bursts(t, 0);
+}
+
+static const struct {
+    const char *name;
+    void (*gen)(struct trace *);
+} generators[]={
+    {"bintree", gen_bintree},
+    {"realloc", gen_realloc},
+    {"random", gen_random},
+    {"phase", gen_phase},
+    {"bigbuf", gen_bigbuf},
+    {"frag", gen_frag},
+    {"burst", gen_burst},
+    {"batch", gen_batch},
+};
+
+#define NUM_GENERATORS ((int)(sizeof(generators)/sizeof(generators[0])))
+
+static struct trace *trace_generate(int g, unsigned long seed){
+    struct trace *t=xrealloc(NULL, sizeof(struct trace));
+
+    memset(t, 0, sizeof(struct trace));
+    snprintf(t->name, sizeof(t->name), "%s", generators[g].name);
+    gen_seed=seed;
+    rng_state=seed*0x9E3779B97F4A7C15UL+g+1;
+    generators[g].gen(t);
+    return t;
+}
+
+static struct trace *trace_read(const char *path){
+    struct trace *t;
+    FILE *fp;
+    char line[256], type;
+    int id, n, count, bad;
+    size_t size;
+
+    fp=fopen(path, "r");
+    if(fp==NULL){
+        fprintf(stderr, "mm_bench: cannot open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    t=xrealloc(NULL, sizeof(struct trace));
+    memset(t, 0, sizeof(struct trace));
+    snprintf(t->name, sizeof(t->name), "%s", path);
+    while(fgets(line, sizeof(line), fp)!=NULL){
+        if(line[0]=='#' || line[0]=='\n'){
+            continue;
+        }
+        size=0;
+        count=1;
+        type=0;
+        sscanf(line, " %c", &type);
+        if(type=='b' || type=='B'){
+            n=sscanf(line, " %c %d %d %zu", &type, &id, &count, &size);
+            bad=n<3 || count<1 || (type=='b' && n<4);
+        }else{
+            n=sscanf(line, " %c %d %zu", &type, &id, &size);
+            bad=n<2 || (type!='a' && type!='f' && type!='r') || (type!='f' && n<3);
+        }
+        if(bad || id<0){
+            fprintf(stderr, "mm_bench: %s: bad request: %s", path, line);
+            exit(1);
+        }
+        trace_add_batch(t, type, id, count, size);
+    }
+    fclose(fp);
+    return t;
+}
+
+static void trace_write(const struct trace *t, const char *dir){
+    char path[512];
+    FILE *fp;
+    int i;
+
+    snprintf(path, sizeof(path), "%s/%s.rep", dir, t->name);
+    fp=fopen(path, "w");
+    if(fp==NULL){
+        fprintf(stderr, "mm_bench: cannot create %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    fprintf(fp, "# %s: %d requests on %d ids\n", t->name, t->num_ops, t->num_ids);
+    for(i=0;i<t->num_ops;i++){
+        if(t->ops[i].type=='f'){
+            fprintf(fp, "f %d\n", t->ops[i].id);
+        }else if(t->ops[i].type=='b'){
+            fprintf(fp, "b %d %d %zu\n", t->ops[i].id, t->ops[i].count, t->ops[i].size);
+        }else if(t->ops[i].type=='B'){
+            fprintf(fp, "B %d %d\n", t->ops[i].id, t->ops[i].count);
+        }else{
+            fprintf(fp, "%c %d %zu\n", t->ops[i].type, t->ops[i].id, t->ops[i].size);
+        }
+    }
+    fclose(fp);
+}
+
+static void trace_free(struct trace *t){
+    free(t->ops);
+    free(t);
+}
+
+/*
+ * The three runs.
+ */
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static int fresh_heap(void){
+    mem_reset_brk();
+    if(mm_init()<0){
+        fprintf(stderr, "mm_bench: mm_init failed\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int payload_ok(const struct trace *t, int i, unsigned char *p, size_t size){
+    if(p==NULL && size>0){
+        printf("%s: request %d: %c %d %zu returned NULL\n", t->name, i, t->ops[i].type, t->ops[i].id, size);
+        return 0;
+    }
+    if(((uintptr_t)p)%ALIGNMENT){
+        printf("%s: request %d: payload %p is not aligned\n", t->name, i, (void *)p);
+        return 0;
+    }
+    /*huge blocks and slabs live in mappings of their own, outside the heap*/
+    if(size>0 && ((void *)p<mem_heap_lo() || (void *)(p+size-1)>mem_heap_hi()) && mm_footprint()-mem_heapsize()<size){
+        printf("%s: request %d: payload %p (%zu bytes) is outside the heap\n", t->name, i, (void *)p, size);
+        return 0;
+    }
+    return 1;
+}
+
+static int pattern_ok(const struct trace *t, int i, unsigned char *p, size_t size, int id){
+    size_t k;
+
+    for(k=0;k<size;k++){
+        if(p[k]!=(unsigned char)(id+k/8)){
+            printf("%s: request %d: payload of id %d was overwritten at byte %zu\n", t->name, i, id, k);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void pattern_fill(unsigned char *p, size_t from, size_t size, int id){
+    size_t k;
+
+    for(k=from;k<size;k++){
+        p[k]=(unsigned char)(id+k/8);
+    }
+}
+
+static void stats_print(const char *name, const mm_stats_t *st){
+    int i;
+
+    printf("%s: heap %zu (peak %zu), mapped %zu, released %zu, bound to a NUMA node %zu\n", name,
+           st->heap_size, st->peak_heap_size, st->mapped_bytes, st->released_bytes, st->numa_bound_bytes);
+    printf("%s: %zu free blocks, %zu free bytes, largest %zu, fragmentation %.3f, tree %zu nodes of height %zu\n", name,
+           st->free_blocks, st->free_bytes, st->largest_free, st->fragmentation, st->tree_nodes, st->tree_height);
+    printf("%s: %zu slabs, %zu objects in use (%zu bytes)\n", name, st->slab_pages, st->slab_objects, st->slab_bytes);
+    printf("%s: %zu blocks held in the quick cache (%zu bytes)\n", name, st->quick_blocks, st->quick_bytes);
+    if(!st->enabled){
+        return;
+    }
+    printf("%s: %10s %10s %10s %10s\n", name, "class", "malloc", "free", "realloc");
+    for(i=0;i<MM_STATS_CLASSES;i++){
+        if(st->mallocs[i] || st->frees[i] || st->reallocs[i]){
+            if(i==0){
+                printf("%s: %10s", name, "<16B");
+            }else{
+                printf("%s: %9zuB", name, (size_t)1<<(i+3));
+            }
+            printf(" %10zu %10zu %10zu\n", st->mallocs[i], st->frees[i], st->reallocs[i]);
+        }
+    }
+    printf("%s: tree_find %zu searches, %.2f nodes per search, deepest %zu\n", name,
+           st->finds, st->finds ? (double)st->find_nodes/st->finds : 0.0, st->find_max_depth);
+    printf("%s: %zu splits, %zu coalesces\n", name, st->splits, st->coalesces);
+    printf("%s: %zu quick cache hits, %zu consolidations\n", name, st->quick_hits, st->consolidations);
+    printf("%s: realloc shrink %zu, merge next %zu, extend %zu, merge prev %zu, last resort %zu, remap %zu\n", name,
+           st->realloc_shrink, st->realloc_merge_next, st->realloc_extend, st->realloc_merge_prev,
+           st->realloc_last_resort, st->realloc_remap);
+}
+
+static int run_checked(const struct trace *t, struct result *r){
+    mm_stats_t st;
+    void **ptrs=xrealloc(NULL, t->num_ids*sizeof(void *));
+    size_t *sizes=xrealloc(NULL, t->num_ids*sizeof(size_t));
+    size_t live=0, old;
+    const struct op *op;
+    int i, k;
+
+    memset(ptrs, 0, t->num_ids*sizeof(void *));
+    memset(sizes, 0, t->num_ids*sizeof(size_t));
+    r->peak_heap=r->peak_live=0;
+    r->reallocs=0;
+    r->valid=fresh_heap();
+    for(i=0;i<t->num_ops && r->valid;i++){
+        op=&t->ops[i];
+        switch(op->type){
+        case 'a':
+            ptrs[op->id]=mm_malloc(op->size);
+            sizes[op->id]=op->size;
+            r->valid=payload_ok(t, i, ptrs[op->id], op->size);
+            if(r->valid){
+                pattern_fill(ptrs[op->id], 0, op->size, op->id);
+            }
+            live+=op->size;
+            break;
+        case 'f':
+            r->valid=pattern_ok(t, i, ptrs[op->id], sizes[op->id], op->id);
+            mm_free(ptrs[op->id]);
+            live-=sizes[op->id];
+            ptrs[op->id]=NULL;
+            sizes[op->id]=0;
+            break;
+        case 'b':
+            if(mm_malloc_batch(op->size, op->count, &ptrs[op->id])<0){
+                printf("%s: request %d: b %d %d %zu failed\n", t->name, i, op->id, op->count, op->size);
+                r->valid=0;
+                break;
+            }
+            for(k=op->id;k<op->id+op->count && r->valid;k++){
+                sizes[k]=op->size;
+                r->valid=payload_ok(t, i, ptrs[k], op->size);
+                if(r->valid){
+                    pattern_fill(ptrs[k], 0, op->size, k);
+                }
+                live+=op->size;
+            }
+            break;
+        case 'B':
+            for(k=op->id;k<op->id+op->count && r->valid;k++){
+                r->valid=pattern_ok(t, i, ptrs[k], sizes[k], k);
+                live-=sizes[k];
+                sizes[k]=0;
+            }
+            mm_free_batch(&ptrs[op->id], op->count);
+            memset(&ptrs[op->id], 0, op->count*sizeof(void *));
+            break;
+        case 'r':
+            old=sizes[op->id];
+            r->valid=pattern_ok(t, i, ptrs[op->id], old, op->id);
+            ptrs[op->id]=mm_realloc(ptrs[op->id], op->size);
+            sizes[op->id]=op->size;
+            r->reallocs++;
+            if(r->valid){
+                r->valid=payload_ok(t, i, ptrs[op->id], op->size) &&
+                         pattern_ok(t, i, ptrs[op->id], old<op->size ? old : op->size, op->id);
+            }
+            if(r->valid){
+                pattern_fill(ptrs[op->id], old, op->size, op->id);
+            }
+            live+=op->size-old;
+            break;
+        }
+        if(live>r->peak_live){
+            r->peak_live=live;
+        }
+        if(mm_footprint()>r->peak_heap){
+            r->peak_heap=mm_footprint();
+        }
+        if(check_every_op){
+            mm_checkheap(0);
+        }
+    }
+    r->end_heap=mm_footprint();
+    r->copies=mm_realloc_copies();
+    if(print_stats){
+        st=mm_stats();
+        stats_print(t->name, &st);
+    }
+    if(verbose){
+        mm_checkheap(1);
+        printf("%s: %zu bytes released, %zu bytes left in the heap\n", t->name, mm_released_bytes(), r->end_heap);
+    }
+    free(ptrs);
+    free(sizes);
+    return r->valid;
+}
+
+/*counters of -T (dTLB load misses and page faults of this process, -1 where unavailable), and their counts in the last throughput run*/
+static int tlb_fd=-1, fault_fd=-1;
+static long long last_tlb_misses=-1, last_faults=-1;
+
+static int event_open(uint32_t type, uint64_t config){
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size=sizeof(attr);
+    attr.type=type;
+    attr.config=config;
+    attr.exclude_kernel=1;
+    attr.exclude_hv=1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long event_read(int fd){
+    long long count;
+
+    if(fd<0 || read(fd, &count, sizeof(count))!=sizeof(count)){
+        return -1;
+    }
+    return count;
+}
+
+static double run_throughput(const struct trace *t, void **ptrs){
+    const struct op *op;
+    double start, secs;
+    long long tlb, faults;
+    int i;
+
+    if(!fresh_heap()){
+        return 0;
+    }
+    tlb=event_read(tlb_fd);
+    faults=event_read(fault_fd);
+    start=now();
+    for(i=0;i<t->num_ops;i++){
+        op=&t->ops[i];
+        switch(op->type){
+        case 'a':
+            ptrs[op->id]=mm_malloc(op->size);
+            break;
+        case 'f':
+            mm_free(ptrs[op->id]);
+            break;
+        case 'r':
+            ptrs[op->id]=mm_realloc(ptrs[op->id], op->size);
+            break;
+        case 'b':
+            mm_malloc_batch(op->size, op->count, &ptrs[op->id]);
+            break;
+        case 'B':
+            mm_free_batch(&ptrs[op->id], op->count);
+            break;
+        }
+    }
+    secs=now()-start;
+    last_tlb_misses=tlb<0 ? -1 : event_read(tlb_fd)-tlb;
+    last_faults=faults<0 ? -1 : event_read(fault_fd)-faults;
+    return secs;
+}
+
+/*end a row of the table with the counts of -T*/
+static void event_print(long long tlb_misses, long long faults){
+    char tlb[32], flt[32];
+
+    snprintf(tlb, sizeof(tlb), tlb_misses<0 ? "n/a" : "%lld", tlb_misses);
+    snprintf(flt, sizeof(flt), faults<0 ? "n/a" : "%lld", faults);
+    printf(" %12s %9s\n", tlb, flt);
+}
+
+static int cmp_double(const void *a, const void *b){
+    double x=*(const double *)a, y=*(const double *)b;
+
+    return x<y ? -1 : x>y;
+}
+
+static void run_latency(const struct trace *t, void **ptrs, struct result *r){
+    double *lat=xrealloc(NULL, t->num_ops*sizeof(double));
+    struct timespec a, b;
+    const struct op *op;
+    int i, n=t->num_ops;
+
+    if(!fresh_heap()){
+        free(lat);
+        return;
+    }
+    for(i=0;i<n;i++){
+        op=&t->ops[i];
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        switch(op->type){
+        case 'a':
+            ptrs[op->id]=mm_malloc(op->size);
+            break;
+        case 'f':
+            mm_free(ptrs[op->id]);
+            break;
+        case 'r':
+            ptrs[op->id]=mm_realloc(ptrs[op->id], op->size);
+            break;
+        case 'b':
+            mm_malloc_batch(op->size, op->count, &ptrs[op->id]);
+            break;
+        case 'B':
+            mm_free_batch(&ptrs[op->id], op->count);
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        lat[i]=(b.tv_sec-a.tv_sec)*1e9+(b.tv_nsec-a.tv_nsec);
+    }
+    qsort(lat, n, sizeof(double), cmp_double);
+    r->p50=lat[n/2];
+    r->p90=lat[(int)(n*0.90)];
+    r->p99=lat[(int)(n*0.99)];
+    r->p999=lat[(int)(n*0.999)];
+    r->max=lat[n-1];
+    free(lat);
+}
+
+static int run_trace(const struct trace *t, int reps, struct result *r){
+    void **ptrs;
+    double secs;
+    int i;
+
+    memset(r, 0, sizeof(struct result));
+    if(t->num_ops==0){
+        r->valid=1;
+        return 1;
+    }
+    if(!run_checked(t, r)){
+        return 0;
+    }
+    ptrs=xrealloc(NULL, t->num_ids*sizeof(void *));
+    memset(ptrs, 0, t->num_ids*sizeof(void *));
+    for(i=0;i<reps;i++){
+        secs=run_throughput(t, ptrs);
+        if(i==0 || secs<r->secs){
+            r->secs=secs;
+            r->tlb_misses=last_tlb_misses;
+            r->faults=last_faults;
+        }
+    }
+    run_latency(t, ptrs, r);
+    free(ptrs);
+    return 1;
+}
+
+static void usage(void){
+    fprintf(stderr, "usage: mm_bench [-f tracefile]... [-t trace]... [-w dir] [-n reps] [-s seed] [-o option=value]... [-c] [-v] [-S] [-P] [-T]\n");
+    exit(2);
+}
+
+/*names of the values of MM_OPT_PLACEMENT and MM_OPT_GROWTH, in the order of their MM_PLACE_* and MM_GROW_* values*/
+static const char *const placement_names[]={"best", "best_addr", "first", "next", NULL};
+static const char *const growth_names[]={"exact", "chunk", "geometric", "huge", NULL};
+#define NUM_POLICIES 16 /*combinations of the two*/
+
+static const struct {
+    const char *name;
+    int option;
+    const char *const *values;  /*names of the values, NULL for a number*/
+} options[]={
+    {"trim", MM_OPT_TRIM_THRESHOLD, NULL},
+    {"mmap", MM_OPT_MMAP_THRESHOLD, NULL},
+    {"slab", MM_OPT_SLAB_MAX, NULL},
+    {"place", MM_OPT_PLACEMENT, placement_names},
+    {"grow", MM_OPT_GROWTH, growth_names},
+    {"quick", MM_OPT_QUICK_MAX, NULL},
+    {"prof", MM_OPT_PROF_RATE, NULL},
+    {"numa", MM_OPT_NUMA, NULL},
+};
+
+#define NUM_OPTIONS ((int)(sizeof(options)/sizeof(options[0])))
+
+/*set the allocator option given as name=value, exit on a bad one*/
+static void set_option(const char *arg){
+    const char *eq=strchr(arg, '=');
+    size_t value;
+    int o;
+
+    for(o=0;o<NUM_OPTIONS && eq!=NULL;o++){
+        if(strlen(options[o].name)==(size_t)(eq-arg) && !strncmp(options[o].name, arg, eq-arg)){
+            value=strtoul(eq+1, NULL, 0);
+            if(options[o].values!=NULL){
+                for(value=0;options[o].values[value]!=NULL && strcmp(options[o].values[value], eq+1);value++)
+                    ;
+            }
+            if(mm_setopt(options[o].option, value)<0){
+                fprintf(stderr, "mm_bench: bad value for option %s\n", options[o].name);
+                usage();
+            }
+            return;
+        }
+    }
+    fprintf(stderr, "mm_bench: unknown option %s\n", arg);
+    usage();
+}
+
+/*run every trace under every combination of placement and growth policy, print the utilization and throughput of each*/
+static int compare_policies(struct trace **traces, int num_traces, int reps){
+    int num_runs=0, failed=0, place, grow, i, k;
+    double util[NUM_POLICIES][MAX_TRACES+1], kops[NUM_POLICIES][MAX_TRACES+1], total_ops, total_secs;
+    char label[32];
+    struct result r;
+
+    for(place=0;placement_names[place]!=NULL;place++){
+        for(grow=0;growth_names[grow]!=NULL;grow++){
+            mm_setopt(MM_OPT_PLACEMENT, place);
+            mm_setopt(MM_OPT_GROWTH, grow);
+            util[num_runs][num_traces]=total_ops=total_secs=0;
+            for(i=0;i<num_traces;i++){
+                if(!run_trace(traces[i], reps, &r)){
+                    printf("%s/%s: %s failed\n", placement_names[place], growth_names[grow], traces[i]->name);
+                    failed++;
+                    util[num_runs][i]=kops[num_runs][i]=0;
+                    continue;
+                }
+                util[num_runs][i]=r.peak_heap ? 100.0*r.peak_live/r.peak_heap : 100.0;
+                kops[num_runs][i]=r.secs>0 ? traces[i]->num_objs/r.secs/1e3 : 0;
+                util[num_runs][num_traces]+=util[num_runs][i]/num_traces;
+                total_ops+=traces[i]->num_objs;
+                total_secs+=r.secs;
+            }
+            kops[num_runs][num_traces]=total_secs>0 ? total_ops/total_secs/1e3 : 0;
+            num_runs++;
+        }
+    }
+    for(k=0;k<2;k++){
+        printf("%s\n%-20s", k==0 ? "utilization (%)" : "throughput (Kops/s)", "placement/growth");
+        for(i=0;i<num_traces;i++){
+            printf(" %9s", traces[i]->name);
+        }
+        printf(" %9s\n", "total");
+        num_runs=0;
+        for(place=0;placement_names[place]!=NULL;place++){
+            for(grow=0;growth_names[grow]!=NULL;grow++){
+                snprintf(label, sizeof(label), "%s/%s", placement_names[place], growth_names[grow]);
+                printf("%-20s", label);
+                for(i=0;i<=num_traces;i++){
+                    printf(k==0 ? " %9.1f" : " %9.0f", k==0 ? util[num_runs][i] : kops[num_runs][i]);
+                }
+                printf("\n");
+                num_runs++;
+            }
+        }
+        printf("\n");
+    }
+    return failed;
+}
+
+int main(int argc, char **argv){
+    struct trace *traces[MAX_TRACES];
+    const char *files[MAX_TRACES];
+    int gens[MAX_TRACES], num_files=0, num_gens=0;
+    struct result r;
+    const char *write_dir=NULL;
+    char copies[32];
+    unsigned long seed=1;
+    int num_traces=0, reps=3, failed=0, compare=0, opt, g, i;
+    double total_ops=0, total_secs=0, util_sum=0;
+    long long total_tlb=0, total_faults=0;
+
+    while((opt=getopt(argc, argv, "f:t:w:n:s:o:cvSPT"))!=-1){
+        switch(opt){
+        case 'f':
+            if(num_files+num_gens==MAX_TRACES){
+                usage();
+            }
+            files[num_files++]=optarg;
+            break;
+        case 't':
+            for(g=0;g<NUM_GENERATORS && strcmp(generators[g].name, optarg);g++)
+                ;
+            if(g==NUM_GENERATORS){
+                fprintf(stderr, "mm_bench: no synthetic trace named %s\n", optarg);
+                usage();
+            }
+            if(num_files+num_gens==MAX_TRACES){
+                usage();
+            }
+            gens[num_gens++]=g;
+            break;
+        case 'w':
+            write_dir=optarg;
+            break;
+        case 'n':
+            reps=atoi(optarg);
+            break;
+        case 's':
+            seed=strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            set_option(optarg);
+            break;
+        case 'c':
+            check_every_op=1;
+            break;
+        case 'v':
+            verbose=1;
+            break;
+        case 'S':
+            print_stats=1;
+            break;
+        case 'P':
+            compare=1;
+            break;
+        case 'T':
+            count_events=1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if(reps<1 || optind<argc){
+        usage();
+    }
+    if(num_files==0 && num_gens==0){
+        for(g=0;g<NUM_GENERATORS;g++){
+            gens[num_gens++]=g;
+        }
+    }
+    for(i=0;i<num_files;i++){
+        traces[num_traces++]=trace_read(files[i]);
+    }
+    for(i=0;i<num_gens;i++){
+        traces[num_traces++]=trace_generate(gens[i], seed);
+    }
+    if(write_dir!=NULL){
+        for(i=0;i<num_traces;i++){
+            trace_write(traces[i], write_dir);
+        }
+        return 0;
+    }
+
+    if(count_events){
+        tlb_fd=event_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ<<8
+                          | PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+        fault_fd=event_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    }
+    mem_init();
+    if(compare){
+        failed=compare_policies(traces, num_traces, reps);
+        for(i=0;i<num_traces;i++){
+            trace_free(traces[i]);
+        }
+        mem_deinit();
+        return failed ? 1 : 0;
+    }
+    printf("%-10s %8s %5s %6s %12s %12s %10s %13s %10s %8s %8s %8s %8s %9s",
+           "trace", "ops", "valid", "util", "peak heap", "peak live", "end heap", "copies", "Kops/s",
+           "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+    printf(count_events ? " %12s %9s\n" : "\n", "dTLB misses", "faults");
+    for(i=0;i<num_traces;i++){
+        if(!run_trace(traces[i], reps, &r)){
+            printf("%-10s %8d %5s\n", traces[i]->name, traces[i]->num_objs, "no");
+            failed++;
+            continue;
+        }
+        snprintf(copies, sizeof(copies), "%zu/%zu", r.copies, r.reallocs);
+        printf("%-10s %8d %5s %5.1f%% %12zu %12zu %10zu %13s %10.0f %8.0f %8.0f %8.0f %8.0f %9.0f",
+               traces[i]->name, traces[i]->num_objs, "yes",
+               r.peak_heap ? 100.0*r.peak_live/r.peak_heap : 100.0, r.peak_heap, r.peak_live, r.end_heap, copies,
+               r.secs>0 ? traces[i]->num_objs/r.secs/1e3 : 0,
+               r.p50, r.p90, r.p99, r.p999, r.max);
+        if(count_events){
+            event_print(r.tlb_misses, r.faults);
+        }else{
+            printf("\n");
+        }
+        total_ops+=traces[i]->num_objs;
+        total_secs+=r.secs;
+        total_tlb+=r.tlb_misses;
+        total_faults+=r.faults;
+        util_sum+=r.peak_heap ? (double)r.peak_live/r.peak_heap : 1.0;
+    }
+    if(num_traces>failed){
+        printf("%-10s %8.0f %5s %5.1f%% %12s %12s %10s %13s %10.0f", "total", total_ops, failed ? "no" : "yes",
+               100.0*util_sum/(num_traces-failed), "", "", "", "",
+               total_secs>0 ? total_ops/total_secs/1e3 : 0);
+        if(count_events){
+            printf(" %8s %8s %8s %8s %9s", "", "", "", "", "");
+            event_print(tlb_fd<0 ? -1 : total_tlb, fault_fd<0 ? -1 : total_faults);
+        }else{
+            printf("\n");
+        }
+    }
+    for(i=0;i<num_traces;i++){
+        trace_free(traces[i]);
+    }
+    mem_deinit();
+    return failed ? 1 : 0;
+}
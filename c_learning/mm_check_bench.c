@@ -0,0 +1,216 @@
+/*
+ * mm_check_bench - cost of checking the heap: a full mm_checkheap against mm_checkheap_incremental and
+ * mm_checkheap_sampled, on a heap of many live blocks
+ *
+ * The heap is filled with live_blocks blocks of 1 to 512 bytes and a free block after every fourth one (in the
+ * segregated lists or the tree), with the slabs off so that every block is in the heap. Then:
+ *     full          one mm_checkheap(0) (its output is discarded)
+ *     incremental   mm_checkheap_incremental with budgets of 16 to 4096 blocks: the cost of a call, and of
+ *                   the calls it takes to cover the whole heap once
+ *     sampled       mm_checkheap_sampled with 1 to 64 samples
+ *     churn         random mm_malloc/mm_free pairs, alone and followed by mm_checkheap_incremental(64),
+ *                   which must not report any error while the heap changes under its cursor
+ *     double free   a block freed twice, from a slab, from the heap, and from the heap with the quick cache
+ *                   turned on between the two frees (so that the second one would hold a block that is in
+ *                   the index): the second mm_free must report it and leave the heap sound (the next two
+ *                   blocks of that size differ, and a pass of mm_checkheap_incremental finds no error)
+ *
+ * usage: mm_check_bench [live_blocks] [calls]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define MAX_SIZE 512
+#define CHURN_SLOTS 4096
+
+static unsigned long rng_state=88172645463325252UL;
+
+static unsigned long rng_next(void){
+    rng_state^=rng_state>>12;
+    rng_state^=rng_state<<25;
+    rng_state^=rng_state>>27;
+    return rng_state*2685821657736338717UL;
+}
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+/*time one mm_checkheap(0), with its report sent to /dev/null*/
+static double full_check(void){
+    int out, null;
+    double start, secs;
+
+    fflush(stdout);
+    out=dup(STDOUT_FILENO);
+    null=open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    start=now();
+    mm_checkheap(0);
+    secs=now()-start;
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    close(null);
+    close(out);
+    return secs;
+}
+
+/*free a block of size bytes twice (with the quick cache turned on between the two frees if quick), with what
+  mm_free prints captured; return 1 if the second free was reported and the next two blocks of that size differ*/
+static int double_free(size_t size, int quick){
+    char report[256]="";
+    FILE *capture;
+    void *p, *a, *b, *guard;
+    int out, ok;
+
+    capture=tmpfile();
+    if(capture==NULL){
+        return 0;
+    }
+    /*(the guard keeps p from the top of the heap, where mm_free does not use the quick cache)*/
+    p=mm_malloc(size);
+    guard=mm_malloc(size);
+    mm_free(p);
+    if(quick){
+        mm_setopt(MM_OPT_QUICK_MAX, 1024);
+    }
+    fflush(stdout);
+    out=dup(STDOUT_FILENO);
+    dup2(fileno(capture), STDOUT_FILENO);
+    mm_free(p);
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    close(out);
+    rewind(capture);
+    if(fgets(report, sizeof(report), capture)==NULL){
+        report[0]='\0';
+    }
+    fclose(capture);
+    a=mm_malloc(size);
+    b=mm_malloc(size);
+    ok=strstr(report, "Double Free Error")!=NULL && a!=b;
+    mm_free(a);
+    mm_free(b);
+    mm_free(guard);
+    mm_setopt(MM_OPT_QUICK_MAX, 0);
+    return ok;
+}
+
+/*time random mm_malloc/mm_free pairs, each followed by a check of budget blocks (none if 0); count the errors*/
+static double churn(long pairs, size_t budget, void **slots, long *errors){
+    double start;
+    long i;
+    int k;
+
+    start=now();
+    for(i=0;i<pairs;i++){
+        k=rng_next()%CHURN_SLOTS;
+        mm_free(slots[k]);
+        slots[k]=mm_malloc(16+rng_next()%(4*MAX_SIZE));
+        if(budget>0){
+            *errors+=mm_checkheap_incremental(budget);
+        }
+    }
+    return now()-start;
+}
+
+int main(int argc, char **argv){
+    static const size_t budgets[]={16, 256, 4096};
+    static const size_t samples[]={1, 16, 64};
+    static const struct { const char *name; size_t size; int quick; } misuse[]={{"slab", 32, 0}, {"heap", 2048, 0}, {"quick", 600, 1}};
+    long live, calls, n, total, errors=0, i;
+    void **slots, **blocks;
+    double secs, plain;
+    size_t b;
+
+    live=argc>1 ? atol(argv[1]) : 1000000;
+    calls=argc>2 ? atol(argv[2]) : 100000;
+    if(live<1 || calls<1){
+        fprintf(stderr, "usage: mm_check_bench [live_blocks] [calls]\n");
+        return 2;
+    }
+    slots=calloc(CHURN_SLOTS, sizeof(void *));
+    if(slots==NULL){
+        fprintf(stderr, "mm_check_bench: out of memory\n");
+        return 1;
+    }
+
+    mem_init();
+    mm_setopt(MM_OPT_SLAB_MAX, 0);
+    if(mm_init()<0){
+        fprintf(stderr, "mm_check_bench: mm_init failed\n");
+        return 1;
+    }
+    n=live+live/4;
+    blocks=malloc(n*sizeof(void *));
+    if(blocks==NULL){
+        fprintf(stderr, "mm_check_bench: out of memory\n");
+        return 1;
+    }
+    for(i=0;i<n;i++){
+        blocks[i]=mm_malloc(1+rng_next()%MAX_SIZE);
+        if(blocks[i]==NULL){
+            fprintf(stderr, "mm_check_bench: heap exhausted at %ld blocks\n", i);
+            return 1;
+        }
+    }
+    for(i=4;i<n;i+=5){
+        mm_free(blocks[i]);
+    }
+    for(i=0;i<CHURN_SLOTS;i++){
+        slots[i]=mm_malloc(16+rng_next()%(4*MAX_SIZE));
+    }
+    total=n+CHURN_SLOTS;
+    printf("%ld blocks (%ld live, %ld free) in a heap of %zu bytes\n", total, total-n/5, n/5, mm_footprint());
+
+    full_check();
+    secs=full_check();
+    printf("%-22s %12.3f ms per check\n", "mm_checkheap", secs*1e3);
+
+    printf("%-22s %12s %12s %14s\n", "", "ns/call", "ns/block", "ms/heap pass");
+    for(b=0;b<sizeof(budgets)/sizeof(budgets[0]);b++){
+        errors+=mm_checkheap_incremental(budgets[b]*calls);
+        secs=now();
+        for(i=0;i<calls;i++){
+            errors+=mm_checkheap_incremental(budgets[b]);
+        }
+        secs=now()-secs;
+        printf("incremental(%-4zu)      %12.1f %12.2f %14.3f\n", budgets[b], secs*1e9/calls, secs*1e9/calls/budgets[b],
+               secs*1e3/calls/budgets[b]*total);
+    }
+    for(b=0;b<sizeof(samples)/sizeof(samples[0]);b++){
+        secs=now();
+        for(i=0;i<calls;i++){
+            errors+=mm_checkheap_sampled(samples[b]);
+        }
+        secs=now()-secs;
+        printf("sampled(%-4zu)          %12.1f %12.2f\n", samples[b], secs*1e9/calls, secs*1e9/calls/samples[b]);
+    }
+
+    plain=churn(calls, 0, slots, &errors);
+    secs=churn(calls, 64, slots, &errors);
+    printf("%-22s %12.1f ns per malloc+free, %.1f with incremental(64) after each\n", "churn", plain*1e9/calls, secs*1e9/calls);
+
+    /*the slabs are off until now, so that every block above is in the heap*/
+    mm_setopt(MM_OPT_SLAB_MAX, 256);
+    for(b=0;b<sizeof(misuse)/sizeof(misuse[0]);b++){
+        /*and a pass over every block and slab after it*/
+        n=!double_free(misuse[b].size, misuse[b].quick)+mm_checkheap_incremental(total+mm_footprint()/4096);
+        errors+=n;
+        printf("double free (%-5s)    %12s\n", misuse[b].name, n ? "missed" : "reported");
+    }
+    printf("%ld errors\n", errors);
+    free(slots);
+    free(blocks);
+    return errors!=0;
+}
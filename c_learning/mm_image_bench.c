@@ -0,0 +1,201 @@
+/*
+ * mm_image_bench - a warm restart from a heap image (mm_detach and mm_attach) against rebuilding the same data
+ *
+ * A cache of entries (a table of pointers to entries of 16 to 512 bytes, every one filled from its key, with a
+ * quarter of them replaced by bigger ones so that the heap has free blocks in the lists and the tree) is built
+ * in a heap image and detached. Then, each time in a new mapping of the file, as a restarted process would find it:
+ *     attach            mm_attach, checking only the boundaries of the image
+ *     attach+validate   mm_attach checking every block
+ *     walk              a pass over every entry after attach, to check its contents (its pages fault in from
+ *                       the page cache)
+ *     rebuild           emptying the heap and building the cache again from scratch
+ * An image that was attached but not detached again (as if the process died) must be turned down.
+ *
+ * usage: mm_image_bench [entries] [image_file]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define IMAGE_SIZE (1UL<<36)
+#define MIN_ENTRY 16
+#define MAX_ENTRY 512
+
+typedef struct {
+    uint64_t key;
+    uint32_t len;               /*bytes of data*/
+    uint8_t data[];
+} entry_t;
+
+typedef struct {
+    size_t n;
+    entry_t *entries[];
+} cache_t;
+
+static unsigned long rng_state=88172645463325252UL;
+
+static unsigned long rng_next(void){
+    rng_state^=rng_state>>12;
+    rng_state^=rng_state<<25;
+    rng_state^=rng_state>>27;
+    return rng_state*2685821657736338717UL;
+}
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static entry_t *make_entry(uint64_t key, size_t size){
+    entry_t *e=mm_malloc(size);
+    uint32_t i;
+
+    if(e==NULL){
+        return NULL;
+    }
+    e->key=key;
+    e->len=size-sizeof(entry_t);
+    for(i=0;i<e->len;i++){
+        e->data[i]=(uint8_t)(key*31+i);
+    }
+    return e;
+}
+
+/*build a cache of n entries in the heap, return it (NULL if the heap is exhausted)*/
+static cache_t *build(size_t n){
+    cache_t *cache;
+    size_t i, size;
+
+    rng_state=88172645463325252UL;
+    cache=mm_malloc(sizeof(cache_t)+n*sizeof(entry_t *));
+    if(cache==NULL){
+        return NULL;
+    }
+    cache->n=n;
+    for(i=0;i<n;i++){
+        cache->entries[i]=make_entry(i, MIN_ENTRY+rng_next()%(MAX_ENTRY-MIN_ENTRY+1));
+        if(cache->entries[i]==NULL){
+            return NULL;
+        }
+    }
+    for(i=0;i<n;i+=4){
+        size=cache->entries[i]->len+sizeof(entry_t);
+        mm_free(cache->entries[i]);
+        cache->entries[i]=make_entry(i, size+MIN_ENTRY+rng_next()%(4*MAX_ENTRY));
+        if(cache->entries[i]==NULL){
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+/*check every entry of the cache against its key, return the number of bad ones*/
+static size_t walk(cache_t *cache){
+    size_t i, bad=0;
+    entry_t *e;
+    uint32_t j;
+
+    for(i=0;i<cache->n;i++){
+        e=cache->entries[i];
+        if(e->key!=i){
+            bad++;
+            continue;
+        }
+        for(j=0;j<e->len;j++){
+            if(e->data[j]!=(uint8_t)(i*31+j)){
+                bad++;
+                break;
+            }
+        }
+    }
+    return bad;
+}
+
+/*map the image again, as a new process would, and attach to it; return the time taken, or -1 if it is turned down*/
+static double attach(const char *path, int validate, cache_t **cache){
+    double start;
+
+    if(mem_init_mapped(path, MEM_IMAGE_BASE, IMAGE_SIZE)!=1){
+        fprintf(stderr, "mm_image_bench: cannot map %s again\n", path);
+        exit(1);
+    }
+    start=now();
+    if(mm_attach(validate, (void **)cache)<0){
+        return -1;
+    }
+    return now()-start;
+}
+
+int main(int argc, char **argv){
+    const char *path;
+    size_t n, bad;
+    cache_t *cache;
+    double secs;
+
+    n=argc>1 ? strtoul(argv[1], NULL, 0) : 1000000;
+    path=argc>2 ? argv[2] : "/tmp/mm_image_bench.img";
+    if(n<1){
+        fprintf(stderr, "usage: mm_image_bench [entries] [image_file]\n");
+        return 2;
+    }
+    unlink(path);
+    if(mem_init_mapped(path, MEM_IMAGE_BASE, IMAGE_SIZE)!=0 || mm_init()<0){
+        fprintf(stderr, "mm_image_bench: cannot set up a heap image in %s\n", path);
+        return 1;
+    }
+    secs=now();
+    cache=build(n);
+    secs=now()-secs;
+    if(cache==NULL){
+        fprintf(stderr, "mm_image_bench: heap exhausted\n");
+        return 1;
+    }
+    printf("%zu entries in a heap image of %.1f MB (%s)\n", n, mem_heapsize()/1e6, path);
+    printf("%-18s %12.3f ms\n", "build", secs*1e3);
+    secs=now();
+    if(mm_detach(cache)<0){
+        fprintf(stderr, "mm_image_bench: mm_detach failed\n");
+        return 1;
+    }
+    printf("%-18s %12.3f ms (writing the image to its file)\n", "detach", (now()-secs)*1e3);
+    mem_deinit();
+
+    bad=0;
+    secs=attach(path, 0, &cache);
+    printf("%-18s %12.3f ms\n", "attach", secs*1e3);
+    secs=now();
+    bad+=secs<0 ? n : walk(cache);
+    printf("%-18s %12.3f ms\n", "walk", (now()-secs)*1e3);
+    mm_detach(cache);
+    mem_deinit();
+
+    secs=attach(path, 1, &cache);
+    printf("%-18s %12.3f ms\n", "attach+validate", secs*1e3);
+    bad+=secs<0 ? n : walk(cache);
+    /*no mm_detach: the process dies with the image attached*/
+    mem_deinit();
+
+    secs=attach(path, 0, &cache);
+    printf("%-18s %12s\n", "attach undetached", secs<0 ? "turned down" : "TAKEN");
+    bad+=secs>=0;
+    secs=now();
+    mem_reset_brk();
+    if(mm_init()<0 || (cache=build(n))==NULL){
+        fprintf(stderr, "mm_image_bench: rebuild failed\n");
+        return 1;
+    }
+    printf("%-18s %12.3f ms\n", "rebuild", (now()-secs)*1e3);
+    bad+=walk(cache);
+    mem_deinit();
+    unlink(path);
+    printf("%zu bad entries\n", bad);
+    return bad!=0;
+}
@@ -0,0 +1,137 @@
+/*
+ * mm_index_bench - cost of a lookup in the index of large free blocks against the number of blocks in it
+ *
+ * For every heap size, the heap is filled with blocks of SEG_MAX_SIZE+16 to max_size bytes, each
+ * followed by a small allocated block so that none of them coalesce, and then all the large blocks
+ * are freed in random order. Two timings are taken on that heap, for requests of random sizes:
+ *     find         free_find alone (the lookup itself)
+ *     malloc+free  mm_malloc and an immediate mm_free, which also delete, split, coalesce and
+ *                  re-insert the block
+ * Built from mm.o, this measures the Red-black Tree; built from mm.tlsf.o (mm_index_bench_tlsf),
+ * the TLSF lists (MM_INDEX_TLSF).
+ *
+ * usage: mm_index_bench [max_free_blocks] [lookups] [max_size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+/*the lookup of mm.c, not part of the interface in mm.h*/
+extern void *free_find(size_t size);
+
+#define MIN_SIZE 528
+#define SPACER_SIZE 32
+
+static unsigned long rng_state=88172645463325252UL;
+
+static unsigned long rng_next(void){
+    rng_state^=rng_state>>12;
+    rng_state^=rng_state<<25;
+    rng_state^=rng_state>>27;
+    return rng_state*2685821657736338717UL;
+}
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+/*a request that ends up in the index of large free blocks (16 bytes less than the block, for the header)*/
+static size_t random_size(size_t max_size){
+    return MIN_SIZE-16+(rng_next()%((max_size-MIN_SIZE)/16+1))*16;
+}
+
+/*build a heap of n free blocks, return the number of them (0 if the heap is exhausted)*/
+static long build(long n, size_t max_size, void **blocks){
+    long i, j;
+    void *tmp;
+
+    mem_reset_brk();
+    if(mm_init()<0){
+        return 0;
+    }
+    for(i=0;i<n;i++){
+        blocks[i]=mm_malloc(random_size(max_size));
+        if(blocks[i]==NULL || mm_malloc(SPACER_SIZE)==NULL){
+            return 0;
+        }
+    }
+    for(i=n-1;i>0;i--){
+        j=rng_next()%(i+1);
+        tmp=blocks[i];
+        blocks[i]=blocks[j];
+        blocks[j]=tmp;
+    }
+    for(i=0;i<n;i++){
+        mm_free(blocks[i]);
+    }
+    return n;
+}
+
+int main(int argc, char **argv){
+    long max_blocks, lookups, n, i;
+    size_t max_size, *sizes;
+    void **blocks, *p;
+    volatile void *sink;
+    double start, find_ns, pair_ns;
+
+    max_blocks=argc>1 ? atol(argv[1]) : 1000000;
+    lookups=argc>2 ? atol(argv[2]) : 1000000;
+    max_size=argc>3 ? strtoul(argv[3], NULL, 0) : 2048;
+    if(max_blocks<1 || lookups<1 || max_size<MIN_SIZE){
+        fprintf(stderr, "usage: mm_index_bench [max_free_blocks] [lookups] [max_size (at least %d)]\n", MIN_SIZE);
+        return 2;
+    }
+    blocks=malloc(max_blocks*sizeof(void *));
+    sizes=malloc(lookups*sizeof(size_t));
+    if(blocks==NULL || sizes==NULL){
+        fprintf(stderr, "mm_index_bench: out of memory\n");
+        return 1;
+    }
+    for(i=0;i<lookups;i++){
+        sizes[i]=random_size(max_size)+16;
+    }
+
+    mem_init();
+    /*small blocks would go to the slabs and could not keep the large ones apart*/
+    mm_setopt(MM_OPT_SLAB_MAX, 0);
+    printf("%ld lookups of %d to %zu bytes\n", lookups, MIN_SIZE, max_size);
+    printf("%12s %12s %14s %12s\n", "free blocks", "find ns", "malloc+free ns", "heap");
+    for(n=1000;;n*=4){
+        if(n>max_blocks){
+            n=max_blocks;
+        }
+        if(build(n, max_size, blocks)==0){
+            fprintf(stderr, "mm_index_bench: heap exhausted at %ld blocks\n", n);
+            return 1;
+        }
+        /*a first, untimed pass warms up the caches and the branch predictors*/
+        for(i=0;i<lookups;i++){
+            sink=free_find(sizes[i]);
+        }
+        start=now();
+        for(i=0;i<lookups;i++){
+            sink=free_find(sizes[i]);
+        }
+        find_ns=(now()-start)*1e9/lookups;
+        start=now();
+        for(i=0;i<lookups;i++){
+            p=mm_malloc(sizes[i]-16);
+            mm_free(p);
+        }
+        pair_ns=(now()-start)*1e9/lookups;
+        printf("%12ld %12.1f %14.1f %12zu\n", n, find_ns, pair_ns, mm_footprint());
+        if(n==max_blocks){
+            break;
+        }
+    }
+    (void)sink;
+    free(blocks);
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,451 @@
+/*
+ * Multi-threaded mode
+ *
+ * The allocator in mm.c keeps all of its state in globals (tree_root, tree_null, the
+ * segregated lists) and grows the heap with mem_sbrk, so it may only be entered by one
+ * thread at a time. This file wraps it into a "central heap" guarded by central_lock and
+ * puts a cache in front of it for every thread:
+ *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- block returned by mm_malloc
+ * |  Address of the owning thread cache                           |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |  Size class (MT_LARGE if the block is not cached)             |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ <- user
+ * .                                                               .
+ * .  User data (the first word links the block while it is       .
+ * .  cached)                                                      .
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ * Requests up to MT_MAX_SIZE bytes are rounded up to one of MT_CLASSES size classes and served
+ * from a per-thread stack without any locking. An empty stack is first refilled from the blocks
+ * other threads have returned to us, and only then from the central heap, MT_BATCH blocks per
+ * lock acquisition. Stacks that grow beyond MT_CACHE_LIMIT give half of their blocks back to the
+ * central heap, again under a single acquisition.
+ *
+ * A block always belongs to the cache that took it from the central heap. When another thread
+ * frees it (the producer/consumer pattern), the block is pushed onto the owner's "remote" stack
+ * with a compare-and-swap, and the owner takes the whole stack with a single exchange the next
+ * time it runs dry. The freeing thread therefore never touches the central lock or the owner's
+ * private stacks.
+ *
+ * Caches are never released: when a thread exits, its stacks go back to the central heap and
+ * the cache is marked orphaned, and the next thread to start adopts it (together with whatever
+ * remote frees arrived in the meantime). The cache structures themselves are allocated from the
+ * central heap, so this file never calls the C library allocator (and can stand in for it, see
+ * mm_preload.c). central_lock is taken around fork, so that the child never inherits it locked.
+ *
+ * Large blocks have no owner: the first word of their prefix holds the size they were asked for instead,
+ * which is what mm_mt_usable_size reports. mm_mt_calloc has the central heap clear them (mm_calloc),
+ * which skips the memory the heap grows by. A block aligned beyond ALIGNMENT (mm_mt_memalign) is a large
+ * one, which the central heap aligns past the prefix (mm_memalign_offset). mm_mt_free_sized takes the size
+ * class from the size the block was asked for rather than from its prefix.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "mm.h"
+#include "mm_mt.h"
+
+#define MT_PREFIX 16
+#define MT_MAX_SIZE 512
+#define MT_CLASSES (MT_MAX_SIZE/16)
+#define MT_LARGE ((size_t)-1)
+#define MT_CACHE_LIMIT 128
+#define MT_BATCH 32
+#define CACHE_LINE 64
+
+/*Given the size of a request (not larger than MT_MAX_SIZE), compute its size class and the payload of that class*/
+#define MT_CLASS(size) ((size)==0 ? 0 : ((size)-1)/16)
+#define MT_CLASS_SIZE(cls) (((cls)+1)*16)
+
+/*Given the user ptr p, read the owner and the size class stored in front of it*/
+#define MT_OWNER(p) (*(struct mt_cache **)((char *)(p)-MT_PREFIX))
+#define MT_CLS(p) (*(size_t *)((char *)(p)-MT_PREFIX+8))
+
+/*Given the user ptr p of a large block, read the size it was asked for, stored in place of the owner*/
+#define MT_SIZE(p) (*(size_t *)((char *)(p)-MT_PREFIX))
+
+/*Given the user ptr p of a cached block, read the address of the next cached block*/
+#define MT_NEXT(p) (*(void **)(p))
+
+struct mt_cache {
+    /*touched only by the owning thread*/
+    void *bins[MT_CLASSES];
+    int counts[MT_CLASSES];
+    int orphaned;
+    struct mt_cache *next_cache;
+    char pad[CACHE_LINE];
+    /*written by every thread that frees one of our blocks*/
+    _Atomic(void *) remote;
+    char pad2[CACHE_LINE];
+};
+
+static pthread_mutex_t central_lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t mt_once=PTHREAD_ONCE_INIT;
+static pthread_key_t mt_key;
+static int mt_init_status;
+
+/*every cache ever created, for adoption (protected by central_lock)*/
+static struct mt_cache *all_caches;
+
+static __thread struct mt_cache *my_cache __attribute__((tls_model("initial-exec")));
+
+/*
+ * central_malloc - take a block for a cached class or a large request from the central heap.
+ * Return the user pointer (past the prefix), NULL if the heap is exhausted. Caller holds central_lock.
+ */
+static void *central_malloc(struct mt_cache *owner, size_t size, size_t cls){
+    void *block;
+
+    block=mm_malloc(size+MT_PREFIX);
+    if(block==NULL){
+        return NULL;
+    }
+    block=(char *)block+MT_PREFIX;
+    if(cls==MT_LARGE){
+        MT_SIZE(block)=size;
+    }else{
+        MT_OWNER(block)=owner;
+    }
+    MT_CLS(block)=cls;
+    return block;
+}
+
+/*
+ * cache_flush - give the n blocks on top of bin cls back to the central heap.
+ */
+static void cache_flush(struct mt_cache *cache, size_t cls, int n){
+    void *block;
+
+    pthread_mutex_lock(&central_lock);
+    while(n-- > 0 && cache->bins[cls]!=NULL){
+        block=cache->bins[cls];
+        cache->bins[cls]=MT_NEXT(block);
+        cache->counts[cls]--;
+        mm_free((char *)block-MT_PREFIX);
+    }
+    pthread_mutex_unlock(&central_lock);
+}
+
+/*
+ * cache_drain_remote - move every block freed to us by other threads into our own bins.
+ */
+static void cache_drain_remote(struct mt_cache *cache){
+    void *block, *next;
+    size_t cls;
+
+    if(atomic_load_explicit(&cache->remote, memory_order_relaxed)==NULL){
+        return;
+    }
+    block=atomic_exchange_explicit(&cache->remote, NULL, memory_order_acquire);
+    while(block!=NULL){
+        next=MT_NEXT(block);
+        cls=MT_CLS(block);
+        MT_NEXT(block)=cache->bins[cls];
+        cache->bins[cls]=block;
+        cache->counts[cls]++;
+        block=next;
+    }
+}
+
+/*
+ * cache_refill - refill the empty bin cls, from the remote frees if possible, otherwise with
+ * MT_BATCH blocks from the central heap. Return 0 if the central heap is exhausted.
+ */
+static int cache_refill(struct mt_cache *cache, size_t cls){
+    void *block;
+    int i;
+
+    cache_drain_remote(cache);
+    if(cache->bins[cls]!=NULL){
+        return 1;
+    }
+    pthread_mutex_lock(&central_lock);
+    for(i=0;i<MT_BATCH;i++){
+        block=central_malloc(cache, MT_CLASS_SIZE(cls), cls);
+        if(block==NULL){
+            break;
+        }
+        MT_NEXT(block)=cache->bins[cls];
+        cache->bins[cls]=block;
+        cache->counts[cls]++;
+    }
+    pthread_mutex_unlock(&central_lock);
+    return cache->bins[cls]!=NULL;
+}
+
+/*
+ * cache_release - pthread key destructor: return the bins of an exiting thread and orphan its cache.
+ */
+static void cache_release(void *arg){
+    struct mt_cache *cache=arg;
+    size_t cls;
+
+    cache_drain_remote(cache);
+    for(cls=0;cls<MT_CLASSES;cls++){
+        cache_flush(cache, cls, cache->counts[cls]);
+    }
+    pthread_mutex_lock(&central_lock);
+    cache->orphaned=1;
+    pthread_mutex_unlock(&central_lock);
+    my_cache=NULL;
+}
+
+/*
+ * cache_get - return the cache of the calling thread, adopting an orphaned one or creating one on first use.
+ */
+static struct mt_cache *cache_get(void){
+    struct mt_cache *cache;
+
+    if(my_cache!=NULL){
+        return my_cache;
+    }
+    pthread_mutex_lock(&central_lock);
+    for(cache=all_caches;cache!=NULL;cache=cache->next_cache){
+        if(cache->orphaned){
+            cache->orphaned=0;
+            break;
+        }
+    }
+    if(cache==NULL){
+        cache=mm_malloc(sizeof(struct mt_cache));
+        if(cache!=NULL){
+            memset(cache, 0, sizeof(struct mt_cache));
+            atomic_init(&cache->remote, NULL);
+            cache->next_cache=all_caches;
+            all_caches=cache;
+        }
+    }
+    pthread_mutex_unlock(&central_lock);
+    if(cache!=NULL){
+        my_cache=cache;
+        pthread_setspecific(mt_key, cache);
+    }
+    return cache;
+}
+
+static void mt_fork_prepare(void){
+    pthread_mutex_lock(&central_lock);
+}
+
+static void mt_fork_release(void){
+    pthread_mutex_unlock(&central_lock);
+}
+
+static void mt_init_once(void){
+    mt_init_status=mm_init();
+    if(mt_init_status==0 && (pthread_key_create(&mt_key, cache_release)!=0 ||
+                             pthread_atfork(mt_fork_prepare, mt_fork_release, mt_fork_release)!=0)){
+        mt_init_status=-1;
+    }
+}
+
+/*
+ * mm_mt_init - initialize the central heap. Safe to call from several threads; only the first call does the work.
+ */
+int mm_mt_init(void){
+    pthread_once(&mt_once, mt_init_once);
+    return mt_init_status;
+}
+
+/*
+ * mm_mt_malloc - allocate from the thread cache, falling back to the central heap.
+ */
+void *mm_mt_malloc(size_t size){
+    struct mt_cache *cache;
+    void *block;
+    size_t cls;
+
+    cache=cache_get();
+    if(cache==NULL){
+        return NULL;
+    }
+    if(size>MT_MAX_SIZE){
+        pthread_mutex_lock(&central_lock);
+        block=central_malloc(cache, size, MT_LARGE);
+        pthread_mutex_unlock(&central_lock);
+        return block;
+    }
+    cls=MT_CLASS(size);
+    if(cache->bins[cls]==NULL && !cache_refill(cache, cls)){
+        return NULL;
+    }
+    block=cache->bins[cls];
+    cache->bins[cls]=MT_NEXT(block);
+    cache->counts[cls]--;
+    return block;
+}
+
+/*
+ * mm_mt_calloc - allocate a zeroed block for nmemb elements of size bytes. Return NULL if the product overflows.
+ */
+void *mm_mt_calloc(size_t nmemb, size_t size){
+    void *block;
+    size_t bytes;
+
+    if(size!=0 && nmemb>((size_t)-1)/size){
+        return NULL;
+    }
+    bytes=nmemb*size;
+    if(bytes<=MT_MAX_SIZE){
+        block=mm_mt_malloc(bytes);
+        if(block!=NULL){
+            memset(block, 0, bytes);
+        }
+        return block;
+    }
+    pthread_mutex_lock(&central_lock);
+    block=mm_calloc(1, bytes+MT_PREFIX);
+    pthread_mutex_unlock(&central_lock);
+    if(block==NULL){
+        return NULL;
+    }
+    block=(char *)block+MT_PREFIX;
+    MT_SIZE(block)=bytes;
+    MT_CLS(block)=MT_LARGE;
+    return block;
+}
+
+/*
+ * mm_mt_memalign - allocate size bytes aligned to alignment (a power of two): from the thread cache up to
+ * ALIGNMENT, as a large block of the central heap beyond.
+ */
+void *mm_mt_memalign(size_t alignment, size_t size){
+    void *block;
+
+    if(alignment<=ALIGNMENT){
+        return mm_mt_malloc(size);
+    }
+    pthread_mutex_lock(&central_lock);
+    block=mm_memalign_offset(alignment, MT_PREFIX, size+MT_PREFIX);
+    pthread_mutex_unlock(&central_lock);
+    if(block==NULL){
+        return NULL;
+    }
+    block=(char *)block+MT_PREFIX;
+    MT_SIZE(block)=size;
+    MT_CLS(block)=MT_LARGE;
+    return block;
+}
+
+/*
+ * mt_free - free the block ptr of size class cls (MT_LARGE for a large block).
+ */
+static void mt_free(void *ptr, size_t cls){
+    struct mt_cache *owner;
+    void *head;
+
+    if(cls==MT_LARGE){
+        pthread_mutex_lock(&central_lock);
+        mm_free((char *)ptr-MT_PREFIX);
+        pthread_mutex_unlock(&central_lock);
+        return;
+    }
+    owner=MT_OWNER(ptr);
+    if(owner==my_cache){
+        MT_NEXT(ptr)=owner->bins[cls];
+        owner->bins[cls]=ptr;
+        if(++owner->counts[cls]>MT_CACHE_LIMIT){
+            cache_flush(owner, cls, MT_CACHE_LIMIT/2);
+        }
+        return;
+    }
+    /*remote free: push onto the owner's lock-free stack*/
+    head=atomic_load_explicit(&owner->remote, memory_order_relaxed);
+    do{
+        MT_NEXT(ptr)=head;
+    }while(!atomic_compare_exchange_weak_explicit(&owner->remote, &head, ptr,
+                                                  memory_order_release, memory_order_relaxed));
+}
+
+/*
+ * mm_mt_free - return a block to its owner: directly if we own it, through the owner's remote stack otherwise.
+ */
+void mm_mt_free(void *ptr){
+    if(ptr!=NULL){
+        mt_free(ptr, MT_CLS(ptr));
+    }
+}
+
+/*
+ * mm_mt_free_sized - free a block given the size it was allocated with by mm_mt_malloc or mm_mt_calloc
+ * (not one that mm_mt_realloc resized or mm_mt_memalign aligned beyond ALIGNMENT), without reading its size class.
+ */
+void mm_mt_free_sized(void *ptr, size_t size){
+    if(ptr!=NULL){
+        mt_free(ptr, size>MT_MAX_SIZE ? MT_LARGE : MT_CLASS(size));
+    }
+}
+
+/*
+ * mm_mt_usable_size - return the bytes of the block ptr that may be used: those of its size class, or those
+ * asked for if it is large.
+ */
+size_t mm_mt_usable_size(void *ptr){
+    size_t cls;
+
+    if(ptr==NULL){
+        return 0;
+    }
+    cls=MT_CLS(ptr);
+    if(cls==MT_LARGE){
+        return MT_SIZE(ptr);
+    }
+    return MT_CLASS_SIZE(cls);
+}
+
+/*
+ * mm_mt_realloc - keep the block if its size class still fits, let the central heap resize large blocks,
+ * and move the data otherwise.
+ */
+void *mm_mt_realloc(void *ptr, size_t size){
+    void *block;
+    size_t cls, copy_size;
+
+    if(ptr==NULL){
+        return mm_mt_malloc(size);
+    }
+    if(size==0){
+        mm_mt_free(ptr);
+        return NULL;
+    }
+    cls=MT_CLS(ptr);
+    if(cls!=MT_LARGE && size<=MT_CLASS_SIZE(cls)){
+        return ptr;
+    }
+    if(cls==MT_LARGE && size>MT_MAX_SIZE){
+        pthread_mutex_lock(&central_lock);
+        block=mm_realloc((char *)ptr-MT_PREFIX, size+MT_PREFIX);
+        pthread_mutex_unlock(&central_lock);
+        if(block==NULL){
+            return NULL;
+        }
+        block=(char *)block+MT_PREFIX;
+        MT_SIZE(block)=size;
+        return block;
+    }
+    block=mm_mt_malloc(size);
+    if(block==NULL){
+        return NULL;
+    }
+    copy_size=mm_mt_usable_size(ptr);
+    if(size<copy_size){
+        copy_size=size;
+    }
+    memcpy(block, ptr, copy_size);
+    mm_mt_free(ptr);
+    return block;
+}
+
+/*
+ * mm_mt_checkheap - run mm_checkheap on the central heap. Blocks sitting in thread caches are
+ * allocated as far as the central heap is concerned.
+ */
+void mm_mt_checkheap(int verbose){
+    pthread_mutex_lock(&central_lock);
+    mm_checkheap(verbose);
+    pthread_mutex_unlock(&central_lock);
+}
@@ -0,0 +1,31 @@
+/*
+ * mm_mt.h - thread-safe front end for the allocator in mm.c
+ *
+ * mm_malloc/mm_free/mm_realloc keep their single-threaded contract. Multi-threaded
+ * programs call the mm_mt_* functions instead, which put a per-thread cache in front
+ * of a central mm.c heap guarded by one lock. See mm_mt.c for the details.
+ */
+#ifndef MM_MT_H
+#define MM_MT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int mm_mt_init(void);
+extern void *mm_mt_malloc(size_t size);
+extern void mm_mt_free(void *ptr);
+extern void *mm_mt_realloc(void *ptr, size_t size);
+extern void *mm_mt_calloc(size_t nmemb, size_t size);
+extern void *mm_mt_memalign(size_t alignment, size_t size);
+extern void mm_mt_free_sized(void *ptr, size_t size);
+extern size_t mm_mt_usable_size(void *ptr);
+extern void mm_mt_checkheap(int verbose);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * mm_mt_bench - producer/consumer scaling benchmark for the multi-threaded mode (mm_mt.c)
+ *
+ * Threads are arranged in a ring. Every thread allocates blocks of random small sizes, passes
+ * them to its successor through a single-producer/single-consumer queue and frees whatever its
+ * predecessor passes to it, so with more than one thread every free is a remote free.
+ * The same workload is run against mm_mt_* and against mm_malloc/mm_free behind one global lock,
+ * for 1, 2, 4, ... up to the requested number of threads.
+ *
+ * usage: mm_mt_bench [max_threads] [ops_per_thread]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sched.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_mt.h"
+
+#define QUEUE_SIZE 1024
+#define MAX_THREADS 256
+
+struct queue {
+    _Atomic(unsigned long) head;
+    char pad[64];
+    _Atomic(unsigned long) tail;
+    char pad2[64];
+    void *slots[QUEUE_SIZE];
+};
+
+struct worker {
+    pthread_t thread;
+    int id;
+    struct queue *in, *out;
+    _Atomic(int) done;
+    struct worker *pred;
+};
+
+static long ops_per_thread;
+static int use_mt;
+static pthread_mutex_t global_lock=PTHREAD_MUTEX_INITIALIZER;
+
+static void *bench_malloc(size_t size){
+    void *p;
+
+    if(use_mt){
+        return mm_mt_malloc(size);
+    }
+    pthread_mutex_lock(&global_lock);
+    p=mm_malloc(size);
+    pthread_mutex_unlock(&global_lock);
+    return p;
+}
+
+static void bench_free(void *p){
+    if(use_mt){
+        mm_mt_free(p);
+        return;
+    }
+    pthread_mutex_lock(&global_lock);
+    mm_free(p);
+    pthread_mutex_unlock(&global_lock);
+}
+
+static int queue_push(struct queue *q, void *p){
+    unsigned long tail=atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if(tail-atomic_load_explicit(&q->head, memory_order_acquire)==QUEUE_SIZE){
+        return 0;
+    }
+    q->slots[tail%QUEUE_SIZE]=p;
+    atomic_store_explicit(&q->tail, tail+1, memory_order_release);
+    return 1;
+}
+
+static void *queue_pop(struct queue *q){
+    unsigned long head=atomic_load_explicit(&q->head, memory_order_relaxed);
+    void *p;
+
+    if(head==atomic_load_explicit(&q->tail, memory_order_acquire)){
+        return NULL;
+    }
+    p=q->slots[head%QUEUE_SIZE];
+    atomic_store_explicit(&q->head, head+1, memory_order_release);
+    return p;
+}
+
+/*free everything the predecessor has passed to us so far; return the number of blocks*/
+static long drain(struct worker *w){
+    void *p;
+    long n=0;
+
+    while((p=queue_pop(w->in))!=NULL){
+        bench_free(p);
+        n++;
+    }
+    return n;
+}
+
+static void *worker_main(void *arg){
+    struct worker *w=arg;
+    unsigned seed=w->id*7919+1;
+    size_t size;
+    long i;
+    void *p;
+
+    for(i=0;i<ops_per_thread;i++){
+        size=16+rand_r(&seed)%240;
+        p=bench_malloc(size);
+        if(p==NULL){
+            fprintf(stderr, "mm_mt_bench: out of memory\n");
+            exit(1);
+        }
+        memset(p, w->id, 16);
+        while(!queue_push(w->out, p)){
+            if(drain(w)==0){
+                sched_yield();
+            }
+        }
+        if((i&15)==0){
+            drain(w);
+        }
+    }
+    atomic_store(&w->done, 1);
+    /*keep consuming until our producer has finished and its queue is empty*/
+    while(!atomic_load(&w->pred->done) || drain(w)>0 ||
+          atomic_load(&w->in->head)!=atomic_load(&w->in->tail)){
+        if(drain(w)==0){
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static double run(int nthreads){
+    static struct worker workers[MAX_THREADS];
+    static struct queue queues[MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    memset(workers, 0, sizeof(workers));
+    memset(queues, 0, sizeof(queues));
+    for(i=0;i<nthreads;i++){
+        workers[i].id=i;
+        workers[i].in=&queues[i];
+        workers[i].out=&queues[(i+1)%nthreads];
+        workers[i].pred=&workers[(i+nthreads-1)%nthreads];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0;i<nthreads;i++){
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+    for(i=0;i<nthreads;i++){
+        pthread_join(workers[i].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec-start.tv_sec)+(end.tv_nsec-start.tv_nsec)/1e9;
+}
+
+int main(int argc, char **argv){
+    int max_threads=argc>1 ? atoi(argv[1]) : 32;
+    int nthreads;
+    double secs, ops, base_mt=0, base_lock=0;
+
+    ops_per_thread=argc>2 ? atol(argv[2]) : 1000000;
+    if(max_threads<1 || max_threads>MAX_THREADS){
+        fprintf(stderr, "mm_mt_bench: max_threads must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    mem_init();
+    if(mm_mt_init()<0){
+        fprintf(stderr, "mm_mt_bench: mm_mt_init failed\n");
+        return 1;
+    }
+    printf("%8s %16s %8s %16s %8s\n", "threads", "mm_mt ops/s", "scale", "locked ops/s", "scale");
+    for(nthreads=1;nthreads<=max_threads;nthreads*=2){
+        /*every op is one malloc and one free*/
+        ops=2.0*ops_per_thread*nthreads;
+        use_mt=1;
+        secs=run(nthreads);
+        if(nthreads==1){
+            base_mt=ops/secs;
+        }
+        printf("%8d %16.0f %8.2f", nthreads, ops/secs, ops/secs/base_mt);
+        use_mt=0;
+        secs=run(nthreads);
+        if(nthreads==1){
+            base_lock=ops/secs;
+        }
+        printf(" %16.0f %8.2f\n", ops/secs, ops/secs/base_lock);
+    }
+    mm_mt_checkheap(0);
+    return 0;
+}
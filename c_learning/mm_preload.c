@@ -0,0 +1,152 @@
+/*
+ * mm_preload - the allocator of mm_mt.c (and mm.c behind it) in place of the C library's, for any program
+ *
+ * libmm.so defines malloc, free, realloc, calloc, posix_memalign, aligned_alloc, memalign, valloc, pvalloc
+ * and malloc_usable_size (this file), and operator new and delete (mm_preload_new.cpp), so that a program
+ * run with it preloaded allocates from mm.c without being rebuilt:
+ *
+ *     LD_PRELOAD=./libmm.so ./program
+ *
+ * The heap is set up by the first call, which may come before main and before the constructors of the
+ * program run, and behind it the blocks go to the thread caches of mm_mt.c. calloc has the central heap
+ * clear large blocks (mm_calloc), which skips the memory the heap grows by. Requests beyond PTRDIFF_MAX
+ * fail with ENOMEM, as they do in the C library, before any size computation can overflow.
+ *
+ * Only the functions above are exported from libmm.so (everything is built with -fvisibility=hidden), so
+ * the globals of mm.c cannot clash with those of the program.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "mm_mt.h"
+#include "memlib.h"
+
+#define EXPORT __attribute__((visibility("default")))
+
+static pthread_once_t preload_once=PTHREAD_ONCE_INIT;
+
+static void preload_init_once(void){
+    static const char msg[]="libmm.so: cannot set up the heap\n";
+
+    mem_init();
+    if(mm_mt_init()<0){
+        write(2, msg, sizeof(msg)-1);
+        abort();
+    }
+}
+
+/*
+ * preload_init - set up the heap on the first call. Nothing here allocates, so it cannot recurse.
+ */
+static inline void preload_init(void){
+    pthread_once(&preload_once, preload_init_once);
+}
+
+/*
+ * preload_done - return ptr, setting errno to ENOMEM if it is NULL.
+ */
+static inline void *preload_done(void *ptr){
+    if(ptr==NULL){
+        errno=ENOMEM;
+    }
+    return ptr;
+}
+
+EXPORT void *malloc(size_t size){
+    if(size>PTRDIFF_MAX){
+        return preload_done(NULL);
+    }
+    preload_init();
+    return preload_done(mm_mt_malloc(size));
+}
+
+EXPORT void free(void *ptr){
+    mm_mt_free(ptr);
+}
+
+EXPORT void *calloc(size_t nmemb, size_t size){
+    if(size!=0 && nmemb>PTRDIFF_MAX/size){
+        return preload_done(NULL);
+    }
+    preload_init();
+    return preload_done(mm_mt_calloc(nmemb, size));
+}
+
+EXPORT void *realloc(void *ptr, size_t size){
+    if(size>PTRDIFF_MAX){
+        return preload_done(NULL);
+    }
+    preload_init();
+    if(ptr!=NULL && size==0){
+        mm_mt_free(ptr);
+        return NULL;
+    }
+    return preload_done(mm_mt_realloc(ptr, size));
+}
+
+/*
+ * preload_memalign - allocate size bytes aligned to alignment, a power of two.
+ */
+static void *preload_memalign(size_t alignment, size_t size){
+    if(size>PTRDIFF_MAX || alignment>PTRDIFF_MAX/2){
+        return preload_done(NULL);
+    }
+    preload_init();
+    return preload_done(mm_mt_memalign(alignment, size));
+}
+
+EXPORT int posix_memalign(void **memptr, size_t alignment, size_t size){
+    void *ptr;
+    int saved=errno;
+
+    if(alignment<sizeof(void *) || (alignment & (alignment-1))!=0){
+        return EINVAL;
+    }
+    ptr=preload_memalign(alignment, size);
+    if(ptr==NULL){
+        errno=saved;
+        return ENOMEM;
+    }
+    *memptr=ptr;
+    return 0;
+}
+
+EXPORT void *aligned_alloc(size_t alignment, size_t size){
+    if(alignment==0 || (alignment & (alignment-1))!=0){
+        errno=EINVAL;
+        return NULL;
+    }
+    return preload_memalign(alignment, size);
+}
+
+EXPORT void *memalign(size_t alignment, size_t size){
+    size_t align=ALIGNMENT;
+
+    /*like the C library, round an alignment that is not a power of two up to one*/
+    while(align<alignment && align<=PTRDIFF_MAX/2){
+        align*=2;
+    }
+    return preload_memalign(align, size);
+}
+
+EXPORT void *valloc(size_t size){
+    return preload_memalign(getpagesize(), size);
+}
+
+EXPORT void *pvalloc(size_t size){
+    size_t page=getpagesize();
+
+    if(size>PTRDIFF_MAX){
+        return preload_done(NULL);
+    }
+    return preload_memalign(page, (size+page-1) & ~(page-1));
+}
+
+EXPORT size_t malloc_usable_size(void *ptr){
+    return mm_mt_usable_size(ptr);
+}
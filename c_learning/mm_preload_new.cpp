@@ -0,0 +1,135 @@
+/*
+ * mm_preload_new - operator new and delete of libmm.so (see mm_preload.c)
+ *
+ * Every form of new goes through malloc or aligned_alloc, which libmm.so defines, so that the heap is set
+ * up however the program first allocates, and calls the new handler until the request succeeds or there is
+ * none left (the nothrow forms then return nullptr, the others throw std::bad_alloc). The sized forms of
+ * delete free through mm_mt_free_sized, which takes the size class from the size rather than from the
+ * header of the block; an aligned new beyond ALIGNMENT gets a large block whatever its size, so only at
+ * most ALIGNMENT can its sized delete do the same.
+ */
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "mm.h"
+#include "mm_mt.h"
+
+/*
+ * new_alloc - allocate size bytes aligned to alignment for operator new, calling the new handler until
+ * they are found. Throw std::bad_alloc if there is no new handler.
+ */
+static void *new_alloc(std::size_t size, std::size_t alignment){
+    void *ptr;
+
+    for(;;){
+        ptr=alignment<=ALIGNMENT ? std::malloc(size) : std::aligned_alloc(alignment, size);
+        if(ptr!=nullptr){
+            return ptr;
+        }
+        std::new_handler handler=std::get_new_handler();
+        if(handler==nullptr){
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void *new_alloc_nothrow(std::size_t size, std::size_t alignment) noexcept {
+    try{
+        return new_alloc(size, alignment);
+    }catch(...){
+        return nullptr;
+    }
+}
+
+/*
+ * delete_sized - free a block of operator new, given the size and alignment it was asked for.
+ */
+static inline void delete_sized(void *ptr, std::size_t size, std::size_t alignment) noexcept {
+    if(alignment<=ALIGNMENT){
+        mm_mt_free_sized(ptr, size);
+    }else{
+        std::free(ptr);
+    }
+}
+
+void *operator new(std::size_t size){
+    return new_alloc(size, ALIGNMENT);
+}
+
+void *operator new[](std::size_t size){
+    return new_alloc(size, ALIGNMENT);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return new_alloc_nothrow(size, ALIGNMENT);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return new_alloc_nothrow(size, ALIGNMENT);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment){
+    return new_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment){
+    return new_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return new_alloc_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return new_alloc_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size) noexcept {
+    mm_mt_free_sized(ptr, size);
+}
+
+void operator delete[](void *ptr, std::size_t size) noexcept {
+    mm_mt_free_sized(ptr, size);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size, std::align_val_t alignment) noexcept {
+    delete_sized(ptr, size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void *ptr, std::size_t size, std::align_val_t alignment) noexcept {
+    delete_sized(ptr, size, static_cast<std::size_t>(alignment));
+}
@@ -0,0 +1,347 @@
+/*
+ * Heap profile
+ *
+ * mm.c (built with MM_PROFILE) hands every sampled request to prof_record and every sampled block it
+ * frees to prof_forget (see "Heap profile" in mm.c for how requests are sampled). prof_record takes the
+ * stack of the request with backtrace, from the caller of mm_malloc (or mm_realloc) outwards, and files
+ * the block under its site: the sites are kept in a hash table keyed by their stacks, the live sampled
+ * blocks in another one keyed by their address, which prof_forget looks up to take the block off its
+ * site. Both tables are static, so the profile never allocates from the heap it watches; a sample that
+ * finds them full is dropped and counted (mm_prof_dropped).
+ *
+ * Every site counts its sampled blocks and their bytes, live and allocated so far. A block of size bytes
+ * is sampled with probability 1-exp(-size/rate), so it stands for size/(1-exp(-size/rate)) bytes of
+ * requests; the sites also add up these estimates. mm_prof_dump writes the profile as
+ *  - a heap profile of gperftools (MM_PROF_PPROF): the sampled counts of every site followed by its stack
+ *    as addresses, and the memory map of the process, which pprof turns into functions and lines
+ *    ("pprof -top prog heap.prof"); pprof scales the counts up by the rate itself;
+ *  - folded stacks (MM_PROF_FOLDED): one line per site with live blocks, its frames from the outermost
+ *    down to the caller of mm_malloc separated by ';', then the estimated live bytes
+ *    ("flamegraph.pl heap.folded > heap.svg"). Frames are named with dladdr, so the functions of the
+ *    program itself only have names if it is linked with -rdynamic.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+#include "mm.h"
+#include "mm_prof.h"
+
+/*Deepest stack kept for a site, and the frames taken beyond it to find the caller of mm_malloc*/
+#define PROF_MAX_DEPTH 32
+#define PROF_EXTRA_DEPTH 8
+
+/*Slots of the tables of sites and of live sampled blocks (powers of two), filled to at most 3/4*/
+#define PROF_SITES 4096
+#define PROF_SAMPLES 65536
+
+/*Given the address p of a sampled block, compute its home slot in the table of samples*/
+#define SAMPLE_HOME(p) ((((uintptr_t)(p)>>4)*0x9E3779B97F4A7C15UL)>>48 & (PROF_SAMPLES-1))
+
+typedef struct {
+    uint64_t hash;                  /*hash of the stack, 0 for an empty slot*/
+    int depth;
+    void *pcs[PROF_MAX_DEPTH];      /*return addresses, from the caller of mm_malloc outwards*/
+    size_t alloc_count, alloc_bytes;/*blocks sampled at this site so far, and their requested bytes*/
+    size_t live_count, live_bytes;  /*those not freed yet*/
+    double alloc_est, live_est;     /*bytes they stand for*/
+} prof_site_t;
+
+typedef struct {
+    void *ptr;                      /*user pointer of the block, NULL for an empty slot*/
+    prof_site_t *site;
+    size_t size;
+    double weight;                  /*bytes it stands for*/
+} prof_sample_t;
+
+prof_site_t prof_sites[PROF_SITES];
+prof_sample_t prof_samples[PROF_SAMPLES];
+size_t prof_num_sites, prof_num_samples;
+
+/*samples not recorded for want of room, the rate of the last sample, the state of the random generator of
+ * prof_interval, and whether prof_record is running (backtrace may allocate)*/
+size_t prof_dropped;
+size_t prof_last_rate;
+unsigned long prof_rng=88172645463325252UL;
+int prof_busy;
+
+/*where and how mm_prof_dump_at_exit writes the profile*/
+static char prof_exit_path[4096];
+static int prof_exit_format;
+
+/*
+ * prof_interval - draw the number of bytes to allocate before the next sample: exponentially distributed with mean rate.
+ */
+size_t prof_interval(size_t rate){
+    double u;
+
+    prof_rng^=prof_rng>>12;
+    prof_rng^=prof_rng<<25;
+    prof_rng^=prof_rng>>27;
+    /*uniform in (0,1]*/
+    u=(((prof_rng*2685821657736338717UL)>>11)+1)*(1.0/9007199254740992.0);
+    return (size_t)(-log(u)*rate)+1;
+}
+
+/*
+ * site_find - find the site of the stack of depth frames in pcs, adding it if it is new. Return NULL if the table is full.
+ */
+static prof_site_t *site_find(void **pcs, int depth){
+    uint64_t hash=14695981039346656037UL;
+    prof_site_t *site;
+    size_t i;
+    int k;
+
+    for(k=0;k<depth;k++){
+        hash=(hash^(uintptr_t)pcs[k])*1099511628211UL;
+    }
+    hash|=1;
+    for(i=hash & (PROF_SITES-1);;i=(i+1) & (PROF_SITES-1)){
+        site=&prof_sites[i];
+        if(site->hash==hash && site->depth==depth && memcmp(site->pcs, pcs, depth*sizeof(void *))==0){
+            return site;
+        }
+        if(site->hash==0){
+            break;
+        }
+    }
+    if(prof_num_sites>=PROF_SITES/4*3){
+        return NULL;
+    }
+    site->hash=hash;
+    site->depth=depth;
+    memcpy(site->pcs, pcs, depth*sizeof(void *));
+    prof_num_sites++;
+    return site;
+}
+
+/*
+ * sample_find - return the slot of the sampled block ptr, or the empty slot where it would go.
+ */
+static size_t sample_find(void *ptr){
+    size_t i;
+
+    for(i=SAMPLE_HOME(ptr);prof_samples[i].ptr!=NULL && prof_samples[i].ptr!=ptr;i=(i+1) & (PROF_SAMPLES-1))
+        ;
+    return i;
+}
+
+/*
+ * sample_remove - take the sampled block in slot i off its site and empty the slot, moving back the blocks after it
+ * that could not go to their home slot (linear probing without tombstones).
+ */
+static void sample_remove(size_t i){
+    prof_sample_t *sample=&prof_samples[i];
+    size_t j=i, home;
+
+    sample->site->live_count--;
+    sample->site->live_bytes-=sample->size;
+    sample->site->live_est-=sample->weight;
+    prof_num_samples--;
+    for(;;){
+        prof_samples[i].ptr=NULL;
+        do{
+            j=(j+1) & (PROF_SAMPLES-1);
+            if(prof_samples[j].ptr==NULL){
+                return;
+            }
+            home=SAMPLE_HOME(prof_samples[j].ptr);
+        }while(i<=j ? (i<home && home<=j) : (i<home || home<=j));
+        prof_samples[i]=prof_samples[j];
+        i=j;
+    }
+}
+
+/*
+ * prof_record - record the block ptr of size bytes, sampled at the given rate by a call from caller (a return
+ * address in the function that called mm_malloc). A block recorded before under the same address is replaced.
+ */
+void prof_record(void *ptr, size_t size, size_t rate, void *caller){
+    void *pcs[PROF_MAX_DEPTH+PROF_EXTRA_DEPTH];
+    prof_site_t *site;
+    prof_sample_t *sample;
+    size_t i;
+    int n, first;
+
+    if(prof_busy){
+        return;
+    }
+    prof_busy=1;
+    i=sample_find(ptr);
+    if(prof_samples[i].ptr!=NULL){
+        sample_remove(i);
+        i=sample_find(ptr);
+    }
+    n=backtrace(pcs, PROF_MAX_DEPTH+PROF_EXTRA_DEPTH);
+    /*drop the frames of the allocator itself*/
+    for(first=0;first<n && pcs[first]!=caller;first++)
+        ;
+    if(first==n){
+        first=n>1 ? 1 : 0;
+    }
+    if(n-first>PROF_MAX_DEPTH){
+        n=first+PROF_MAX_DEPTH;
+    }
+    site=site_find(pcs+first, n-first);
+    if(site==NULL || prof_num_samples>=PROF_SAMPLES/4*3){
+        prof_dropped++;
+        prof_busy=0;
+        return;
+    }
+    sample=&prof_samples[i];
+    sample->ptr=ptr;
+    sample->site=site;
+    sample->size=size;
+    sample->weight=size>0 ? size/(1.0-exp(-(double)size/rate)) : 0.0;
+    prof_num_samples++;
+    site->alloc_count++;
+    site->alloc_bytes+=size;
+    site->alloc_est+=sample->weight;
+    site->live_count++;
+    site->live_bytes+=size;
+    site->live_est+=sample->weight;
+    prof_last_rate=rate;
+    prof_busy=0;
+}
+
+/*
+ * prof_forget - take the sampled block ptr, being freed, off the profile (nothing if it was dropped).
+ */
+void prof_forget(void *ptr){
+    size_t i=sample_find(ptr);
+
+    if(prof_samples[i].ptr!=NULL){
+        sample_remove(i);
+    }
+}
+
+/*
+ * prof_reset - forget every sampled block and every site (the heap is starting over).
+ */
+void prof_reset(void){
+    memset(prof_sites, 0, sizeof(prof_sites));
+    memset(prof_samples, 0, sizeof(prof_samples));
+    prof_num_sites=prof_num_samples=0;
+    prof_dropped=0;
+}
+
+/*
+ * frame_name - write the name of the function holding the return address pc to out: its symbol, or its object
+ * file and offset, or the bare address.
+ */
+static void frame_name(FILE *out, void *pc){
+    Dl_info info;
+    const char *base;
+
+    /*(pc-1 is still in the call, even when the call is the last instruction of the function)*/
+    if(dladdr((char *)pc-1, &info)==0){
+        fprintf(out, "%p", pc);
+    }else if(info.dli_sname!=NULL){
+        fprintf(out, "%s", info.dli_sname);
+    }else{
+        base=strrchr(info.dli_fname, '/');
+        fprintf(out, "%s+0x%lx", base!=NULL ? base+1 : info.dli_fname, (unsigned long)((char *)pc-(char *)info.dli_fbase));
+    }
+}
+
+/*
+ * mm_prof_dump - write the profile to out in the given format (MM_PROF_*). Return 0 on success, -1 on failure.
+ */
+int mm_prof_dump(FILE *out, int format){
+    size_t live_count=0, live_bytes=0, alloc_count=0, alloc_bytes=0, i;
+    prof_site_t *site;
+    FILE *maps;
+    char line[4096];
+    int k;
+
+    if(format==MM_PROF_PPROF){
+        for(i=0;i<PROF_SITES;i++){
+            live_count+=prof_sites[i].live_count;
+            live_bytes+=prof_sites[i].live_bytes;
+            alloc_count+=prof_sites[i].alloc_count;
+            alloc_bytes+=prof_sites[i].alloc_bytes;
+        }
+        fprintf(out, "heap profile: %6zu: %8zu [%6zu: %8zu] @ heap_v2/%zu\n", live_count, live_bytes, alloc_count, alloc_bytes, prof_last_rate);
+        for(i=0;i<PROF_SITES;i++){
+            site=&prof_sites[i];
+            if(site->hash==0){
+                continue;
+            }
+            fprintf(out, "%6zu: %8zu [%6zu: %8zu] @", site->live_count, site->live_bytes, site->alloc_count, site->alloc_bytes);
+            for(k=0;k<site->depth;k++){
+                fprintf(out, " %p", site->pcs[k]);
+            }
+            fprintf(out, "\n");
+        }
+        fprintf(out, "\nMAPPED_LIBRARIES:\n");
+        maps=fopen("/proc/self/maps", "r");
+        if(maps!=NULL){
+            while(fgets(line, sizeof(line), maps)!=NULL){
+                fputs(line, out);
+            }
+            fclose(maps);
+        }
+    }else if(format==MM_PROF_FOLDED){
+        for(i=0;i<PROF_SITES;i++){
+            site=&prof_sites[i];
+            if(site->hash==0 || site->live_est<0.5){
+                continue;
+            }
+            for(k=site->depth-1;k>=0;k--){
+                frame_name(out, site->pcs[k]);
+                fputc(k>0 ? ';' : ' ', out);
+            }
+            fprintf(out, "%.0f\n", site->live_est);
+        }
+    }else{
+        return -1;
+    }
+    fflush(out);
+    return ferror(out) ? -1 : 0;
+}
+
+/*
+ * prof_dump_exit - write the profile where mm_prof_dump_at_exit was told to.
+ */
+static void prof_dump_exit(void){
+    FILE *out;
+
+    out=fopen(prof_exit_path, "w");
+    if(out==NULL){
+        perror(prof_exit_path);
+        return;
+    }
+    mm_prof_dump(out, prof_exit_format);
+    fclose(out);
+}
+
+/*
+ * mm_prof_dump_at_exit - write the profile to the file path in the given format when the program exits
+ * (the last call wins). Return 0 on success, -1 if the path is too long or the format unknown.
+ */
+int mm_prof_dump_at_exit(const char *path, int format){
+    static int registered;
+
+    if(strlen(path)>=sizeof(prof_exit_path) || (format!=MM_PROF_PPROF && format!=MM_PROF_FOLDED)){
+        return -1;
+    }
+    strcpy(prof_exit_path, path);
+    prof_exit_format=format;
+    if(!registered && atexit(prof_dump_exit)!=0){
+        return -1;
+    }
+    registered=1;
+    return 0;
+}
+
+/*
+ * mm_prof_dropped - return the number of sampled requests that could not be recorded since mm_init (the tables were full).
+ */
+size_t mm_prof_dropped(void){
+    return prof_dropped;
+}
@@ -0,0 +1,41 @@
+/*
+ * mm_prof.h - sampling heap profile of the allocator in mm.c
+ *
+ * With mm.c built with MM_PROFILE and a rate set with mm_setopt(MM_OPT_PROF_RATE, rate), about one
+ * request in every rate bytes allocated is recorded with the stack it was made from, until it is
+ * freed. The profile holds, for every allocation site (stack), the sampled blocks still live and
+ * all those allocated so far, and can be written at any time or when the program exits:
+ *
+ *     mm_setopt(MM_OPT_PROF_RATE, 512*1024);
+ *     mm_prof_dump_at_exit("heap.prof", MM_PROF_PPROF);
+ *
+ * See mm_prof.c for the details.
+ */
+#ifndef MM_PROF_H
+#define MM_PROF_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*Formats of mm_prof_dump*/
+#define MM_PROF_PPROF 0           /*heap profile of gperftools (heap_v2), read by pprof with the binary*/
+#define MM_PROF_FOLDED 1          /*one line per site, its frames from the outermost and its estimated live bytes, for flamegraph.pl*/
+
+extern int mm_prof_dump(FILE *out, int format);
+extern int mm_prof_dump_at_exit(const char *path, int format);
+extern size_t mm_prof_dropped(void);
+
+/*Used by mm.c*/
+extern size_t prof_interval(size_t rate);
+extern void prof_record(void *ptr, size_t size, size_t rate, void *caller);
+extern void prof_forget(void *ptr);
+extern void prof_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * mm_prof_demo - the heap profile (mm_prof.h) of a synthetic program whose live memory is known
+ *
+ * Four functions allocate from the mm.c heap:
+ *     keep_small    100000 blocks of 64 bytes, all kept
+ *     keep_large    2000 blocks of 16 KiB, every other one freed
+ *     churn         200000 blocks of 200 bytes, each freed right away
+ *     grow_buffers  1000 buffers of 1 KiB, each grown to 8 KiB with mm_realloc
+ * The live bytes the profile attributes to each of them (from its folded stacks, by the function that
+ * called mm_malloc or mm_realloc) are printed next to the actual ones, and must be within 10% at the
+ * default rate of 4096 bytes (at much larger rates the few samples of keep_small stray further).
+ * The folded stacks are printed as well, and the profile in the format of pprof is written to
+ * pprof_file if one is given ("pprof -top mm_prof_demo pprof_file").
+ *
+ * usage: mm_prof_demo [rate] [pprof_file]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_prof.h"
+
+#define NUM_SMALL 100000
+#define SMALL_SIZE 64
+#define NUM_LARGE 2000
+#define LARGE_SIZE (16*1024)
+#define NUM_CHURN 200000
+#define CHURN_SIZE 200
+#define NUM_BUFFERS 1000
+#define BUFFER_SIZE 1024
+#define GROWN_SIZE (8*1024)
+
+static void *small[NUM_SMALL], *large[NUM_LARGE], *buffers[NUM_BUFFERS];
+
+/*(not static, so that -rdynamic gives the profile their names)*/
+__attribute__((noinline)) void keep_small(void){
+    int i;
+
+    for(i=0;i<NUM_SMALL;i++){
+        small[i]=mm_malloc(SMALL_SIZE);
+    }
+}
+
+__attribute__((noinline)) void keep_large(void){
+    int i;
+
+    for(i=0;i<NUM_LARGE;i++){
+        large[i]=mm_malloc(LARGE_SIZE);
+    }
+    for(i=0;i<NUM_LARGE;i+=2){
+        mm_free(large[i]);
+        large[i]=NULL;
+    }
+}
+
+__attribute__((noinline)) void churn(void){
+    int i;
+
+    for(i=0;i<NUM_CHURN;i++){
+        mm_free(mm_malloc(CHURN_SIZE));
+    }
+}
+
+__attribute__((noinline)) void grow_buffers(void){
+    int i;
+
+    for(i=0;i<NUM_BUFFERS;i++){
+        buffers[i]=mm_malloc(BUFFER_SIZE);
+    }
+    for(i=0;i<NUM_BUFFERS;i++){
+        buffers[i]=mm_realloc(buffers[i], GROWN_SIZE);
+    }
+}
+
+int main(int argc, char **argv){
+    static const struct {
+        const char *name;
+        double live;
+    } sites[]={
+        {"keep_small", (double)NUM_SMALL*SMALL_SIZE},
+        {"keep_large", (double)NUM_LARGE/2*LARGE_SIZE},
+        {"churn", 0},
+        {"grow_buffers", (double)NUM_BUFFERS*GROWN_SIZE},
+    };
+    size_t rate, len, i;
+    char *folded, *line, *end, *leaf;
+    double profiled, error;
+    FILE *out;
+    int failed=0;
+
+    rate=argc>1 ? strtoul(argv[1], NULL, 0) : 4096;
+    mem_init();
+    if(mm_setopt(MM_OPT_PROF_RATE, rate)<0 || mm_init()<0){
+        fprintf(stderr, "mm_prof_demo: mm.c must be built with MM_PROFILE\n");
+        return 1;
+    }
+    keep_small();
+    keep_large();
+    churn();
+    grow_buffers();
+
+    out=open_memstream(&folded, &len);
+    if(out==NULL || mm_prof_dump(out, MM_PROF_FOLDED)<0){
+        fprintf(stderr, "mm_prof_demo: cannot write the profile\n");
+        return 1;
+    }
+    fclose(out);
+    printf("folded stacks (one in %zu bytes sampled):\n%s\n", rate, folded);
+
+    printf("%-14s %14s %14s %8s\n", "site", "live bytes", "profiled", "error");
+    for(i=0;i<sizeof(sites)/sizeof(sites[0]);i++){
+        profiled=0;
+        for(line=folded;*line!='\0';line=end+1){
+            end=strchr(line, '\n');
+            *end='\0';
+            leaf=strrchr(line, ';');
+            leaf=leaf!=NULL ? leaf+1 : line;
+            if(strncmp(leaf, sites[i].name, strlen(sites[i].name))==0 && leaf[strlen(sites[i].name)]==' '){
+                profiled+=atof(leaf+strlen(sites[i].name)+1);
+            }
+            *end='\n';
+        }
+        error=sites[i].live>0 ? (profiled-sites[i].live)/sites[i].live : (profiled>0 ? 1 : 0);
+        printf("%-14s %14.0f %14.0f %7.1f%% %s\n", sites[i].name, sites[i].live, profiled, error*100,
+               error<-0.1 || error>0.1 ? "off" : "ok");
+        failed|=error<-0.1 || error>0.1;
+    }
+    printf("%zu samples dropped\n", mm_prof_dropped());
+    free(folded);
+
+    if(argc>2){
+        out=fopen(argv[2], "w");
+        if(out==NULL || mm_prof_dump(out, MM_PROF_PPROF)<0){
+            perror(argv[2]);
+            return 1;
+        }
+        fclose(out);
+    }
+    return failed;
+}
@@ -0,0 +1,156 @@
+/*
+ * bloom_filter.cpp - the blocked Bloom filter (see bloom_filter.hpp)
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "bloom_filter.hpp"
+#include "mapped_file.hpp"
+
+#define BLOCK_BITS 512
+#define MAX_HASHES 16
+#define MAX_BITS_PER_KEY 64.0
+#define MIN_FP_RATE 1e-9
+
+/*
+ * block_fp_rate - the false-positive rate of a blocked filter holding load keys per block on average, with
+ * k bits per key. The keys in a block are Poisson distributed; a block with i keys has each bit set with
+ * probability 1-(1-1/512)^(k*i), and a key it does not hold is a false positive if its k bits all are.
+ */
+static double block_fp_rate(double load, unsigned k){
+    double p=std::exp(-load), sum=0, set;
+    unsigned i, limit=(unsigned)(load+10*std::sqrt(load)+20);
+
+    for(i=0;i<=limit;i++){
+        set=1-std::pow(1-1.0/BLOCK_BITS, (double)k*i);
+        sum+=p*std::pow(set, k);
+        p*=load/(i+1);
+    }
+    return sum;
+}
+
+/*
+ * bloom_filter - find the fewest bits per key (in steps of 1/4) for which some k from 1 to 16 keeps the
+ * false-positive rate at fp_rate, starting from what an unblocked filter needs. A rate out of (1e-9, 0.5)
+ * is taken as the nearest bound of it.
+ */
+bloom_filter::bloom_filter(std::size_t expected, double fp_rate){
+    double target=std::min(std::max(fp_rate, MIN_FP_RATE), 0.5), bits_per_key, best;
+    unsigned h;
+
+    k=1;
+    for(bits_per_key=std::max(1.0, std::floor(-std::log2(target)*1.44));bits_per_key<MAX_BITS_PER_KEY;bits_per_key+=0.25){
+        best=1;
+        for(h=1;h<=MAX_HASHES;h++){
+            double rate=block_fp_rate(BLOCK_BITS/bits_per_key, h);
+            if(rate<best){
+                best=rate;
+                k=h;
+            }
+        }
+        if(best<=target){
+            break;
+        }
+    }
+    blocks=std::max<std::size_t>(1, (std::size_t)std::ceil(expected*bits_per_key/BLOCK_BITS));
+    bits.reset(new block[blocks]());
+}
+
+/*
+ * bit_walk - the k bits of fp in its block: 9-bit fields from the top of fp mixed again, 7 to a word, with a
+ * new word mixed for every 7 bits. (Double hashing, bit i at h1+i*h2, would take fewer multiplies but allows
+ * only 512*256 sets of bits in a block, which keeps the false-positive rate from going much below 0.03%.)
+ */
+namespace {
+
+struct bit_walk {
+    std::uint64_t fp, g;
+    unsigned round, left;
+
+    explicit bit_walk(std::uint64_t fp) : fp(fp), round(0){
+        remix();
+    }
+    void remix(){
+        g=fp+(++round)*0x9e3779b97f4a7c15ULL;
+        g=(g^(g>>31))*0xbf58476d1ce4e5b9ULL;
+        g^=g>>29;
+        left=7;
+    }
+    unsigned bit() const {
+        return g>>55;
+    }
+    unsigned word() const {
+        return bit()/64;
+    }
+    std::uint64_t mask() const {
+        return 1ULL<<(bit()%64);
+    }
+    void next(){
+        if(--left==0){
+            remix();
+        }else{
+            g<<=9;
+        }
+    }
+};
+
+}
+
+bool bloom_filter::insert(std::uint64_t fp){
+    block &b=block_of(fp);
+    bit_walk w(fp);
+    bool fresh=false;
+    unsigned i;
+
+    for(i=0;i<k;i++, w.next()){
+        /*skip the atomic read-modify-write when the bit is already set, as most are in a full filter*/
+        if((b.words[w.word()].load(std::memory_order_relaxed)&w.mask())==0
+           && (b.words[w.word()].fetch_or(w.mask(), std::memory_order_relaxed)&w.mask())==0){
+            fresh=true;
+        }
+    }
+    return fresh;
+}
+
+bool bloom_filter::contains(std::uint64_t fp) const {
+    const block &b=block_of(fp);
+    bit_walk w(fp);
+    unsigned i;
+
+    for(i=0;i<k;i++, w.next()){
+        if((b.words[w.word()].load(std::memory_order_relaxed)&w.mask())==0){
+            return false;
+        }
+    }
+    return true;
+}
+
+double bloom_filter::fp_rate(std::size_t keys) const {
+    return block_fp_rate((double)keys/blocks, k);
+}
+
+void bloom_filter::save(const std::string &path) const {
+    write_file_atomic(path, bits.get(), memory_bytes());
+}
+
+/*
+ * load - false if path does not exist or holds a filter of another size
+ */
+bool bloom_filter::load(const std::string &path){
+    if(access(path.c_str(), F_OK)!=0){
+        return false;
+    }
+    mapped_file f(path, 0, false);
+    if(f.size()!=memory_bytes()){
+        return false;
+    }
+    std::memcpy((void*)bits.get(), f.data(), f.size());
+    return true;
+}
+
+void bloom_filter::clear(){
+    std::memset((void*)bits.get(), 0, memory_bytes());
+}
@@ -0,0 +1,71 @@
+/*
+ * bloom_filter.hpp - a blocked Bloom filter of 64-bit fingerprints
+ *
+ * A Bloom filter sets k bits of a bit array for every key it holds and says a key may be there when all of
+ * its k bits are set: never wrong about a key it holds, wrong about a key it does not hold with probability
+ * about p for about 1.44*log2(1/p) bits per key (10 bits for 1%, 14 for 0.1%). Spread over the whole array,
+ * the k bits cost k cache misses; here they all fall in one 512-bit block (a cache line) picked by the key,
+ * so a lookup or an insert costs one. Blocks do not fill evenly (some draw more keys than others), so a
+ * blocked filter needs a few more bits per key for the same p; the constructor works out how many.
+ *
+ * The words are atomic and insert sets the bits with fetch_or, so any number of threads may insert and look
+ * up at once. insert answers whether one of the bits of the key was clear, which is exact-once for a key only
+ * if its inserts are serialized by the caller (two threads can each find a different bit clear).
+ */
+#ifndef CRAWLER_BLOOM_FILTER_HPP
+#define CRAWLER_BLOOM_FILTER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class bloom_filter {
+public:
+    /*a filter of expected keys that holds them with a false-positive rate of at most fp_rate*/
+    bloom_filter(std::size_t expected, double fp_rate);
+
+    bloom_filter(const bloom_filter&)=delete;
+    bloom_filter& operator=(const bloom_filter&)=delete;
+
+    /*set the bits of fp; return true if one of them was clear (fp was surely not in the filter)*/
+    bool insert(std::uint64_t fp);
+
+    /*whether all the bits of fp are set (fp is in the filter, or a false positive)*/
+    bool contains(std::uint64_t fp) const;
+
+    /*the false-positive rate expected once keys keys are in the filter*/
+    double fp_rate(std::size_t keys) const;
+
+    unsigned hashes() const {
+        return k;
+    }
+
+    std::size_t memory_bytes() const {
+        return blocks*sizeof(block);
+    }
+
+    /*write the bits to path durably, and read them back from it (into a filter of the same size); not
+      while keys are inserted*/
+    void save(const std::string &path) const;
+    bool load(const std::string &path);
+
+    /*clear all the bits (not while keys are inserted)*/
+    void clear();
+
+private:
+    struct alignas(64) block {
+        std::atomic<std::uint64_t> words[8];
+    };
+
+    std::unique_ptr<block[]> bits;
+    std::size_t blocks;
+    unsigned k;
+
+    block &block_of(std::uint64_t fp) const {
+        return bits[(unsigned __int128)fp*blocks>>64];
+    }
+};
+
+#endif
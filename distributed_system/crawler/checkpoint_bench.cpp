@@ -0,0 +1,221 @@
+/*
+ * checkpoint_bench - memory of a crawl kept on disk, and the time it takes to resume one after a crash
+ *
+ * Three crawls of the same synthetic web (pages pages on 4096 hosts, 8 links each, 1 ms of latency) by the
+ * pipelined engine, each in a process of its own so that its peak memory is its own:
+ *     in memory   a bloom_visited_set with its exact tier and every task in memory (as pipeline_bench)
+ *     on disk     a crawl_store in dir: 32768 fingerprints and 8192 tasks in memory, the rest in runs and
+ *                 frontier segments, a checkpoint every second
+ *     crash       the crawl on disk again, killed (SIGKILL) halfway or after its first checkpoint if that
+ *                 comes later (a short crawl checkpoints more often), then resumed in a new process from its last checkpoint and run to the end
+ * For each: the pages per second, the peak resident memory (VmHWM) and the anonymous memory at the end
+ * (RssAnon; the rest of the resident memory is pages of mapped files, which the kernel can drop). For the
+ * crash: how long open() takes to load the checkpoint and the pages fetched twice, those fetched after the
+ * last checkpoint before the kill. Every crawl must end with every page fetched.
+ *
+ * usage: checkpoint_bench [pages] [dir]
+ */
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "crawl_store.hpp"
+#include "fake_fetcher.hpp"
+#include "pipeline.hpp"
+#include "visited_set.hpp"
+
+#define HOSTS 4096
+#define FANOUT 8
+#define LATENCY std::chrono::milliseconds(1)
+#define MAX_IN_FLIGHT 4096
+#define RAM_URLS 32768
+#define RAM_TASKS 8192
+#define SEGMENT_BYTES (4<<20)
+#define CHECKPOINT_SECONDS 1.0
+
+/*what a crawl process reports, in memory shared with the parent*/
+struct report {
+    double seconds;
+    double open_ms;
+    std::size_t pages;          /*fetched in all, checkpoints before included*/
+    std::size_t fetched;        /*by this process*/
+    std::size_t checkpoints;    /*kept up to date as the crawl goes*/
+    std::size_t disk_bytes;
+    long hwm_kb, anon_kb;
+    bool resumed;
+};
+
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * status_kb - a field of /proc/self/status, in kB
+ */
+static long status_kb(const char *field){
+    std::ifstream in("/proc/self/status");
+    std::string line;
+
+    while(std::getline(in, line)){
+        if(line.compare(0, std::strlen(field), field)==0 && line[std::strlen(field)]==':'){
+            return std::atol(line.c_str()+std::strlen(field)+1);
+        }
+    }
+    return -1;
+}
+
+static pipeline_options engine_options(){
+    pipeline_options options;
+
+    options.max_in_flight=MAX_IN_FLIGHT;
+    options.max_per_host=4;
+    return options;
+}
+
+static void crawl_in_memory(std::size_t pages, report *r){
+    synthetic_fetcher web(pages, FANOUT, HOSTS);
+    fake_async_fetcher net(web, LATENCY);
+    bloom_visited_set visited(pages, 0.001, true);
+    pipelined_crawler engine(net, visited, engine_options());
+
+    crawl_stats stats=engine.crawl(web.root(), static_cast<int>(pages), [r](const std::string&, const fetch_result&){
+        r->fetched++;
+    });
+    r->seconds=stats.seconds;
+    r->pages=stats.pages;
+}
+
+static void crawl_on_disk(std::size_t pages, const std::string &dir, double checkpoint_seconds, report *r){
+    synthetic_fetcher web(pages, FANOUT, HOSTS);
+    fake_async_fetcher net(web, LATENCY);
+    crawl_store_options store_options;
+    store_options.expected=pages;
+    store_options.ram_urls=RAM_URLS;
+    store_options.ram_tasks=RAM_TASKS;
+    store_options.segment_bytes=SEGMENT_BYTES;
+    crawl_store store(dir, store_options);
+
+    double start=now();
+    r->resumed=store.open();
+    r->open_ms=(now()-start)*1e3;
+
+    pipeline_options options=engine_options();
+    options.store=&store;
+    options.checkpoint_seconds=checkpoint_seconds;
+    pipelined_crawler engine(net, store.visited(), options);
+    crawl_stats stats=engine.crawl(web.root(), static_cast<int>(pages), [r, &store](const std::string&, const fetch_result&){
+        r->fetched++;
+        r->checkpoints=store.checkpoints();
+    });
+    r->seconds=stats.seconds;
+    r->pages=stats.pages;
+    r->checkpoints=store.checkpoints();
+    r->disk_bytes=store.disk_bytes();
+}
+
+/*
+ * run - run crawl in a child process; if kill_after is not 0, kill it once kill_after seconds have gone by
+ * and it has written a checkpoint. Return false if it failed (or was killed).
+ */
+template<typename F>
+static bool run(report *r, double kill_after, F crawl){
+    pid_t pid;
+    int status;
+
+    std::memset((void*)r, 0, sizeof(*r));
+    pid=fork();
+    if(pid<0){
+        std::perror("fork");
+        return false;
+    }
+    if(pid==0){
+        try{
+            crawl();
+        }catch(const std::exception &e){
+            std::fprintf(stderr, "checkpoint_bench: %s\n", e.what());
+            _exit(1);
+        }
+        r->hwm_kb=status_kb("VmHWM");
+        r->anon_kb=status_kb("RssAnon");
+        _exit(0);
+    }
+    if(kill_after>0){
+        double start=now();
+        while(waitpid(pid, &status, WNOHANG)==0){
+            if(now()-start>=kill_after && r->checkpoints>0){
+                kill(pid, SIGKILL);
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status)==0;
+}
+
+static void print(const char *name, const report &r){
+    std::printf("%-10s %10.0f %10.1f %10.1f %12.1f\n", name, r.fetched/r.seconds, r.hwm_kb/1024.0, r.anon_kb/1024.0,
+                r.disk_bytes/1048576.0);
+}
+
+int main(int argc, char **argv){
+    std::size_t pages=argc>1 ? std::strtoul(argv[1], nullptr, 0) : 600000;
+    std::string dir=argc>2 ? argv[2] : "crawl_state";
+    report *r=(report*)mmap(nullptr, 2*sizeof(report), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    report memory, disk, killed;
+
+    if(pages<1 || r==MAP_FAILED){
+        std::fprintf(stderr, "usage: checkpoint_bench [pages] [dir]\n");
+        return 2;
+    }
+    std::printf("%zu pages on %d hosts, %d links each, 1 ms latency; on disk in %s\n", pages, HOSTS, FANOUT, dir.c_str());
+    std::printf("%-10s %10s %10s %10s %12s\n", "crawl", "pages/s", "peak MB", "anon MB", "disk MB");
+
+    if(!run(r, 0, [&](){ crawl_in_memory(pages, r); }) || r->pages!=pages){
+        std::fprintf(stderr, "checkpoint_bench: the crawl in memory fetched %zu pages of %zu\n", r->pages, pages);
+        return 1;
+    }
+    memory=*r;
+    print("in memory", memory);
+
+    std::system(("rm -rf '"+dir+"'").c_str());
+    if(!run(r, 0, [&](){ crawl_on_disk(pages, dir, CHECKPOINT_SECONDS, r); }) || r->pages!=pages || r->fetched!=pages){
+        std::fprintf(stderr, "checkpoint_bench: the crawl on disk fetched %zu pages of %zu\n", r->pages, pages);
+        return 1;
+    }
+    disk=*r;
+    print("on disk", disk);
+    std::printf("%zu checkpoints\n", disk.checkpoints);
+
+    /*a crawl shorter than CHECKPOINT_SECONDS checkpoints more often, to have a checkpoint to resume from*/
+    double every=std::min(CHECKPOINT_SECONDS, disk.seconds/4);
+    std::system(("rm -rf '"+dir+"'").c_str());
+    if(run(r, disk.seconds/2, [&](){ crawl_on_disk(pages, dir, every, r); }) || r->checkpoints==0){
+        std::fprintf(stderr, "checkpoint_bench: the crawl ended before it could be killed after a checkpoint\n");
+        return 1;
+    }
+    killed=*r;
+    bool ok=run(r, 0, [&](){ crawl_on_disk(pages, dir, every, r); });
+    if(!r->resumed){
+        std::fprintf(stderr, "checkpoint_bench: no checkpoint to resume from in %s\n", dir.c_str());
+        return 1;
+    }
+    if(!ok || r->pages!=pages){
+        std::fprintf(stderr, "checkpoint_bench: the resumed crawl fetched %zu pages of %zu\n", r->pages, pages);
+        return 1;
+    }
+    print("resumed", *r);
+    std::printf("killed after %zu pages; resumed in %.1f ms and fetched %zu more, %zu of them twice\n",
+                killed.fetched, r->open_ms, r->fetched, killed.fetched+r->fetched-pages);
+    return 0;
+}
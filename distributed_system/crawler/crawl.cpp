@@ -0,0 +1,36 @@
+/*
+ * crawl - the crawl of ../lec2.txt: the pages of its fakeFetcher from https://golang.org/, 4 workers, depth 4
+ *
+ * Every page is fetched once, whichever worker finds it first, and the workers share the pages to fetch
+ * instead of each crawling the whole web from the root.
+ *
+ * usage: crawl [workers] [depth]
+ */
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+#include "crawler.hpp"
+#include "fake_fetcher.hpp"
+#include "visited_set.hpp"
+
+int main(int argc, char **argv){
+    unsigned workers=argc>1 ? std::strtoul(argv[1], nullptr, 0) : 4;
+    int depth=argc>2 ? std::atoi(argv[2]) : 4;
+    fake_fetcher fetcher=fake_fetcher::golang();
+    striped_visited_set visited;
+    crawler pool(fetcher, visited, workers);
+    std::mutex out;
+
+    crawl_stats stats=pool.crawl("https://golang.org/", depth, [&](const std::string &url, const fetch_result &result){
+        std::lock_guard<std::mutex> guard(out);
+        if(result.ok){
+            std::cout<<"found: "<<url<<" \""<<result.body<<"\""<<std::endl;
+        }else{
+            std::cout<<result.error<<std::endl;
+        }
+    });
+    std::cout<<stats.pages<<" pages, "<<stats.errors<<" errors, "<<stats.duplicates<<" duplicate links, "
+             <<stats.steals<<" steals with "<<workers<<" workers"<<std::endl;
+    return 0;
+}
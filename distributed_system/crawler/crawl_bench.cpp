@@ -0,0 +1,65 @@
+/*
+ * crawl_bench - pages per second of the crawl pool from 1 to 64 workers
+ *
+ * Each run crawls a synthetic web (synthetic_fetcher: pages on 64 hosts, each with fanout links) from its
+ * root with a fresh visited set and a depth of pages, which no path can exceed, so that every page is
+ * reached. Every fetch waits for the latency, so with a latency the workers mostly wait, as on the network,
+ * and the pages per second should grow with them; with none, they contend for the deques and the visited
+ * set. Both visited sets are measured:
+ *     striped      striped_visited_set with 256 stripes
+ *     one lock     striped_visited_set with one stripe (the Cache of ../lec2.txt)
+ * Every run must fetch every page exactly once.
+ *
+ * usage: crawl_bench [pages] [latency_us] [fanout]
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include "crawler.hpp"
+#include "fake_fetcher.hpp"
+#include "visited_set.hpp"
+
+#define MAX_WORKERS 64
+#define HOSTS 64
+
+/*crawl the whole web with the given workers and stripes; return the pages per second, -1 if a page was missed*/
+static double run(synthetic_fetcher &web, unsigned workers, std::size_t stripes, std::size_t *steals){
+    striped_visited_set visited(stripes);
+    crawler pool(web, visited, workers);
+    crawl_stats stats=pool.crawl(web.root(), static_cast<int>(web.size()));
+
+    *steals=stats.steals;
+    if(stats.pages!=web.size() || stats.errors!=0 || visited.size()!=web.size()){
+        std::fprintf(stderr, "crawl_bench: %zu pages of %zu fetched, %zu errors, %zu claimed\n",
+                     stats.pages, web.size(), stats.errors, visited.size());
+        return -1;
+    }
+    return stats.pages/stats.seconds;
+}
+
+int main(int argc, char **argv){
+    std::size_t pages, fanout, steals;
+    long latency;
+    unsigned workers;
+    double striped, single;
+
+    pages=argc>1 ? std::strtoul(argv[1], nullptr, 0) : 4000;
+    latency=argc>2 ? std::atol(argv[2]) : 1000;
+    fanout=argc>3 ? std::strtoul(argv[3], nullptr, 0) : 8;
+    if(pages<1 || latency<0 || fanout<2){
+        std::fprintf(stderr, "usage: crawl_bench [pages] [latency_us] [fanout (at least 2)]\n");
+        return 2;
+    }
+    synthetic_fetcher web(pages, fanout, HOSTS, std::chrono::microseconds(latency));
+    std::printf("%zu pages, %zu links each, fetch latency %ld us\n", pages, fanout, latency);
+    std::printf("%8s %16s %16s %10s\n", "workers", "striped pages/s", "one lock pages/s", "steals");
+    for(workers=1;workers<=MAX_WORKERS;workers*=2){
+        striped=run(web, workers, 256, &steals);
+        single=run(web, workers, 1, &steals);
+        if(striped<0 || single<0){
+            return 1;
+        }
+        std::printf("%8u %16.0f %16.0f %10zu\n", workers, striped, single, steals);
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * crawl_store.cpp - the crawl state on disk and its checkpoints (see crawl_store.hpp)
+ *
+ * The checkpoint file is a sequence of 64-bit words (and task records), in the byte order of the machine:
+ *     magic, sequence
+ *     pages, errors, duplicates            the counts of the engine
+ *     URLs in the visited set, runs, then the number of each run
+ *     reader segment and offset, writer segment and offset, tasks in the frontier log
+ *     tasks, then for each the length of its URL, its depth and the URL
+ *     the fingerprint of all the bytes before it
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/stat.h>
+
+#include "crawl_store.hpp"
+#include "fingerprint.hpp"
+#include "mapped_file.hpp"
+
+#define CHECKPOINT_MAGIC 0x314b43574152434dULL     /*"MCRAWCK1"*/
+
+static void put64(std::string &out, std::uint64_t v){
+    out.append((const char*)&v, sizeof(v));
+}
+
+/*
+ * reader - reads a checkpoint back, failing on a short one
+ */
+namespace {
+
+struct reader {
+    const std::string &data;
+    std::size_t pos=0;
+
+    std::uint64_t get64(){
+        std::uint64_t v;
+
+        need(sizeof(v));
+        std::memcpy(&v, data.data()+pos, sizeof(v));
+        pos+=sizeof(v);
+        return v;
+    }
+    std::string get(std::size_t n){
+        need(n);
+        pos+=n;
+        return data.substr(pos-n, n);
+    }
+    void need(std::size_t n){
+        if(data.size()-pos<n){
+            throw std::runtime_error("crawl_store: short checkpoint");
+        }
+    }
+};
+
+}
+
+/*
+ * make_dir - create dir if it does not exist; return it
+ */
+static const std::string &make_dir(const std::string &dir){
+    struct stat st;
+
+    if(mkdir(dir.c_str(), 0755)<0 && errno!=EEXIST){
+        throw std::system_error(errno, std::generic_category(), "mkdir "+dir);
+    }
+    if(stat(dir.c_str(), &st)<0 || !S_ISDIR(st.st_mode)){
+        throw std::system_error(ENOTDIR, std::generic_category(), "crawl_store "+dir);
+    }
+    return dir;
+}
+
+crawl_store::crawl_store(const std::string &dir, const crawl_store_options &options)
+    : dir(make_dir(dir)), options(options), visited_(dir, options.expected, options.fp_rate, options.ram_urls),
+      frontier_(dir, options.segment_bytes), sequence(0), resumed_(false){
+}
+
+std::string crawl_store::filter_path(std::uint64_t seq) const {
+    char name[64];
+
+    std::snprintf(name, sizeof(name), "/filter-%08llu.bits", (unsigned long long)seq);
+    return dir+name;
+}
+
+bool crawl_store::open(){
+    std::string data;
+    std::uint64_t i, n, sum;
+
+    pending.clear();
+    stats=crawl_stats();
+    resumed_=false;
+    if(!read_file(dir+"/checkpoint", data)){
+        visited_.reset();
+        frontier_.reset();
+        remove_files(dir, "filter-", ".bits", [](std::uint64_t){ return false; });
+        sequence=0;
+        return false;
+    }
+    if(data.size()<=sizeof(sum)){
+        throw std::runtime_error("crawl_store: damaged checkpoint in "+dir);
+    }
+    std::memcpy(&sum, data.data()+data.size()-sizeof(sum), sizeof(sum));
+    data.resize(data.size()-sizeof(sum));
+    if(url_fingerprint(data)!=sum){
+        throw std::runtime_error("crawl_store: damaged checkpoint in "+dir);
+    }
+    reader r{data};
+    if(r.get64()!=CHECKPOINT_MAGIC){
+        throw std::runtime_error("crawl_store: no checkpoint in "+dir);
+    }
+    sequence=r.get64();
+    stats.pages=r.get64();
+    stats.errors=r.get64();
+    stats.duplicates=r.get64();
+    std::size_t urls=r.get64();
+    std::vector<std::uint64_t> runs(r.get64());
+    for(auto &number : runs){
+        number=r.get64();
+    }
+    log_position read, write;
+    read.segment=r.get64();
+    read.offset=r.get64();
+    write.segment=r.get64();
+    write.offset=r.get64();
+    std::size_t queued=r.get64();
+    n=r.get64();
+    for(i=0;i<n;i++){
+        std::uint64_t len=r.get64();
+        int depth=(int)r.get64();
+        pending.emplace_back(r.get(len), depth);
+    }
+
+    visited_.restore(runs, filter_path(sequence), urls);
+    frontier_.restore(read, write, queued);
+    remove_files(dir, "filter-", ".bits", [this](std::uint64_t seq){ return seq==sequence; });
+    resumed_=true;
+    return true;
+}
+
+/*
+ * checkpoint - make the runs, the filter and the frontier durable first, so that whatever the checkpoint
+ * names is on disk when the rename makes it the checkpoint
+ */
+void crawl_store::checkpoint(const std::vector<std::pair<std::string, int>> &tasks, const crawl_stats &counts){
+    std::uint64_t seq=sequence+1;
+    std::string data;
+
+    visited_.save(filter_path(seq));
+    frontier_.sync();
+    sync_dir(dir);
+
+    put64(data, CHECKPOINT_MAGIC);
+    put64(data, seq);
+    put64(data, counts.pages);
+    put64(data, counts.errors);
+    put64(data, counts.duplicates);
+    put64(data, visited_.size());
+    std::vector<std::uint64_t> runs=visited_.run_numbers();
+    put64(data, runs.size());
+    for(auto number : runs){
+        put64(data, number);
+    }
+    put64(data, frontier_.read_position().segment);
+    put64(data, frontier_.read_position().offset);
+    put64(data, frontier_.write_position().segment);
+    put64(data, frontier_.write_position().offset);
+    put64(data, frontier_.size());
+    put64(data, tasks.size());
+    for(auto &t : tasks){
+        put64(data, t.first.size());
+        put64(data, (std::uint64_t)(std::int64_t)t.second);
+        data+=t.first;
+    }
+    put64(data, url_fingerprint(data));
+    write_file_atomic(dir+"/checkpoint", data.data(), data.size());
+    sync_dir(dir);
+    sequence=seq;
+
+    visited_.release();
+    frontier_.release();
+    remove_files(dir, "filter-", ".bits", [seq](std::uint64_t n){ return n==seq; });
+}
+
+std::size_t crawl_store::disk_bytes() const {
+    return visited_.disk_bytes()+frontier_.disk_bytes();
+}
@@ -0,0 +1,88 @@
+/*
+ * crawl_store.hpp - the state of a crawl on disk, with checkpoints to resume it from after a crash
+ *
+ * The crawler of ../lec2.txt keeps everything in memory, and a crash loses the whole crawl. A crawl_store
+ * keeps it in a directory instead:
+ *     visited     a disk_visited_set, its fingerprints in memory up to ram_urls and in runs beyond
+ *     frontier    a frontier_log, for the tasks beyond the ram_tasks the engine keeps in memory
+ * and the engine (pipeline.hpp) calls checkpoint() every so often with the tasks it holds in memory (queued
+ * or in flight) and its counts. A checkpoint spills the visited set and saves its filter, syncs the frontier,
+ * and then writes the checkpoint file, naming the runs, the positions in the frontier and the tasks, by
+ * rename, so that either the old or the new one is there after a crash; only then are the files the old one
+ * needed and the new one does not deleted.
+ *
+ * open() loads the checkpoint, if there is one, and puts the runs and the frontier back as it left them;
+ * the crawl goes on from there, with the tasks it held (pending) queued again. The pages fetched since the
+ * checkpoint, and those in flight at it, are fetched again.
+ */
+#ifndef CRAWLER_CRAWL_STORE_HPP
+#define CRAWLER_CRAWL_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "crawler.hpp"
+#include "disk_visited_set.hpp"
+#include "frontier_log.hpp"
+
+struct crawl_store_options {
+    std::size_t expected=1<<20;         /*URLs the filter of the visited set is sized for*/
+    double fp_rate=0.01;                /*its false-positive rate (a false positive costs a lookup in the runs)*/
+    std::size_t ram_urls=1<<18;         /*fingerprints kept in memory before a run is spilled*/
+    std::size_t ram_tasks=1<<16;        /*tasks the engine keeps in memory before the frontier spills*/
+    std::size_t segment_bytes=8<<20;    /*bytes of a frontier segment*/
+};
+
+class crawl_store {
+public:
+    /*a store in dir (created if it does not exist); open() must be called before it is used*/
+    crawl_store(const std::string &dir, const crawl_store_options &options=crawl_store_options());
+
+    crawl_store(const crawl_store&)=delete;
+    crawl_store& operator=(const crawl_store&)=delete;
+
+    /*resume from the checkpoint in dir, if there is one (return true), or start afresh, deleting what a
+      crawl before left there*/
+    bool open();
+
+    /*the state of the checkpoint open() resumed from: the tasks the engine held, and its counts*/
+    bool resumed() const {
+        return resumed_;
+    }
+    std::vector<std::pair<std::string, int>> pending;
+    crawl_stats stats;
+
+    disk_visited_set &visited() {
+        return visited_;
+    }
+    frontier_log &frontier() {
+        return frontier_;
+    }
+    std::size_t ram_tasks() const {
+        return options.ram_tasks;
+    }
+
+    /*write a checkpoint of the store with the tasks the engine holds and its counts*/
+    void checkpoint(const std::vector<std::pair<std::string, int>> &tasks, const crawl_stats &stats);
+
+    /*the checkpoints written, and the bytes of the store on disk*/
+    std::uint64_t checkpoints() const {
+        return sequence;
+    }
+    std::size_t disk_bytes() const;
+
+private:
+    std::string dir;
+    crawl_store_options options;
+    disk_visited_set visited_;
+    frontier_log frontier_;
+    std::uint64_t sequence;             /*of the last checkpoint written or read*/
+    bool resumed_;
+
+    std::string filter_path(std::uint64_t seq) const;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * crawler.cpp - the work-stealing crawl pool (see crawler.hpp)
+ */
+#include <chrono>
+#include <thread>
+
+#include "crawler.hpp"
+
+/*Rounds a worker with nothing to do yields before it starts sleeping between its attempts to steal*/
+#define IDLE_SPINS 64
+#define IDLE_SLEEP std::chrono::microseconds(50)
+
+crawler::crawler(fetcher &f, visited_set &visited, unsigned workers)
+    : f(f), visited(visited), workers(workers>0 ? workers : 1), pending(0){
+    unsigned i;
+
+    for(i=0;i<this->workers;i++){
+        queues.emplace_back(new worker_queue);
+    }
+}
+
+void crawler::push(unsigned id, task &&t){
+    std::lock_guard<std::mutex> guard(queues[id]->lock);
+
+    queues[id]->tasks.push_back(std::move(t));
+}
+
+/*
+ * pop - take the newest task of our own deque. Return false if it is empty.
+ */
+bool crawler::pop(unsigned id, task &t){
+    std::lock_guard<std::mutex> guard(queues[id]->lock);
+
+    if(queues[id]->tasks.empty()){
+        return false;
+    }
+    t=std::move(queues[id]->tasks.back());
+    queues[id]->tasks.pop_back();
+    return true;
+}
+
+/*
+ * steal - take the oldest task of another worker, trying them all from a random one. Return false if
+ * every deque is empty.
+ */
+bool crawler::steal(unsigned id, unsigned long &rng, task &t){
+    unsigned i, victim;
+
+    rng^=rng<<13;
+    rng^=rng>>7;
+    rng^=rng<<17;
+    for(i=0;i<workers;i++){
+        victim=(rng+i)%workers;
+        if(victim==id){
+            continue;
+        }
+        std::lock_guard<std::mutex> guard(queues[victim]->lock);
+        if(!queues[victim]->tasks.empty()){
+            t=std::move(queues[victim]->tasks.front());
+            queues[victim]->tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * visit - fetch the page of task t, and claim and queue the pages it links to if they are not too deep.
+ */
+void crawler::visit(unsigned id, task &t, crawl_stats &stats, const page_callback &on_page){
+    fetch_result result=f.fetch(t.url);
+
+    if(on_page){
+        on_page(t.url, result);
+    }
+    if(!result.ok){
+        stats.errors++;
+        return;
+    }
+    stats.pages++;
+    if(t.depth<=1){
+        return;
+    }
+    for(auto &u : result.urls){
+        if(!visited.test_and_insert(u)){
+            stats.duplicates++;
+            continue;
+        }
+        /*counted before it is queued, so that pending never drops to 0 while work is left*/
+        pending.fetch_add(1, std::memory_order_relaxed);
+        push(id, task{std::move(u), t.depth-1});
+    }
+}
+
+/*
+ * work - the loop of worker id: fetch tasks until none is queued or being fetched anywhere.
+ */
+void crawler::work(unsigned id, const page_callback &on_page){
+    crawl_stats stats;
+    unsigned long rng=0x9e3779b97f4a7c15UL*(id+1);
+    unsigned idle=0;
+    bool found;
+    task t;
+
+    for(;;){
+        found=pop(id, t);
+        if(!found && steal(id, rng, t)){
+            stats.steals++;
+            found=true;
+        }
+        if(found){
+            idle=0;
+            visit(id, t, stats, on_page);
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+            continue;
+        }
+        if(pending.load(std::memory_order_acquire)==0){
+            break;
+        }
+        if(++idle<IDLE_SPINS){
+            std::this_thread::yield();
+        }else{
+            std::this_thread::sleep_for(IDLE_SLEEP);
+        }
+    }
+    std::lock_guard<std::mutex> guard(stats_lock);
+    totals.pages+=stats.pages;
+    totals.errors+=stats.errors;
+    totals.duplicates+=stats.duplicates;
+    totals.steals+=stats.steals;
+}
+
+crawl_stats crawler::crawl(const std::string &root, int depth, const page_callback &on_page){
+    std::vector<std::thread> threads;
+    unsigned i;
+
+    totals=crawl_stats();
+    if(depth<=0 || !visited.test_and_insert(root)){
+        return totals;
+    }
+    auto start=std::chrono::steady_clock::now();
+    pending.store(1);
+    push(0, task{root, depth});
+    for(i=0;i<workers;i++){
+        threads.emplace_back(&crawler::work, this, i, std::cref(on_page));
+    }
+    for(auto &th : threads){
+        th.join();
+    }
+    totals.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    return totals;
+}
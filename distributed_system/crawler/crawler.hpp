@@ -0,0 +1,77 @@
+/*
+ * crawler.hpp - a pool of crawl workers that share the pages to fetch by work stealing
+ *
+ * In ../lec2.txt every worker starts from the root and recurses on its own, so the workers repeat each
+ * other's work, and a worker whose part of the web runs out stops while others still have plenty. Here the
+ * pages to fetch are tasks (a URL and the depth left), claimed in the visited set (test_and_insert) when
+ * they are found, so that each is queued once. Every worker keeps a deque of tasks: it pushes the links it
+ * finds and pops the last one (depth first, like CrawlRecursive), and when its deque is empty it steals the
+ * oldest task of another worker, the one nearest the root and most likely to lead to more. The crawl is over
+ * when no task is queued or being fetched.
+ *
+ * Depth counts as in lec2.txt: the root is fetched at depth, the pages it links to at depth-1, and so on
+ * down to 1. A page is fetched once, at the depth it is first found at.
+ */
+#ifndef CRAWLER_CRAWLER_HPP
+#define CRAWLER_CRAWLER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "fetcher.hpp"
+#include "visited_set.hpp"
+
+struct crawl_stats {
+    std::size_t pages=0;        /*pages fetched*/
+    std::size_t errors=0;       /*fetches that failed*/
+    std::size_t duplicates=0;   /*links to pages already claimed*/
+    std::size_t steals=0;       /*tasks taken from another worker*/
+    double seconds=0;
+};
+
+class crawler {
+public:
+    /*called by the worker that fetched url, for every page (fetched or failed), from many threads at once*/
+    using page_callback=std::function<void(const std::string &url, const fetch_result &result)>;
+
+    crawler(fetcher &f, visited_set &visited, unsigned workers);
+
+    crawler(const crawler&)=delete;
+    crawler& operator=(const crawler&)=delete;
+
+    /*crawl from root down to depth, return when every page found has been fetched*/
+    crawl_stats crawl(const std::string &root, int depth, const page_callback &on_page=nullptr);
+
+private:
+    struct task {
+        std::string url;
+        int depth;
+    };
+
+    struct alignas(64) worker_queue {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    fetcher &f;
+    visited_set &visited;
+    unsigned workers;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::atomic<std::size_t> pending;   /*tasks queued or being fetched*/
+    std::mutex stats_lock;
+    crawl_stats totals;
+
+    void work(unsigned id, const page_callback &on_page);
+    void visit(unsigned id, task &t, crawl_stats &stats, const page_callback &on_page);
+    bool pop(unsigned id, task &t);
+    bool steal(unsigned id, unsigned long &rng, task &t);
+    void push(unsigned id, task &&t);
+};
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * disk_visited_set.cpp - the visited set spilling to runs on disk (see disk_visited_set.hpp)
+ */
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "disk_visited_set.hpp"
+
+#define MAX_RUNS 16
+/*Fingerprints a merge writes between syncing and dropping from memory what it has written and read*/
+#define MERGE_CHUNK (1<<20)
+
+disk_visited_set::disk_visited_set(const std::string &dir, std::size_t expected, double fp_rate, std::size_t ram_urls)
+    : dir(dir), ram_urls(std::max<std::size_t>(1, ram_urls)), filter(expected, fp_rate), recent(this->ram_urls),
+      next_run(0), count(0){
+}
+
+std::string disk_visited_set::run_path(std::uint64_t n) const {
+    char name[64];
+
+    std::snprintf(name, sizeof(name), "/visited-%08llu.run", (unsigned long long)n);
+    return dir+name;
+}
+
+bool disk_visited_set::in_runs(std::uint64_t fp) const {
+    for(auto &r : runs){
+        if(std::binary_search(r.fingerprints(), r.fingerprints()+r.n, fp)){
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * test_and_insert - a fingerprint the filter has seen is new only if it is neither in memory nor in a run
+ * (the filter was wrong)
+ */
+bool disk_visited_set::test_and_insert(std::string_view url){
+    std::uint64_t fp=url_fingerprint(url);
+    std::lock_guard<std::mutex> guard(lock);
+
+    if(!filter.insert(fp) && (recent.contains(fp) || in_runs(fp))){
+        return false;
+    }
+    recent.insert_new(fp);
+    count++;
+    if(recent.size()>=ram_urls){
+        spill();
+    }
+    return true;
+}
+
+bool disk_visited_set::contains(std::string_view url) const {
+    std::uint64_t fp=url_fingerprint(url);
+    std::lock_guard<std::mutex> guard(lock);
+
+    return filter.contains(fp) && (recent.contains(fp) || in_runs(fp));
+}
+
+std::size_t disk_visited_set::size() const {
+    std::lock_guard<std::mutex> guard(lock);
+
+    return count;
+}
+
+/*
+ * spill - sort the fingerprints in memory in place in a new run, sync it and start memory over; then merge
+ * while the last run is no smaller than the one before it (or there are too many)
+ */
+void disk_visited_set::spill(){
+    std::size_t n=recent.size();
+    std::uint64_t number=next_run;
+
+    if(n==0){
+        return;
+    }
+    next_run++;
+    run r{number, mapped_file(run_path(number), n*sizeof(std::uint64_t), true), n};
+    std::uint64_t *fps=(std::uint64_t*)r.file.data();
+    recent.copy_to(fps);
+    std::sort(fps, fps+n);
+    r.file.sync(0, r.file.size());
+    r.file.release_pages();
+    runs.push_back(std::move(r));
+    recent=fingerprint_table(ram_urls);
+    while(runs.size()>=2 && (runs[runs.size()-2].n<=runs.back().n || runs.size()>MAX_RUNS)){
+        merge_last();
+    }
+}
+
+/*
+ * merge_last - merge the last two runs into a new one, a chunk at a time so that no more than a few chunks
+ * of them are in memory. No fingerprint is in both (it would have been found in the first).
+ */
+void disk_visited_set::merge_last(){
+    run &a=runs[runs.size()-2], &b=runs.back();
+    std::size_t n=a.n+b.n, i=0, j=0, k=0, done=0;
+    std::uint64_t number=next_run++;
+    run out{number, mapped_file(run_path(number), n*sizeof(std::uint64_t), true), n};
+    std::uint64_t *o=(std::uint64_t*)out.file.data();
+    const std::uint64_t *x=a.fingerprints(), *y=b.fingerprints();
+
+    while(k<n){
+        o[k++]=(j>=b.n || (i<a.n && x[i]<y[j])) ? x[i++] : y[j++];
+        if(k-done==MERGE_CHUNK || k==n){
+            out.file.sync(done*sizeof(std::uint64_t), k*sizeof(std::uint64_t));
+            out.file.release_pages(done*sizeof(std::uint64_t), k*sizeof(std::uint64_t));
+            a.file.release_pages(0, i*sizeof(std::uint64_t));
+            b.file.release_pages(0, j*sizeof(std::uint64_t));
+            done=k;
+        }
+    }
+    obsolete.push_back(a.number);
+    obsolete.push_back(b.number);
+    runs.pop_back();
+    runs.back()=std::move(out);
+}
+
+void disk_visited_set::save(const std::string &filter_path){
+    std::lock_guard<std::mutex> guard(lock);
+
+    spill();
+    filter.save(filter_path);
+}
+
+std::vector<std::uint64_t> disk_visited_set::run_numbers() const {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::uint64_t> numbers;
+
+    for(auto &r : runs){
+        numbers.push_back(r.number);
+    }
+    return numbers;
+}
+
+void disk_visited_set::restore(const std::vector<std::uint64_t> &numbers, const std::string &filter_path,
+                               std::size_t n){
+    std::lock_guard<std::mutex> guard(lock);
+
+    runs.clear();
+    obsolete.clear();
+    remove_files(dir, "visited-", ".run", [&](std::uint64_t r){
+        return std::find(numbers.begin(), numbers.end(), r)!=numbers.end();
+    });
+    next_run=0;
+    for(auto number : numbers){
+        mapped_file f(run_path(number), 0, false);
+        std::size_t size=f.size()/sizeof(std::uint64_t);
+        runs.push_back(run{number, std::move(f), size});
+        next_run=std::max(next_run, number+1);
+    }
+    if(!filter.load(filter_path)){
+        throw std::runtime_error("disk_visited_set: no filter of this size in "+filter_path);
+    }
+    recent=fingerprint_table(ram_urls);
+    count=n;
+}
+
+void disk_visited_set::reset(){
+    std::lock_guard<std::mutex> guard(lock);
+
+    runs.clear();
+    obsolete.clear();
+    remove_files(dir, "visited-", ".run", [](std::uint64_t){ return false; });
+    filter.clear();
+    recent=fingerprint_table(ram_urls);
+    next_run=0;
+    count=0;
+}
+
+void disk_visited_set::release(){
+    std::lock_guard<std::mutex> guard(lock);
+
+    for(auto number : obsolete){
+        unlink(run_path(number).c_str());
+    }
+    obsolete.clear();
+    for(auto &r : runs){
+        r.file.release_pages();
+    }
+}
+
+std::size_t disk_visited_set::disk_bytes() const {
+    std::lock_guard<std::mutex> guard(lock);
+    std::size_t total=0;
+
+    for(auto &r : runs){
+        total+=r.file.size();
+    }
+    return total;
+}
+
+std::size_t disk_visited_set::memory_bytes() const {
+    std::lock_guard<std::mutex> guard(lock);
+
+    return filter.memory_bytes()+recent.memory_bytes();
+}
+
+std::size_t disk_visited_set::run_count() const {
+    std::lock_guard<std::mutex> guard(lock);
+
+    return runs.size();
+}
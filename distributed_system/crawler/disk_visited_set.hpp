@@ -0,0 +1,92 @@
+/*
+ * disk_visited_set.hpp - a visited set that keeps most of its fingerprints on disk
+ *
+ * bloom_visited_set (visited_set.hpp) with its exact tier takes some 20 bytes per URL, all of them in
+ * memory. disk_visited_set keeps only the filter (a few bits per URL) and the fingerprints of up to
+ * ram_urls URLs in memory. When that many are there, it spills them: sorted, they are written to a new
+ * run, a file of fingerprints (visited-<n>.run in the directory), and the memory starts over. A URL the
+ * filter has not seen is new, as in bloom_visited_set; one it may have is looked up in memory and then by
+ * binary search in each run, mapped (mapped_file.hpp) so that only the pages searched are read.
+ *
+ * Runs are merged like the digits of a binary counter: a run no larger than the one after it is merged
+ * into it, which keeps a run count about log2 of the number of spills for a write cost of log2 of it per
+ * fingerprint (and no more than MAX_RUNS in any case). A run merged away is only deleted by release(), once a
+ * checkpoint no longer needs it.
+ *
+ * One lock guards the whole set: it is meant for the pipelined engine (pipeline.hpp), whose one thread
+ * makes all the calls.
+ */
+#ifndef CRAWLER_DISK_VISITED_SET_HPP
+#define CRAWLER_DISK_VISITED_SET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bloom_filter.hpp"
+#include "fingerprint.hpp"
+#include "mapped_file.hpp"
+#include "visited_set.hpp"
+
+class disk_visited_set : public visited_set {
+public:
+    /*a set in dir (which must exist), its filter sized for expected URLs at fp_rate, spilling every
+      ram_urls; to be started with reset() or restore()*/
+    disk_visited_set(const std::string &dir, std::size_t expected, double fp_rate, std::size_t ram_urls);
+
+    bool test_and_insert(std::string_view url) override;
+    bool contains(std::string_view url) const override;
+    std::size_t size() const override;
+
+    /*
+     * For checkpoints (crawl_store.hpp): save spills what is in memory and writes the filter to
+     * filter_path, after which the set is the runs of run_numbers() and the filter, and restore goes back
+     * to such a state, deleting the runs that are not in it.
+     */
+    void save(const std::string &filter_path);
+    std::vector<std::uint64_t> run_numbers() const;
+    void restore(const std::vector<std::uint64_t> &runs, const std::string &filter_path, std::size_t count);
+
+    /*empty the set, deleting all the runs in dir*/
+    void reset();
+
+    /*delete the runs merged away, and drop the pages of the runs from memory*/
+    void release();
+
+    /*the bytes of the runs on disk, and the bytes the set takes in memory (filter and fingerprint table)*/
+    std::size_t disk_bytes() const;
+    std::size_t memory_bytes() const;
+
+    std::size_t run_count() const;
+
+private:
+    struct run {
+        std::uint64_t number;
+        mapped_file file;
+        std::size_t n;
+
+        const std::uint64_t *fingerprints() const {
+            return (const std::uint64_t*)file.data();
+        }
+    };
+
+    std::string dir;
+    std::size_t ram_urls;
+    mutable std::mutex lock;
+    bloom_filter filter;
+    fingerprint_table recent;           /*the fingerprints not spilled yet*/
+    std::vector<run> runs;              /*oldest (and largest) first*/
+    std::vector<std::uint64_t> obsolete;    /*runs merged away, to delete*/
+    std::uint64_t next_run;
+    std::size_t count;
+
+    std::string run_path(std::uint64_t n) const;
+    bool in_runs(std::uint64_t fp) const;
+    void spill();
+    void merge_last();
+};
+
+#endif
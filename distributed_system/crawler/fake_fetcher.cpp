@@ -0,0 +1,153 @@
+/*
+ * fake_fetcher.cpp - fetchers that answer from memory (see fake_fetcher.hpp)
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+
+#include "fake_fetcher.hpp"
+
+void fake_fetcher::add(const std::string &url, const std::string &body, const std::vector<std::string> &urls){
+    pages[url]=page{body, urls};
+}
+
+fetch_result fake_fetcher::fetch(const std::string &url){
+    fetch_result result;
+
+    if(latency.count()>0){
+        std::this_thread::sleep_for(latency);
+    }
+    auto it=pages.find(url);
+    if(it==pages.end()){
+        result.error="not found: "+url;
+        return result;
+    }
+    result.ok=true;
+    result.body=it->second.body;
+    result.urls=it->second.urls;
+    return result;
+}
+
+fake_fetcher fake_fetcher::golang(std::chrono::microseconds latency){
+    fake_fetcher f(latency);
+
+    f.add("https://golang.org/", "The Go Programming Language",
+          {"https://golang.org/pkg/", "https://golang.org/cmd/"});
+    f.add("https://golang.org/pkg/", "Packages",
+          {"https://golang.org/", "https://golang.org/cmd/", "https://golang.org/pkg/fmt/", "https://golang.org/pkg/os/"});
+    f.add("https://golang.org/pkg/fmt/", "Package fmt",
+          {"https://golang.org/", "https://golang.org/pkg/"});
+    f.add("https://golang.org/pkg/os/", "Package os",
+          {"https://golang.org/", "https://golang.org/pkg/"});
+    return f;
+}
+
+/*
+ * mix - a 64-bit hash of x (the finalizer of splitmix64), to pick the links of a page
+ */
+static inline std::uint64_t mix(std::uint64_t x){
+    x^=x>>30;
+    x*=0xbf58476d1ce4e5b9ULL;
+    x^=x>>27;
+    x*=0x94d049bb133111ebULL;
+    x^=x>>31;
+    return x;
+}
+
+synthetic_fetcher::synthetic_fetcher(std::size_t pages, std::size_t fanout, std::size_t hosts,
+                                     std::chrono::microseconds latency, std::size_t missing_every)
+    : pages(pages>0 ? pages : 1), fanout(fanout), hosts(hosts>0 ? hosts : 1), missing_every(missing_every), latency(latency){
+}
+
+std::string synthetic_fetcher::url(std::size_t n) const {
+    return "http://host"+std::to_string(n%hosts)+".example/page/"+std::to_string(n);
+}
+
+/*
+ * fetch - the page whose number ends the URL. Its first two links are to pages 2n+1 and 2n+2, so that every
+ * page can be reached from the root within log2(pages) links; the others are to pages picked by a hash.
+ */
+fetch_result synthetic_fetcher::fetch(const std::string &url){
+    fetch_result result;
+    std::size_t slash, n, i, target;
+    char *end;
+
+    if(latency.count()>0){
+        std::this_thread::sleep_for(latency);
+    }
+    n=pages;
+    slash=url.rfind('/');
+    if(slash!=std::string::npos && slash+1<url.size()){
+        n=std::strtoull(url.c_str()+slash+1, &end, 10);
+        if(*end!='\0'){
+            n=pages;
+        }
+    }
+    if(n>=pages || (missing_every>0 && n%missing_every==missing_every-1)){
+        result.error="not found: "+url;
+        return result;
+    }
+    result.ok=true;
+    result.body="page "+std::to_string(n);
+    result.urls.reserve(fanout);
+    for(i=0;i<fanout;i++){
+        target=i<2 ? 2*n+1+i : mix(n*fanout+i)%pages;
+        if(target<pages){
+            result.urls.push_back(this->url(target));
+        }
+    }
+    return result;
+}
+
+fake_async_fetcher::fake_async_fetcher(fetcher &pages, std::chrono::microseconds latency)
+    : pages(pages), latency(latency), stopping(false){
+    timer=std::thread(&fake_async_fetcher::run, this);
+}
+
+fake_async_fetcher::~fake_async_fetcher(){
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping=true;
+    }
+    queued.notify_one();
+    timer.join();
+}
+
+void fake_async_fetcher::fetch_async(const std::string &url, fetch_callback done){
+    bool first;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        first=requests.empty();
+        requests.push_back(request{std::chrono::steady_clock::now()+latency, url, std::move(done)});
+    }
+    if(first){
+        queued.notify_one();
+    }
+}
+
+/*
+ * run - the timer thread: wait until the oldest request is due, then fetch it and call back, outside the
+ * lock so that the callback may start more fetches
+ */
+void fake_async_fetcher::run(){
+    std::unique_lock<std::mutex> guard(lock);
+
+    for(;;){
+        if(requests.empty()){
+            if(stopping){
+                return;
+            }
+            queued.wait(guard);
+            continue;
+        }
+        if(std::chrono::steady_clock::now()<requests.front().due){
+            queued.wait_until(guard, requests.front().due);
+            continue;
+        }
+        request r=std::move(requests.front());
+        requests.pop_front();
+        guard.unlock();
+        r.done(pages.fetch(r.url));
+        guard.lock();
+    }
+}
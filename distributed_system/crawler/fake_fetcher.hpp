@@ -0,0 +1,111 @@
+/*
+ * fake_fetcher.hpp - fetchers that answer from memory, with a latency of their own, for tests and benchmarks
+ *
+ * fake_fetcher returns canned pages, like the fakeFetcher of ../lec2.txt (fake_fetcher::golang() is the
+ * same four pages). synthetic_fetcher makes up a web of any size instead: pages spread over hosts, each
+ * linking to a few others picked by a hash of its number, so that every crawl of it finds the same pages.
+ *
+ * Both wait for their latency in every fetch (the thread sleeps, as it would on the network), so crawls
+ * with more workers than cores can be measured.
+ *
+ * fake_async_fetcher gives any fetcher the latency of a network without a thread per fetch: fetch_async
+ * queues the URL and returns, and one timer thread fetches it (with the fetcher's own latency, best 0) and
+ * calls back once the latency is up. The latency is the same for every fetch, so the queue is in order of
+ * the time each is due.
+ */
+#ifndef CRAWLER_FAKE_FETCHER_HPP
+#define CRAWLER_FAKE_FETCHER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "fetcher.hpp"
+
+class fake_fetcher : public fetcher {
+public:
+    explicit fake_fetcher(std::chrono::microseconds latency=std::chrono::microseconds(0)) : latency(latency){
+    }
+
+    /*add a page (not while fetches are running)*/
+    void add(const std::string &url, const std::string &body, const std::vector<std::string> &urls);
+
+    fetch_result fetch(const std::string &url) override;
+
+    /*the pages of the fakeFetcher in ../lec2.txt*/
+    static fake_fetcher golang(std::chrono::microseconds latency=std::chrono::microseconds(0));
+
+private:
+    struct page {
+        std::string body;
+        std::vector<std::string> urls;
+    };
+
+    std::chrono::microseconds latency;
+    std::unordered_map<std::string, page> pages;
+};
+
+class synthetic_fetcher : public fetcher {
+public:
+    /*pages pages on hosts hosts, each with fanout links; missing_every>0 makes every such page fail (0: none)*/
+    synthetic_fetcher(std::size_t pages, std::size_t fanout, std::size_t hosts,
+                      std::chrono::microseconds latency=std::chrono::microseconds(0), std::size_t missing_every=0);
+
+    fetch_result fetch(const std::string &url) override;
+
+    /*the URL of page n, and the first page to crawl*/
+    std::string url(std::size_t n) const;
+    std::string root() const {
+        return url(0);
+    }
+
+    std::size_t size() const {
+        return pages;
+    }
+
+    void set_latency(std::chrono::microseconds l){
+        latency=l;
+    }
+
+private:
+    std::size_t pages, fanout, hosts, missing_every;
+    std::chrono::microseconds latency;
+};
+
+class fake_async_fetcher : public async_fetcher {
+public:
+    fake_async_fetcher(fetcher &pages, std::chrono::microseconds latency);
+
+    /*waits for the fetches in flight to be called back*/
+    ~fake_async_fetcher();
+
+    fake_async_fetcher(const fake_async_fetcher&)=delete;
+    fake_async_fetcher& operator=(const fake_async_fetcher&)=delete;
+
+    void fetch_async(const std::string &url, fetch_callback done) override;
+
+private:
+    struct request {
+        std::chrono::steady_clock::time_point due;
+        std::string url;
+        fetch_callback done;
+    };
+
+    fetcher &pages;
+    std::chrono::microseconds latency;
+    std::mutex lock;
+    std::condition_variable queued;
+    std::deque<request> requests;
+    bool stopping;
+    std::thread timer;
+
+    void run();
+};
+
+#endif
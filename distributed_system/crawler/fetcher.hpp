@@ -0,0 +1,41 @@
+/*
+ * fetcher.hpp - what the crawler fetches pages with (the Fetcher interface of ../lec2.txt)
+ *
+ * fetch returns the body of a page and the URLs found on it, or an error. It is called by many
+ * crawl workers at once, so an implementation must be safe to call concurrently.
+ *
+ * async_fetcher starts a fetch and returns at once; the result is handed to a callback when the page
+ * arrives, so that one thread can keep thousands of fetches in flight instead of one per worker.
+ */
+#ifndef CRAWLER_FETCHER_HPP
+#define CRAWLER_FETCHER_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct fetch_result {
+    bool ok=false;
+    std::string body;
+    std::vector<std::string> urls;
+    std::string error;          /*why the fetch failed, if !ok*/
+};
+
+class fetcher {
+public:
+    virtual ~fetcher()=default;
+
+    virtual fetch_result fetch(const std::string &url)=0;
+};
+
+class async_fetcher {
+public:
+    /*called once per fetch_async, from a thread of the fetcher (or from fetch_async itself)*/
+    using fetch_callback=std::function<void(fetch_result &&result)>;
+
+    virtual ~async_fetcher()=default;
+
+    virtual void fetch_async(const std::string &url, fetch_callback done)=0;
+};
+
+#endif
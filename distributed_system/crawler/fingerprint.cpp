@@ -0,0 +1,123 @@
+/*
+ * fingerprint.cpp - URL fingerprints and the fingerprint table (see fingerprint.hpp)
+ */
+#include <cstring>
+
+#include "fingerprint.hpp"
+
+#define MIN_SLOTS 16
+
+/*
+ * mix - the finalizer of murmur3's 64-bit hash: every bit of x affects every bit of the result
+ */
+static inline std::uint64_t mix(std::uint64_t x){
+    x^=x>>33;
+    x*=0xff51afd7ed558ccdULL;
+    x^=x>>33;
+    x*=0xc4ceb9fe1a85ec53ULL;
+    x^=x>>33;
+    return x;
+}
+
+/*
+ * url_fingerprint - hash url 8 bytes at a time, each word folded into the state and mixed in. The length
+ * goes into the seed, so that URLs which differ only by trailing zero bytes differ.
+ */
+std::uint64_t url_fingerprint(std::string_view url){
+    const char *p=url.data();
+    std::size_t len=url.size();
+    std::uint64_t h=0x243f6a8885a308d3ULL^(len*0x9e3779b97f4a7c15ULL), w;
+
+    while(len>=8){
+        std::memcpy(&w, p, 8);
+        h=mix(h^w);
+        p+=8;
+        len-=8;
+    }
+    if(len>0){
+        w=0;
+        std::memcpy(&w, p, len);
+        h=mix(h^w);
+    }
+    h=mix(h);
+    return h!=0 ? h : 1;
+}
+
+fingerprint_table::fingerprint_table(std::size_t expected) : used(0){
+    std::size_t count=MIN_SLOTS;
+
+    shift=64-4;
+    while(count/4*3<expected){
+        count*=2;
+        shift--;
+    }
+    mask=count-1;
+    slots.reset(new std::uint64_t[count]());
+}
+
+/*
+ * grow - double the slots and insert the fingerprints again
+ */
+void fingerprint_table::grow(){
+    std::unique_ptr<std::uint64_t[]> old=std::move(slots);
+    std::size_t count=mask+1, i, s;
+
+    mask=2*count-1;
+    shift--;
+    slots.reset(new std::uint64_t[2*count]());
+    for(i=0;i<count;i++){
+        if(old[i]==0){
+            continue;
+        }
+        for(s=slot_of(old[i]);slots[s]!=0;s=(s+1)&mask){
+        }
+        slots[s]=old[i];
+    }
+}
+
+bool fingerprint_table::insert(std::uint64_t fp){
+    std::size_t s;
+
+    for(s=slot_of(fp);slots[s]!=0;s=(s+1)&mask){
+        if(slots[s]==fp){
+            return false;
+        }
+    }
+    slots[s]=fp;
+    if(++used>(mask+1)/4*3){
+        grow();
+    }
+    return true;
+}
+
+void fingerprint_table::insert_new(std::uint64_t fp){
+    std::size_t s;
+
+    for(s=slot_of(fp);slots[s]!=0;s=(s+1)&mask){
+    }
+    slots[s]=fp;
+    if(++used>(mask+1)/4*3){
+        grow();
+    }
+}
+
+bool fingerprint_table::contains(std::uint64_t fp) const {
+    std::size_t s;
+
+    for(s=slot_of(fp);slots[s]!=0;s=(s+1)&mask){
+        if(slots[s]==fp){
+            return true;
+        }
+    }
+    return false;
+}
+
+void fingerprint_table::copy_to(std::uint64_t *out) const {
+    std::size_t i;
+
+    for(i=0;i<=mask;i++){
+        if(slots[i]!=0){
+            *out++=slots[i];
+        }
+    }
+}
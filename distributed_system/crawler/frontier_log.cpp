@@ -0,0 +1,142 @@
+/*
+ * frontier_log.cpp - the frontier on disk (see frontier_log.hpp)
+ */
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "frontier_log.hpp"
+
+#define RECORD_HEADER 8
+#define MIN_SEGMENT_BYTES 65536
+
+frontier_log::frontier_log(const std::string &dir, std::size_t segment_bytes)
+    : dir(dir), segment_bytes(segment_bytes<MIN_SEGMENT_BYTES ? MIN_SEGMENT_BYTES : segment_bytes), count(0), first(0),
+      synced(0){
+}
+
+std::string frontier_log::segment_path(std::uint64_t n) const {
+    char name[64];
+
+    std::snprintf(name, sizeof(name), "/frontier-%08llu.seg", (unsigned long long)n);
+    return dir+name;
+}
+
+void frontier_log::open_writer(){
+    write_seg=mapped_file(segment_path(writer.segment), segment_bytes, true);
+    synced=writer.offset;
+}
+
+void frontier_log::open_reader(){
+    if(reader.segment==writer.segment){
+        read_seg.unmap();       /*read through write_seg*/
+    }else{
+        read_seg=mapped_file(segment_path(reader.segment), 0, false);
+    }
+}
+
+void frontier_log::reset(){
+    read_seg.unmap();
+    write_seg.unmap();
+    remove_files(dir, "frontier-", ".seg", [](std::uint64_t){ return false; });
+    reader=writer=log_position();
+    count=0;
+    first=0;
+    open_writer();
+    open_reader();
+}
+
+/*
+ * push - append the record; when it does not fit, seal the segment (sync it all, the zeros after its last
+ * record marking its end) and go on in the next
+ */
+void frontier_log::push(std::string_view url, int depth){
+    std::uint32_t len=(std::uint32_t)url.size();
+    std::int32_t d=depth;
+
+    if(len==0 || RECORD_HEADER+len>segment_bytes){
+        throw std::length_error("frontier_log: URL of "+std::to_string(url.size())+" bytes");
+    }
+    if(writer.offset+RECORD_HEADER+len>segment_bytes){
+        write_seg.sync(synced, writer.offset);
+        writer.segment++;
+        writer.offset=0;
+        open_writer();
+        if(reader.segment==writer.segment-1 && !read_seg.mapped()){
+            read_seg=mapped_file(segment_path(reader.segment), 0, false);
+        }
+    }
+    char *p=write_seg.data()+writer.offset;
+    std::memcpy(p, &len, 4);
+    std::memcpy(p+4, &d, 4);
+    std::memcpy(p+RECORD_HEADER, url.data(), len);
+    writer.offset+=RECORD_HEADER+len;
+    count++;
+}
+
+bool frontier_log::pop(std::string &url, int &depth){
+    std::uint32_t len=0;
+    std::int32_t d;
+
+    if(count==0){
+        return false;
+    }
+    for(;;){
+        const mapped_file &seg=reader.segment==writer.segment ? write_seg : read_seg;
+        if(reader.offset+RECORD_HEADER<=seg.size()){
+            std::memcpy(&len, seg.data()+reader.offset, 4);
+        }else{
+            len=0;
+        }
+        if(len!=0){
+            std::memcpy(&d, seg.data()+reader.offset+4, 4);
+            url.assign(seg.data()+reader.offset+RECORD_HEADER, len);
+            depth=d;
+            reader.offset+=RECORD_HEADER+len;
+            count--;
+            return true;
+        }
+        /*the end of a sealed segment*/
+        reader.segment++;
+        reader.offset=0;
+        open_reader();
+    }
+}
+
+void frontier_log::sync(){
+    write_seg.sync(synced, writer.offset);
+    synced=writer.offset;
+}
+
+void frontier_log::release(){
+    for(;first<reader.segment;first++){
+        unlink(segment_path(first).c_str());
+    }
+}
+
+/*
+ * restore - delete the segments outside the saved ones, and zero the written segment after the saved end,
+ * where records pushed after the checkpoint would otherwise be read as part of it
+ */
+void frontier_log::restore(log_position read, log_position write, std::size_t n){
+    read_seg.unmap();
+    write_seg.unmap();
+    remove_files(dir, "frontier-", ".seg", [&](std::uint64_t n){
+        return n>=read.segment && n<=write.segment;
+    });
+    reader=read;
+    writer=write;
+    count=n;
+    first=read.segment;
+    open_writer();
+    std::memset(write_seg.data()+writer.offset, 0, segment_bytes-writer.offset);
+    write_seg.sync(writer.offset, segment_bytes);
+    synced=writer.offset;
+    open_reader();
+}
+
+std::size_t frontier_log::disk_bytes() const {
+    return (writer.segment-first+1)*segment_bytes;
+}
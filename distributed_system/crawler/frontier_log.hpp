@@ -0,0 +1,85 @@
+/*
+ * frontier_log.hpp - the part of the crawl frontier that does not fit in memory, in files on disk
+ *
+ * The tasks (a URL and its depth left) are appended to segment files of segment_bytes each, named
+ * frontier-<n>.seg in the directory, and read back in the order they were appended. A segment is a mapped
+ * file (mapped_file.hpp) holding records of
+ *     length      4 bytes, the bytes of the URL (0: the rest of the segment is unused)
+ *     depth       4 bytes
+ *     url         length bytes
+ * one after the other; a record that does not fit in what is left of a segment goes to the next one. Only
+ * the segment being written and the one being read are mapped, so the log takes two segments of memory at
+ * most, however long it is.
+ *
+ * The positions of the reader and the writer (a segment and an offset in it) and the number of tasks between
+ * them are the state of the log, which a checkpoint saves (sync first, so that the records are in the files)
+ * and restore() goes back to. Segments wholly read are only deleted by release(), once a checkpoint no longer
+ * needs them.
+ */
+#ifndef CRAWLER_FRONTIER_LOG_HPP
+#define CRAWLER_FRONTIER_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.hpp"
+
+struct log_position {
+    std::uint64_t segment=0;
+    std::uint64_t offset=0;
+};
+
+class frontier_log {
+public:
+    /*a log in dir (which must exist), to be started with reset() or restore()*/
+    frontier_log(const std::string &dir, std::size_t segment_bytes);
+
+    void push(std::string_view url, int depth);
+
+    /*the oldest task not read yet; false if there is none*/
+    bool pop(std::string &url, int &depth);
+
+    /*the tasks pushed and not read yet*/
+    std::size_t size() const {
+        return count;
+    }
+
+    log_position read_position() const {
+        return reader;
+    }
+    log_position write_position() const {
+        return writer;
+    }
+
+    /*make the records pushed so far durable*/
+    void sync();
+
+    /*go back to the state saved by a checkpoint, dropping what was pushed after it*/
+    void restore(log_position read, log_position write, std::size_t count);
+
+    /*delete the segments before the reader's*/
+    void release();
+
+    /*empty the log, deleting all the segments in dir*/
+    void reset();
+
+    /*the bytes of the segments on disk*/
+    std::size_t disk_bytes() const;
+
+private:
+    std::string dir;
+    std::size_t segment_bytes;
+    log_position reader, writer;
+    std::size_t count;
+    std::uint64_t first;            /*the oldest segment not deleted*/
+    mapped_file write_seg, read_seg;
+    std::size_t synced;             /*the bytes of write_seg synced*/
+
+    std::string segment_path(std::uint64_t n) const;
+    void open_writer();
+    void open_reader();
+};
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * mapped_file.cpp - files mapped into memory, and durable whole-file writes (see mapped_file.hpp)
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+#include "mapped_file.hpp"
+
+static void fail(const std::string &what, const std::string &path){
+    throw std::system_error(errno, std::generic_category(), what+" "+path);
+}
+
+mapped_file::mapped_file(const std::string &path, std::size_t size, bool writable) : path(path){
+    struct stat st;
+    int fd;
+    void *p;
+
+    fd=open(path.c_str(), writable ? O_RDWR|O_CREAT : O_RDONLY, 0644);
+    if(fd<0){
+        fail("open", path);
+    }
+    if(writable){
+        if(fstat(fd, &st)<0 || ((std::size_t)st.st_size!=size && ftruncate(fd, size)<0)){
+            close(fd);
+            fail("resize", path);
+        }
+    }else{
+        if(fstat(fd, &st)<0){
+            close(fd);
+            fail("stat", path);
+        }
+        size=st.st_size;
+    }
+    if(size>0){
+        p=mmap(nullptr, size, writable ? PROT_READ|PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if(p==MAP_FAILED){
+            close(fd);
+            fail("mmap", path);
+        }
+        base=(char*)p;
+    }
+    length=size;
+    close(fd);
+}
+
+mapped_file::~mapped_file(){
+    unmap();
+}
+
+mapped_file::mapped_file(mapped_file &&other) noexcept : base(other.base), length(other.length), path(std::move(other.path)){
+    other.base=nullptr;
+    other.length=0;
+}
+
+mapped_file& mapped_file::operator=(mapped_file &&other) noexcept {
+    if(this!=&other){
+        unmap();
+        base=other.base;
+        length=other.length;
+        path=std::move(other.path);
+        other.base=nullptr;
+        other.length=0;
+    }
+    return *this;
+}
+
+void mapped_file::unmap(){
+    if(base!=nullptr){
+        munmap(base, length);
+        base=nullptr;
+    }
+    length=0;
+}
+
+/*
+ * sync - msync wants a page-aligned start, so from is rounded down to its page
+ */
+void mapped_file::sync(std::size_t from, std::size_t to){
+    std::size_t page=sysconf(_SC_PAGESIZE);
+
+    if(base==nullptr || to<=from){
+        return;
+    }
+    from&=~(page-1);
+    if(msync(base+from, to-from, MS_SYNC)<0){
+        fail("msync", path);
+    }
+}
+
+/*
+ * release_pages - the pages wholly inside the range only, so that bytes around it stay in memory
+ */
+void mapped_file::release_pages(std::size_t from, std::size_t to){
+    std::size_t page=sysconf(_SC_PAGESIZE);
+
+    to=to<length ? to&~(page-1) : length;
+    from=(from+page-1)&~(page-1);
+    if(base!=nullptr && from<to){
+        madvise(base+from, to-from, MADV_DONTNEED);
+    }
+}
+
+void write_file_atomic(const std::string &path, const void *data, std::size_t size){
+    std::string tmp=path+".tmp";
+    const char *p=(const char*)data;
+    ssize_t n;
+    int fd;
+
+    fd=open(tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(fd<0){
+        fail("open", tmp);
+    }
+    while(size>0){
+        n=write(fd, p, size);
+        if(n<0 && errno==EINTR){
+            continue;
+        }
+        if(n<0){
+            close(fd);
+            fail("write", tmp);
+        }
+        p+=n;
+        size-=n;
+    }
+    if(fsync(fd)<0){
+        close(fd);
+        fail("fsync", tmp);
+    }
+    close(fd);
+    if(rename(tmp.c_str(), path.c_str())<0){
+        fail("rename", tmp);
+    }
+}
+
+bool read_file(const std::string &path, std::string &out){
+    char buf[65536];
+    ssize_t n;
+    int fd;
+
+    fd=open(path.c_str(), O_RDONLY);
+    if(fd<0){
+        if(errno==ENOENT){
+            return false;
+        }
+        fail("open", path);
+    }
+    out.clear();
+    while((n=read(fd, buf, sizeof(buf)))!=0){
+        if(n<0 && errno==EINTR){
+            continue;
+        }
+        if(n<0){
+            close(fd);
+            fail("read", path);
+        }
+        out.append(buf, n);
+    }
+    close(fd);
+    return true;
+}
+
+void remove_files(const std::string &dir, const char *prefix, const char *suffix,
+                  const std::function<bool(std::uint64_t n)> &keep){
+    std::size_t plen=std::strlen(prefix), slen=std::strlen(suffix);
+    struct dirent *e;
+    DIR *d;
+
+    d=opendir(dir.c_str());
+    if(d==nullptr){
+        fail("opendir", dir);
+    }
+    while((e=readdir(d))!=nullptr){
+        std::string name=e->d_name;
+        if(name.size()<=plen+slen || name.compare(0, plen, prefix)!=0 || name.compare(name.size()-slen, slen, suffix)!=0){
+            continue;
+        }
+        if(!keep(std::strtoull(name.c_str()+plen, nullptr, 10))){
+            unlink((dir+"/"+name).c_str());
+        }
+    }
+    closedir(d);
+}
+
+void sync_dir(const std::string &dir){
+    int fd=open(dir.c_str(), O_RDONLY|O_DIRECTORY);
+
+    if(fd<0){
+        fail("open", dir);
+    }
+    fsync(fd);
+    close(fd);
+}
@@ -0,0 +1,68 @@
+/*
+ * mapped_file.hpp - a file mapped into memory (mmap, MAP_SHARED), for the crawl state kept on disk
+ *
+ * The pages of a mapped file are the page cache's: the kernel writes them back and drops them when memory
+ * runs short, so a file much larger than the memory of the crawler can be mapped, and only the pages in use
+ * take memory. Functions fail by throwing std::system_error, with the path in the message.
+ */
+#ifndef CRAWLER_MAPPED_FILE_HPP
+#define CRAWLER_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class mapped_file {
+public:
+    mapped_file()=default;
+
+    /*map path; writable creates it if it does not exist and makes it size bytes long (zeros), otherwise it
+      is mapped read-only with the size it has (size is ignored)*/
+    mapped_file(const std::string &path, std::size_t size, bool writable);
+    ~mapped_file();
+
+    mapped_file(mapped_file &&other) noexcept;
+    mapped_file& operator=(mapped_file &&other) noexcept;
+    mapped_file(const mapped_file&)=delete;
+    mapped_file& operator=(const mapped_file&)=delete;
+
+    char *data() const {
+        return base;
+    }
+    std::size_t size() const {
+        return length;
+    }
+    bool mapped() const {
+        return base!=nullptr;
+    }
+
+    /*write the bytes from from to to out to the file and wait for them*/
+    void sync(std::size_t from, std::size_t to);
+
+    /*drop the pages from from to to (all of them by default) from the memory of the process; they stay in
+      the file, and come back from it when they are touched again*/
+    void release_pages(std::size_t from=0, std::size_t to=SIZE_MAX);
+
+    void unmap();
+
+private:
+    char *base=nullptr;
+    std::size_t length=0;
+    std::string path;
+};
+
+/*write size bytes to a new file path, durably (write to path.tmp, fsync, rename)*/
+void write_file_atomic(const std::string &path, const void *data, std::size_t size);
+
+/*read the whole of path into out; return false if it does not exist*/
+bool read_file(const std::string &path, std::string &out);
+
+/*delete the files of dir called prefix<n>suffix, but those keep(n) is true for*/
+void remove_files(const std::string &dir, const char *prefix, const char *suffix,
+                  const std::function<bool(std::uint64_t n)> &keep);
+
+/*fsync the directory dir, so that the files created and renamed in it are durable*/
+void sync_dir(const std::string &dir);
+
+#endif
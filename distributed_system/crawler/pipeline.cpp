@@ -0,0 +1,226 @@
+/*
+ * pipeline.cpp - the pipelined crawl engine (see pipeline.hpp)
+ */
+#include <algorithm>
+#include <chrono>
+
+#include "pipeline.hpp"
+#include "url.hpp"
+
+pipelined_crawler::pipelined_crawler(async_fetcher &f, visited_set &visited, const pipeline_options &options)
+    : f(f), visited(visited), options(options), in_flight(0), queued(0), next_id(0){
+    this->options.max_in_flight=std::max(1U, options.max_in_flight);
+    this->options.max_per_host=std::max(1U, options.max_per_host);
+    this->options.batch=std::max<std::size_t>(1, options.batch);
+}
+
+/*
+ * make_ready - put h in the ready list if it has tasks and room in its budget, and is not there yet
+ */
+void pipelined_crawler::make_ready(host_queue *h){
+    if(!h->ready && !h->tasks.empty() && h->in_flight<options.max_per_host){
+        h->ready=true;
+        ready.push_back(h);
+    }
+}
+
+/*
+ * queue - add a task to the queue of its host
+ */
+void pipelined_crawler::queue(std::string &&url, int depth){
+    host_queue *h=&hosts[std::string(url_host(url))];
+
+    h->tasks.push_back(task{std::move(url), depth});
+    queued++;
+    make_ready(h);
+}
+
+/*
+ * enqueue - add the page of a claimed URL to the frontier: to the queue of its host, or to the frontier log
+ * of the store when the queues hold ram_tasks or the log is not empty (it goes first)
+ */
+void pipelined_crawler::enqueue(std::string &&url, int depth){
+    if(options.store!=nullptr && (queued>=options.store->ram_tasks() || options.store->frontier().size()>0)){
+        options.store->frontier().push(url, depth);
+        return;
+    }
+    queue(std::move(url), depth);
+}
+
+/*
+ * refill - fill the queues back up to ram_tasks from the frontier log
+ */
+void pipelined_crawler::refill(){
+    std::string url;
+    int depth;
+
+    if(options.store==nullptr){
+        return;
+    }
+    while(queued<options.store->ram_tasks() && options.store->frontier().pop(url, depth)){
+        queue(std::move(url), depth);
+    }
+}
+
+/*
+ * checkpoint - claim the batch, so that every link found is in the visited set and the frontier, and hand
+ * the store the tasks queued and in flight
+ */
+void pipelined_crawler::checkpoint(crawl_stats &stats){
+    std::vector<std::pair<std::string, int>> tasks;
+
+    flush(stats);
+    tasks.reserve(queued+flying.size());
+    for(auto &h : hosts){
+        for(auto &t : h.second.tasks){
+            tasks.emplace_back(t.url, t.depth);
+        }
+    }
+    for(auto &t : flying){
+        tasks.emplace_back(t.second.url, t.second.depth);
+    }
+    options.store->checkpoint(tasks, stats);
+}
+
+/*
+ * dispatch - start fetches, one from each ready host in turn, until the global budget is spent or no host
+ * is ready. The callback only hands the result to the crawl thread.
+ */
+void pipelined_crawler::dispatch(){
+    while(in_flight<options.max_in_flight && !ready.empty()){
+        host_queue *h=ready.front();
+        ready.pop_front();
+        h->ready=false;
+
+        std::uint64_t id=next_id++;
+        task &t=flying.emplace(id, std::move(h->tasks.front())).first->second;
+        h->tasks.pop_front();
+        queued--;
+        h->in_flight++;
+        in_flight++;
+        make_ready(h);
+
+        f.fetch_async(t.url, [this, h, id](fetch_result &&result){
+            bool first;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                first=arrived.empty();
+                arrived.push_back(completion{h, id, std::move(result)});
+            }
+            if(first){
+                arrival.notify_one();
+            }
+        });
+    }
+}
+
+/*
+ * flush - normalize the links of the batch, drop those that repeat in it (keeping the most depth left),
+ * claim the rest in the visited set and enqueue those that were new
+ */
+void pipelined_crawler::flush(crawl_stats &stats){
+    std::size_t i, n=0;
+
+    for(i=0;i<batch.size();i++){
+        std::string url=normalize_url(batch[i].first);
+        if(url.empty()){
+            continue;
+        }
+        batch[n].first=std::move(url);
+        batch[n].second=batch[i].second;
+        n++;
+    }
+    batch.resize(n);
+    std::sort(batch.begin(), batch.end(), [](const std::pair<std::string, int> &a, const std::pair<std::string, int> &b){
+        return a.first!=b.first ? a.first<b.first : a.second>b.second;
+    });
+    for(i=0;i<batch.size();i++){
+        if(i>0 && batch[i].first==batch[i-1].first){
+            stats.duplicates++;
+            continue;
+        }
+        if(!visited.test_and_insert(batch[i].first)){
+            stats.duplicates++;
+            continue;
+        }
+        enqueue(std::move(batch[i].first), batch[i].second);
+    }
+    batch.clear();
+}
+
+crawl_stats pipelined_crawler::crawl(const std::string &root, int depth, const page_callback &on_page){
+    crawl_stats stats;
+    std::vector<completion> done;
+
+    hosts.clear();
+    ready.clear();
+    batch.clear();
+    flying.clear();
+    queued=0;
+    if(options.store!=nullptr && options.store->resumed()){
+        stats=options.store->stats;
+        for(auto &t : options.store->pending){
+            enqueue(std::string(t.first), t.second);
+        }
+    }else{
+        std::string start=normalize_url(root);
+        if(depth<=0 || start.empty() || !visited.test_and_insert(start)){
+            return stats;
+        }
+        enqueue(std::move(start), depth);
+    }
+    auto began=std::chrono::steady_clock::now(), last_checkpoint=began;
+    for(;;){
+        refill();
+        dispatch();
+        if(in_flight==0){
+            if(batch.empty()){
+                break;
+            }
+            flush(stats);
+            continue;
+        }
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            arrival.wait(guard, [this](){ return !arrived.empty(); });
+            done.swap(arrived);
+        }
+        for(auto &c : done){
+            auto it=flying.find(c.id);
+            task t=std::move(it->second);
+            flying.erase(it);
+            in_flight--;
+            c.host->in_flight--;
+            make_ready(c.host);
+            if(on_page){
+                on_page(t.url, c.result);
+            }
+            if(!c.result.ok){
+                stats.errors++;
+                continue;
+            }
+            stats.pages++;
+            if(t.depth<=1){
+                continue;
+            }
+            for(auto &u : c.result.urls){
+                batch.emplace_back(std::move(u), t.depth-1);
+            }
+        }
+        done.clear();
+        /*a small batch is flushed too when the frontier cannot fill the budget, so the pipeline never drains*/
+        if(batch.size()>=options.batch || ready.empty() || in_flight<options.max_in_flight/2){
+            flush(stats);
+        }
+        if(options.store!=nullptr && options.checkpoint_seconds>0
+           && std::chrono::duration<double>(std::chrono::steady_clock::now()-last_checkpoint).count()>=options.checkpoint_seconds){
+            checkpoint(stats);
+            last_checkpoint=std::chrono::steady_clock::now();
+        }
+    }
+    if(options.store!=nullptr){
+        checkpoint(stats);
+    }
+    stats.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-began).count();
+    return stats;
+}
@@ -0,0 +1,109 @@
+/*
+ * pipeline.hpp - a crawl engine that keeps many fetches in flight from one thread
+ *
+ * A worker of crawler.hpp (like CrawlRecursive in ../lec2.txt) fetches one page at a time and waits for it:
+ * with w workers and a latency of L, the crawl fetches at most w/L pages per second, 64 workers and 200 ms
+ * making 320. pipelined_crawler starts fetches on an async_fetcher and goes on; its one thread only handles
+ * the pages as they arrive, so it fetches up to max_in_flight/L pages per second, or as many as the thread
+ * can handle, whichever is less. Up to that point the pages per second stay the same however long a fetch
+ * takes.
+ *
+ * The frontier, the pages found and not yet fetched, is a queue per host. No more than max_per_host fetches
+ * to one host are in flight at once, whatever the host's share of the frontier (a crawler that does not
+ * wants to be banned), and the hosts with pages to fetch and room in their budget take turns (round robin),
+ * so that the crawl spreads over all the hosts rather than following the host of the first links.
+ *
+ * The links of the pages that arrived are gathered in a batch and, when it holds batch links or the fetches
+ * in flight run low, normalized (url.hpp), sorted and deduplicated in the batch (a page links to the same
+ * places many times, and its neighbours to the same places as it), and then claimed in the visited set, so
+ * that only the distinct links of the batch pay for the visited set. Depth counts as in crawler.hpp.
+ *
+ * With a crawl_store (crawl_store.hpp), the crawl is bounded in memory and survives a crash: no more than
+ * ram_tasks of the store are queued in memory, the rest going to its frontier log and coming back as the
+ * queues empty; the visited set should be the store's; and every checkpoint_seconds the engine claims its
+ * batch and hands the store the tasks it holds (queued and in flight) for a checkpoint, and once more at the
+ * end. If the store resumed from a checkpoint (crawl_store::open), crawl goes on from it and ignores root.
+ */
+#ifndef CRAWLER_PIPELINE_HPP
+#define CRAWLER_PIPELINE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "crawl_store.hpp"
+#include "crawler.hpp"
+#include "fetcher.hpp"
+#include "visited_set.hpp"
+
+struct pipeline_options {
+    unsigned max_in_flight=1024;    /*fetches in flight over all the hosts*/
+    unsigned max_per_host=4;        /*fetches in flight to one host*/
+    std::size_t batch=512;          /*links normalized and deduplicated together*/
+    crawl_store *store=nullptr;     /*where the frontier spills and checkpoints go (none: all in memory)*/
+    double checkpoint_seconds=0;    /*between checkpoints (0: only at the end)*/
+};
+
+class pipelined_crawler {
+public:
+    using page_callback=crawler::page_callback;
+
+    pipelined_crawler(async_fetcher &f, visited_set &visited, const pipeline_options &options=pipeline_options());
+
+    pipelined_crawler(const pipelined_crawler&)=delete;
+    pipelined_crawler& operator=(const pipelined_crawler&)=delete;
+
+    /*crawl from root down to depth, return when every page found has been fetched; on_page is called
+      from the thread that called crawl*/
+    crawl_stats crawl(const std::string &root, int depth, const page_callback &on_page=nullptr);
+
+private:
+    struct task {
+        std::string url;
+        int depth;
+    };
+
+    struct host_queue {
+        std::deque<task> tasks;
+        unsigned in_flight=0;
+        bool ready=false;           /*in the ready list*/
+    };
+
+    struct completion {
+        host_queue *host;
+        std::uint64_t id;           /*of the task in flying*/
+        fetch_result result;
+    };
+
+    async_fetcher &f;
+    visited_set &visited;
+    pipeline_options options;
+
+    std::unordered_map<std::string, host_queue> hosts;
+    std::deque<host_queue*> ready;      /*hosts with tasks and room in their budget, in turn*/
+    unsigned in_flight;
+    std::size_t queued;                 /*tasks in the host queues*/
+    std::unordered_map<std::uint64_t, task> flying;     /*the tasks in flight, by id*/
+    std::uint64_t next_id;
+    std::vector<std::pair<std::string, int>> batch;     /*links found and their depth left*/
+
+    std::mutex lock;                    /*guards arrived*/
+    std::condition_variable arrival;
+    std::vector<completion> arrived;
+
+    void enqueue(std::string &&url, int depth);
+    void queue(std::string &&url, int depth);
+    void refill();
+    void checkpoint(crawl_stats &stats);
+    void make_ready(host_queue *h);
+    void dispatch();
+    void flush(crawl_stats &stats);
+};
+
+#endif
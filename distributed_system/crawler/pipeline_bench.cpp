@@ -0,0 +1,79 @@
+/*
+ * pipeline_bench - pages per second of the pipelined engine as the fetch latency grows from 1 to 200 ms
+ *
+ * The pipelined engine crawls a synthetic web (pages pages on hosts hosts, 8 links each) through a
+ * fake_async_fetcher with the latency, at most max_in_flight fetches in flight and 4 per host, into a
+ * bloom_visited_set with its exact tier. For the pages per second to stay flat up to 200 ms, the fetches in
+ * flight must cover 200 ms of what the engine handles at 1 ms: the default, 16384 (4 per host on 4096
+ * hosts), covers 82000 pages per second. Beside it, the pool of crawler.hpp with 64 workers, each waiting
+ * for its fetch, crawls a web of 2000 pages with the same latency: it fetches 64 pages per latency.
+ *
+ * A crawl starts with one page and ends waiting for the last ones, some latencies at each end in which
+ * few fetches are in flight, so besides the pages per second of the whole crawl the steady rate is
+ * measured, from the 10% to the 90% page fetched. Every crawl must fetch every page exactly once.
+ *
+ * usage: pipeline_bench [pages] [hosts] [max_in_flight]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+#include "crawler.hpp"
+#include "fake_fetcher.hpp"
+#include "pipeline.hpp"
+#include "visited_set.hpp"
+
+#define FANOUT 8
+#define POOL_WORKERS 64
+#define POOL_PAGES 2000
+
+static const long latencies_ms[]={1, 10, 50, 100, 200};
+
+int main(int argc, char **argv){
+    std::size_t pages, hosts;
+    pipeline_options options;
+
+    pages=argc>1 ? std::strtoul(argv[1], nullptr, 0) : 300000;
+    hosts=argc>2 ? std::strtoul(argv[2], nullptr, 0) : 4096;
+    options.max_in_flight=argc>3 ? std::strtoul(argv[3], nullptr, 0) : 16384;
+    options.max_per_host=4;
+    if(pages<10 || hosts<1 || options.max_in_flight<1){
+        std::fprintf(stderr, "usage: pipeline_bench [pages] [hosts] [max_in_flight]\n");
+        return 2;
+    }
+    synthetic_fetcher web(pages, FANOUT, hosts), small(POOL_PAGES, FANOUT, 64);
+    std::printf("%zu pages on %zu hosts, at most %u fetches in flight, %u per host\n", pages, hosts,
+                options.max_in_flight, options.max_per_host);
+    std::printf("%10s %14s %14s %12s %18s\n", "latency ms", "steady pages/s", "whole pages/s", "duplicates",
+                "64 workers pages/s");
+    for(long ms : latencies_ms){
+        fake_async_fetcher net(web, std::chrono::milliseconds(ms));
+        bloom_visited_set visited(pages, 0.001, true);
+        pipelined_crawler engine(net, visited, options);
+        std::size_t fetched=0;
+        std::chrono::steady_clock::time_point first, last;
+        crawl_stats stats=engine.crawl(web.root(), static_cast<int>(pages), [&](const std::string&, const fetch_result&){
+            fetched++;
+            if(fetched==pages/10){
+                first=std::chrono::steady_clock::now();
+            }else if(fetched==pages-pages/10){
+                last=std::chrono::steady_clock::now();
+            }
+        });
+        double steady=(pages-2*(pages/10))/std::chrono::duration<double>(last-first).count();
+
+        small.set_latency(std::chrono::milliseconds(ms));
+        striped_visited_set pool_visited;
+        crawler pool(small, pool_visited, POOL_WORKERS);
+        crawl_stats pool_stats=pool.crawl(small.root(), POOL_PAGES);
+
+        if(stats.pages!=pages || stats.errors!=0 || pool_stats.pages!=POOL_PAGES){
+            std::fprintf(stderr, "pipeline_bench: %zu pages of %zu fetched, %zu errors; the pool %zu of %d\n",
+                         stats.pages, pages, stats.errors, pool_stats.pages, POOL_PAGES);
+            return 1;
+        }
+        std::printf("%10ld %14.0f %14.0f %12zu %18.0f\n", ms, steady, stats.pages/stats.seconds, stats.duplicates,
+                    pool_stats.pages/pool_stats.seconds);
+    }
+    return 0;
+}
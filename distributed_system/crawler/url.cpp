@@ -0,0 +1,140 @@
+/*
+ * url.cpp - URL normalization (see url.hpp)
+ */
+#include <cctype>
+#include <vector>
+
+#include "url.hpp"
+
+/*
+ * lower - append s to out in lower case
+ */
+static void lower(std::string &out, std::string_view s){
+    for(char c : s){
+        out+=(char)std::tolower((unsigned char)c);
+    }
+}
+
+/*
+ * starts_with_nocase - whether s starts with prefix, prefix being in lower case
+ */
+static bool starts_with_nocase(std::string_view s, std::string_view prefix){
+    std::size_t i;
+
+    if(s.size()<prefix.size()){
+        return false;
+    }
+    for(i=0;i<prefix.size();i++){
+        if(std::tolower((unsigned char)s[i])!=prefix[i]){
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * append_path - append path (empty or starting with /) to out with its . and .. segments resolved as in
+ * RFC 3986: a . is dropped, a .. drops the segment before it (none above the root), and either one last
+ * leaves the path ending with /
+ */
+static void append_path(std::string &out, std::string_view path){
+    std::vector<std::string_view> segments;
+    std::size_t end;
+    std::string_view seg;
+    bool last;
+
+    if(path.empty()){
+        out+='/';
+        return;
+    }
+    path.remove_prefix(1);
+    do{
+        end=path.find('/');
+        last=end==std::string_view::npos;
+        seg=path.substr(0, end);
+        path=last ? std::string_view() : path.substr(end+1);
+        if(seg=="." || seg==".."){
+            if(seg==".." && !segments.empty()){
+                segments.pop_back();
+            }
+            if(last){
+                segments.push_back(std::string_view());
+            }
+            continue;
+        }
+        segments.push_back(seg);
+    }while(!last);
+    for(auto &sg : segments){
+        out+='/';
+        out+=sg;
+    }
+    if(segments.empty()){
+        out+='/';
+    }
+}
+
+std::string normalize_url(std::string_view url){
+    std::string out;
+    std::string_view scheme, authority, host, port, path;
+    std::size_t pos;
+
+    while(!url.empty() && std::isspace((unsigned char)url.front())){
+        url.remove_prefix(1);
+    }
+    while(!url.empty() && std::isspace((unsigned char)url.back())){
+        url.remove_suffix(1);
+    }
+    if((pos=url.find('#'))!=std::string_view::npos){
+        url=url.substr(0, pos);
+    }
+    if(starts_with_nocase(url, "http://")){
+        scheme="http";
+    }else if(starts_with_nocase(url, "https://")){
+        scheme="https";
+    }else{
+        return out;
+    }
+    url.remove_prefix(scheme.size()+3);
+    pos=url.find_first_of("/?");
+    authority=url.substr(0, pos);
+    url=pos==std::string_view::npos ? std::string_view() : url.substr(pos);
+    pos=authority.rfind(':');
+    if(pos!=std::string_view::npos && authority.find(']', pos)!=std::string_view::npos){
+        pos=std::string_view::npos;     /*a colon of an IPv6 address*/
+    }
+    host=authority.substr(0, pos);
+    port=pos==std::string_view::npos ? std::string_view() : authority.substr(pos+1);
+    if(!host.empty() && host.back()=='.'){
+        host.remove_suffix(1);
+    }
+    if(host.empty()){
+        return out;
+    }
+    pos=url.find('?');
+    path=url.substr(0, pos);
+
+    out.reserve(scheme.size()+3+authority.size()+url.size()+1);
+    out+=scheme;
+    out+="://";
+    lower(out, host);
+    if(!port.empty() && !(scheme=="http" && port=="80") && !(scheme=="https" && port=="443")){
+        out+=':';
+        out+=port;
+    }
+    append_path(out, path);
+    if(pos!=std::string_view::npos){
+        out+=url.substr(pos);
+    }
+    return out;
+}
+
+std::string_view url_host(std::string_view url){
+    std::size_t start=url.find("://"), end;
+
+    if(start==std::string_view::npos){
+        return std::string_view();
+    }
+    start+=3;
+    end=url.find_first_of("/?", start);
+    return url.substr(start, end==std::string_view::npos ? std::string_view::npos : end-start);
+}
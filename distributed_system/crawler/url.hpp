@@ -0,0 +1,26 @@
+/*
+ * url.hpp - normalizing the URLs found on pages, so that each page has one URL in the visited set
+ *
+ * The same page is linked to in many spellings: HTTP://Golang.org:80/pkg/./fmt/#top and
+ * http://golang.org/pkg/fmt/ are one page, and without normalizing the crawler would fetch it once for
+ * each. normalize_url rewrites an absolute http or https URL as:
+ *     - the scheme and the host in lower case, without a trailing dot on the host
+ *     - no port if it is the default of the scheme (80, 443)
+ *     - the path with its . and .. segments resolved, / if it is empty
+ *     - no fragment (#...), which names a place in the page, not a page
+ * The query is kept as it is. Other URLs (relative ones, mailto:, ...) are not crawled: normalize_url
+ * returns an empty string for them.
+ */
+#ifndef CRAWLER_URL_HPP
+#define CRAWLER_URL_HPP
+
+#include <string>
+#include <string_view>
+
+/*the normal form of url, or an empty string if it is not an absolute http or https URL*/
+std::string normalize_url(std::string_view url);
+
+/*the host of a normalized URL (with its port, if any)*/
+std::string_view url_host(std::string_view url);
+
+#endif
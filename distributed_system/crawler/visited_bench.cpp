@@ -0,0 +1,137 @@
+/*
+ * visited_bench - memory per URL and lookup throughput of the visited sets
+ *
+ * Every set gets the same urls distinct URLs (like http://host17.example/dir/1234017/index.html), inserted
+ * by test_and_insert from one thread. Then threads threads look up every one of them and as many URLs that
+ * were never inserted, with contains. The sets:
+ *     strings          striped_visited_set (256 stripes), every URL as a string
+ *     bloom 10p/p/p/10 bloom_visited_set, the filter alone, with a budget of 10 times, 1 and 1/10 of fp_rate
+ *     bloom p + exact  bloom_visited_set with the exact tier, budget fp_rate
+ * For each:
+ *     bytes/URL        the heap the set takes (mallinfo2) divided by urls
+ *     insert ns        test_and_insert, per URL
+ *     hit, miss M/s    contains of inserted and of never inserted URLs, millions per second over the threads
+ *     lost             inserted URLs test_and_insert took as seen: new pages a crawl would never fetch
+ *     false pos        never inserted URLs contains took as seen, against the rate the filter expects
+ *
+ * usage: visited_bench [urls] [fp_rate] [threads]
+ */
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "visited_set.hpp"
+
+#define HOSTS 1000
+
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::size_t heap_in_use(){
+    struct mallinfo2 mi=mallinfo2();
+
+    return mi.uordblks+mi.hblkhd;
+}
+
+/*the URL of page n; absent ones use a path no inserted URL has*/
+static std::string make_url(std::size_t n, bool absent){
+    return "http://host"+std::to_string(n%HOSTS)+".example/"+(absent ? "new/" : "dir/")+std::to_string(n*1000+n%HOSTS)
+           +"/index.html";
+}
+
+/*
+ * lookup - look up every URL of urls with contains, from threads threads each taking a slice; return the
+ * lookups per second and count those that were found
+ */
+static double lookup(const visited_set &set, const std::vector<std::string> &urls, unsigned threads,
+                     std::size_t *found){
+    std::vector<std::thread> pool;
+    std::vector<std::size_t> hits(threads, 0);
+    std::size_t per=(urls.size()+threads-1)/threads;
+    unsigned t;
+    double start=now();
+
+    for(t=0;t<threads;t++){
+        pool.emplace_back([&, t](){
+            std::size_t i, n=0;
+
+            for(i=t*per;i<urls.size() && i<(t+1)*per;i++){
+                n+=set.contains(urls[i]);
+            }
+            hits[t]=n;
+        });
+    }
+    for(auto &th : pool){
+        th.join();
+    }
+    double seconds=now()-start;
+    *found=0;
+    for(t=0;t<threads;t++){
+        *found+=hits[t];
+    }
+    return urls.size()/seconds;
+}
+
+static void run(const char *name, const std::function<visited_set*()> &make, const std::vector<std::string> &present,
+                const std::vector<std::string> &absent, unsigned threads){
+    std::size_t before=heap_in_use(), hit, miss, i;
+    std::unique_ptr<visited_set> set(make());
+    double start=now(), insert, hit_rate, miss_rate;
+
+    for(i=0;i<present.size();i++){
+        set->test_and_insert(present[i]);
+    }
+    insert=(now()-start)/present.size()*1e9;
+    double bytes=(double)(heap_in_use()-before)/present.size();
+    hit_rate=lookup(*set, present, threads, &hit);
+    miss_rate=lookup(*set, absent, threads, &miss);
+
+    std::printf("%-16s %10.1f %10.0f %10.1f %10.1f %10.5f%% %10.5f%%", name, bytes, insert, hit_rate/1e6, miss_rate/1e6,
+                100.0*(present.size()-set->size())/present.size(), 100.0*miss/absent.size());
+    if(auto *b=dynamic_cast<bloom_visited_set*>(set.get())){
+        std::printf(" (%.5f%% expected)", 100*b->fp_rate());
+    }
+    std::printf("\n");
+    if(hit!=present.size()){
+        std::printf("%-16s %zu inserted URLs not found\n", name, present.size()-hit);
+    }
+}
+
+int main(int argc, char **argv){
+    std::size_t urls, i;
+    double fp;
+    unsigned threads;
+    char name[64];
+
+    urls=argc>1 ? std::strtoul(argv[1], nullptr, 0) : 1000000;
+    fp=argc>2 ? std::atof(argv[2]) : 0.001;
+    threads=argc>3 ? std::strtoul(argv[3], nullptr, 0) : std::thread::hardware_concurrency();
+    if(urls<1 || fp<=0 || fp>=0.05 || threads<1){
+        std::fprintf(stderr, "usage: visited_bench [urls] [fp_rate (below 0.05)] [threads]\n");
+        return 2;
+    }
+    std::vector<std::string> present, absent;
+    for(i=0;i<urls;i++){
+        present.push_back(make_url(i, false));
+        absent.push_back(make_url(i, true));
+    }
+    std::printf("%zu URLs, %u threads looking up\n", urls, threads);
+    std::printf("%-16s %10s %10s %10s %10s %11s %11s\n", "set", "bytes/URL", "insert ns", "hit M/s", "miss M/s",
+                "lost", "false pos");
+    run("strings", [](){ return new striped_visited_set(256); }, present, absent, threads);
+    for(double budget : {fp*10, fp, fp/10}){
+        std::snprintf(name, sizeof(name), "bloom %g%%", 100*budget);
+        run(name, [&](){ return new bloom_visited_set(urls, budget); }, present, absent, threads);
+    }
+    std::snprintf(name, sizeof(name), "bloom %g%% + exact", 100*fp);
+    run(name, [&](){ return new bloom_visited_set(urls, fp, true); }, present, absent, threads);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * visited_set.cpp - the lock-striped visited set (see visited_set.hpp)
+ */
+#include <cstdint>
+#include <functional>
+
+#include "visited_set.hpp"
+
+striped_visited_set::striped_visited_set(std::size_t n){
+    std::size_t count=1;
+
+    shift=64;
+    while(count<n){
+        count*=2;
+        shift--;
+    }
+    mask=count-1;
+    stripes.reset(new stripe[count]);
+}
+
+/*
+ * stripe_of - the stripe of url: the top bits of its hash multiplied by 2^64/phi. The hash sets inside the
+ * stripes pick their buckets by the low bits of the hash, so the stripes must not.
+ */
+striped_visited_set::stripe &striped_visited_set::stripe_of(std::string_view url) const {
+    std::uint64_t h=std::hash<std::string_view>()(url);
+
+    return stripes[mask==0 ? 0 : (h*0x9e3779b97f4a7c15ULL)>>shift];
+}
+
+bool striped_visited_set::test_and_insert(std::string_view url){
+    stripe &s=stripe_of(url);
+    std::lock_guard<std::mutex> guard(s.lock);
+
+    return s.urls.emplace(url).second;
+}
+
+bool striped_visited_set::contains(std::string_view url) const {
+    stripe &s=stripe_of(url);
+    std::lock_guard<std::mutex> guard(s.lock);
+
+    return s.urls.count(std::string(url))>0;
+}
+
+std::size_t striped_visited_set::size() const {
+    std::size_t total=0, i;
+
+    for(i=0;i<=mask;i++){
+        std::lock_guard<std::mutex> guard(stripes[i].lock);
+        total+=stripes[i].urls.size();
+    }
+    return total;
+}
+
+bloom_visited_set::bloom_visited_set(std::size_t expected, double fp_rate, bool exact, std::size_t n)
+    : filter(expected, fp_rate), exact(exact), count(0){
+    std::size_t c=1, i;
+
+    shift=64;
+    while(c<n){
+        c*=2;
+        shift--;
+    }
+    mask=c-1;
+    stripes.reset(new stripe[c]);
+    if(exact){
+        for(i=0;i<c;i++){
+            stripes[i].table=fingerprint_table(expected/c);
+        }
+    }
+}
+
+/*
+ * test_and_insert - under the lock of the stripe of url, set its bits in the filter. If one was clear, url
+ * is new. Otherwise it is seen, or a false positive of the filter, which the exact tier tells apart.
+ */
+bool bloom_visited_set::test_and_insert(std::string_view url){
+    std::uint64_t fp=url_fingerprint(url);
+    stripe &s=stripe_of(fp);
+    std::lock_guard<std::mutex> guard(s.lock);
+    bool fresh=filter.insert(fp);
+
+    if(exact && fresh){
+        s.table.insert_new(fp);
+    }else if(exact){
+        fresh=s.table.insert(fp);
+    }
+    if(fresh){
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+    return fresh;
+}
+
+/*
+ * contains - the filter alone answers for a URL it has not seen, without the lock
+ */
+bool bloom_visited_set::contains(std::string_view url) const {
+    std::uint64_t fp=url_fingerprint(url);
+
+    if(!filter.contains(fp)){
+        return false;
+    }
+    if(!exact){
+        return true;
+    }
+    stripe &s=stripe_of(fp);
+    std::lock_guard<std::mutex> guard(s.lock);
+    return s.table.contains(fp);
+}
+
+std::size_t bloom_visited_set::size() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+std::size_t bloom_visited_set::memory_bytes() const {
+    std::size_t total=filter.memory_bytes()+(mask+1)*sizeof(stripe), i;
+
+    for(i=0;exact && i<=mask;i++){
+        std::lock_guard<std::mutex> guard(stripes[i].lock);
+        total+=stripes[i].table.memory_bytes();
+    }
+    return total;
+}
@@ -0,0 +1,112 @@
+/*
+ * visited_set.hpp - the set of URLs the crawler has claimed (the Cache of ../lec2.txt)
+ *
+ * The Cache of lec2.txt asks CheckAndPass before the fetch and Write after it, each under one global
+ * mutex. Between the two calls another worker can pass the same check, so a page may be fetched twice,
+ * and every worker queues on the same lock. test_and_insert does both at once: it inserts the URL and
+ * says whether it was new, so exactly one caller ever gets true for a URL, the one that goes on to fetch it.
+ *
+ * striped_visited_set spreads the URLs over stripes by their hash, each a hash set with a mutex of its
+ * own (on a cache line of its own), so that workers only contend when they insert into the same stripe.
+ *
+ * Both keep every URL as a string, well over 100 bytes each with the hash set around it: tens of GB for a
+ * crawl of hundreds of millions of URLs. bloom_visited_set keeps a URL in a few bytes instead, its 64-bit
+ * fingerprint (fingerprint.hpp) going into two tiers:
+ *     filter       a blocked Bloom filter (bloom_filter.hpp) sized for the expected URLs and a
+ *                  false-positive budget: 10 bits per URL for 1%, 16 for 0.1%, 22 for 0.01%
+ *     exact        optionally, a table of the fingerprints (fingerprint_table), 11 to 21 bytes per URL
+ * With the filter alone, a URL that is new has a chance of the budget to be taken as seen, and is then
+ * never fetched; past the expected number of URLs the rate grows (bloom_visited_set::fp_rate). With the
+ * exact tier, a URL the filter takes as seen is looked up in the table, so only a fingerprint collision
+ * (about n^2/2^65 for n URLs) can lose one, and a URL the filter has never seen goes into the table without
+ * its probes comparing against anything. The filter and the table are split in stripes by the top bits of
+ * the fingerprint like striped_visited_set, each stripe with a lock and a part of the table; the lock of a
+ * URL guards its bits in the filter too, which keeps test_and_insert exact-once.
+ */
+#ifndef CRAWLER_VISITED_SET_HPP
+#define CRAWLER_VISITED_SET_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "bloom_filter.hpp"
+#include "fingerprint.hpp"
+
+class visited_set {
+public:
+    virtual ~visited_set()=default;
+
+    /*insert url; return true if it was not in the set before (the caller owns it), false otherwise*/
+    virtual bool test_and_insert(std::string_view url)=0;
+
+    /*whether url is in the set (it may be inserted by another thread right after)*/
+    virtual bool contains(std::string_view url) const=0;
+
+    /*the number of URLs in the set*/
+    virtual std::size_t size() const=0;
+};
+
+class striped_visited_set : public visited_set {
+public:
+    /*stripes is rounded up to a power of two (1 is the single lock of lec2.txt)*/
+    explicit striped_visited_set(std::size_t stripes=256);
+
+    bool test_and_insert(std::string_view url) override;
+    bool contains(std::string_view url) const override;
+    std::size_t size() const override;
+
+private:
+    struct alignas(64) stripe {
+        mutable std::mutex lock;
+        std::unordered_set<std::string> urls;
+    };
+
+    std::size_t mask;
+    unsigned shift;             /*64 minus the bits of a stripe number*/
+    std::unique_ptr<stripe[]> stripes;
+
+    stripe &stripe_of(std::string_view url) const;
+};
+
+class bloom_visited_set : public visited_set {
+public:
+    /*a set for expected URLs, the filter losing at most fp_rate of the new ones; exact adds the exact tier*/
+    bloom_visited_set(std::size_t expected, double fp_rate=0.001, bool exact=false, std::size_t stripes=256);
+
+    bool test_and_insert(std::string_view url) override;
+    bool contains(std::string_view url) const override;
+    std::size_t size() const override;
+
+    /*the false-positive rate of the filter now, the chance that a new URL is taken as seen without the exact tier*/
+    double fp_rate() const {
+        return filter.fp_rate(size());
+    }
+
+    /*the bytes of the filter and the tables*/
+    std::size_t memory_bytes() const;
+
+private:
+    struct alignas(64) stripe {
+        mutable std::mutex lock;
+        fingerprint_table table;
+    };
+
+    bloom_filter filter;
+    bool exact;
+    std::size_t mask;
+    unsigned shift;
+    std::unique_ptr<stripe[]> stripes;
+    std::atomic<std::size_t> count;
+
+    stripe &stripe_of(std::uint64_t fp) const {
+        return stripes[mask==0 ? 0 : fp>>shift];
+    }
+};
+
+#endif